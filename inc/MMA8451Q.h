@@ -29,6 +29,37 @@
 
 #define MMA8451Q_ADDR	0x1D
 
+//CTRL_REG1, CTRL_REG2 and XYZ_DATA_CFG fields
+#define CTRL_REG1_ACTIVE		0x01
+#define CTRL_REG1_F_READ		0x02		//8-bit fast read, OUT_X_MSB->OUT_Y_MSB->OUT_Z_MSB
+#define CTRL_REG1_DR_SHIFT		3
+#define CTRL_REG1_DR_MASK		0x38
+#define CTRL_REG2_MODS_MASK		0x03
+#define XYZ_DATA_CFG_FS_MASK	0x03
+
+//FIFO
+#define MMA8451Q_FIFO_SIZE		32			//samples
+#define F_SETUP_F_MODE_CIRC		0x40		//F_MODE = 01 - circular buffer
+#define F_SETUP_F_WMRK_MASK		0x3F
+#define F_STATUS_F_OVF			0x80		//STATUS reads as F_STATUS in FIFO mode
+#define F_STATUS_F_WMRK_FLAG	0x40
+#define F_STATUS_F_CNT_MASK		0x3F
+#define STATUS_ZYXDR			0x08		//new X, Y and Z data, STATUS outside FIFO mode
+
+//Interrupts.  On the FRDM-KL25Z INT1 is wired to PTA14 and INT2 to PTA15.
+#define MMA8451Q_INT1_PIN		14
+#define MMA8451Q_INT2_PIN		15
+#define CTRL_REG4_INT_EN_DRDY	0x01
+#define CTRL_REG4_INT_EN_FIFO	0x40
+#define CTRL_REG5_INT_CFG_DRDY	0x01		//1 - route to INT1, 0 - route to INT2
+#define CTRL_REG5_INT_CFG_FIFO	0x40
+
+//offset registers and auto zero
+#define MMA8451Q_OFF_MG_PER_LSB	2			//OFF_X/Y/Z are 8-bit two's complement, 2mg/LSB
+#define MMA8451Q_ONE_G			16384		//1g in left justified counts at 2g, >> range for 4g/8g
+#define MMA8451Q_ZERO_SKIP		2			//samples thrown away after going ACTIVE
+#define MMA8451Q_ZERO_MAX		4096		//most samples one auto zero can average
+
 /**
 * enumeration of the MMA8451Q registers
 */
@@ -87,13 +118,68 @@ typedef enum
 } MMA8451Q_REG;
 
 
+/**
+* enumeration of the MMA8451Q output data rates (CTRL_REG1 DR)
+*/
+typedef enum
+{
+	MMA8451Q_ODR_800HZ = 0,
+	MMA8451Q_ODR_400HZ,
+	MMA8451Q_ODR_200HZ,
+	MMA8451Q_ODR_100HZ,
+	MMA8451Q_ODR_50HZ,
+	MMA8451Q_ODR_12_5HZ,
+	MMA8451Q_ODR_6_25HZ,
+	MMA8451Q_ODR_1_56HZ
+} MMA8451Q_ODR;
+
+//output data rate in 1/100 Hz, a constant expression for compile time checks
+#define MMA8451Q_ODR_CHZ(odr)	(((odr) <= MMA8451Q_ODR_50HZ) ? (80000 >> (odr)) :		\
+								 ((odr) == MMA8451Q_ODR_12_5HZ) ? 1250 :				\
+								 ((odr) == MMA8451Q_ODR_6_25HZ) ? 625 : 156)
+
+/**
+* enumeration of the MMA8451Q oversampling modes (CTRL_REG2 MODS)
+*/
+typedef enum
+{
+	MMA8451Q_MODS_NORMAL = 0,
+	MMA8451Q_MODS_LNLP,				//low noise low power
+	MMA8451Q_MODS_HIRES,			//high resolution
+	MMA8451Q_MODS_LP				//low power
+} MMA8451Q_MODS;
+
+/**
+* enumeration of the MMA8451Q full scale ranges (XYZ_DATA_CFG FS)
+*/
+typedef enum
+{
+	MMA8451Q_RANGE_2G = 0,
+	MMA8451Q_RANGE_4G,
+	MMA8451Q_RANGE_8G
+} MMA8451Q_RANGE;
+
+/**
+* define the MMA8451Q configuration.  All zeros is 800Hz, normal mode,
+* 2g, 14-bit reads.
+*/
+typedef struct _MMA8451Q_CONFIG_
+{
+	MMA8451Q_ODR odr;
+	MMA8451Q_MODS mods;
+	MMA8451Q_RANGE range;
+	uint8_t f_read;					//1 - 8-bit fast read (3 bytes per sample), ignored in FIFO mode
+} MMA8451Q_CONFIG;
+
 /**
 * enumeration of the MMA8451Q state
 */
 typedef enum
 {
 	MMA8451Q_INIT = 0,
-	MMA8451Q_RUN
+	MMA8451Q_RUN,
+	MMA8451Q_ZERO,
+	MMA8451Q_DRAIN					//STANDBY and drain the FIFO before a reconfigure
 } MMA8451Q_STATE;
 
 typedef struct _MMA8451Q_DATA_
@@ -119,6 +205,46 @@ typedef union
 	MMA8451Q_DATA_SPLIT sdata;
 }XYZ_DATA;
 
+/**
+* define a double buffered, sequence numbered sample snapshot.  The driver
+* fills buf[front ^ 1], then flips front and bumps seq, so a consumer
+* never sees a sample that is only partly updated.
+*/
+typedef struct _MMA8451Q_SNAPSHOT_
+{
+	XYZ_DATA buf[2];
+	volatile uint8_t front;			//index of the published sample
+	volatile uint32_t seq;			//incremented on every publish
+} MMA8451Q_SNAPSHOT;
+
+/**
+* define a block of samples drained from the FIFO.  The burst read lands
+* in raw[] as interleaved MSB/LSB triplets and is split into one array
+* per axis (structure of arrays) for the block processing stages.
+*/
+typedef struct _MMA8451Q_BLOCK_
+{
+	int16_t x[MMA8451Q_FIFO_SIZE];
+	int16_t y[MMA8451Q_FIFO_SIZE];
+	int16_t z[MMA8451Q_FIFO_SIZE];
+	uint8_t raw[MMA8451Q_FIFO_SIZE * sizeof(MMA8451Q_DATA)];
+	uint8_t count;					//number of valid samples
+	volatile uint8_t ready;			//set when the block is full, cleared by the consumer
+} MMA8451Q_BLOCK;
+
+/**
+* define the auto zero state.  n != 0 means an auto zero is requested or
+* running.
+*/
+typedef struct _MMA8451Q_AUTOZERO_
+{
+	int32_t sum[3];
+	uint16_t n;						//samples to average
+	uint16_t cnt;					//samples seen so far, including the skipped ones
+	uint32_t seq;					//snapshot sequence of the last sample used
+	int8_t off[3];					//last offsets written to OFF_X/Y/Z
+} MMA8451Q_AUTOZERO;
+
 /**
 * define the MMA8451Q structured data type
 */
@@ -126,30 +252,117 @@ typedef struct _MMA8451Q_
 {
 	MMA8451Q_STATE state;
 	uint8_t step;
-	XYZ_DATA data;
+	uint8_t pending;				//I2C jobs queued and not yet completed
+	MMA8451Q_CONFIG cfg;
+	MMA8451Q_CONFIG cfg_next;		//taken up once the FIFO has been drained
+	uint8_t fifo_wmrk;				//0 - poll the output registers, otherwise FIFO watermark in samples, at most MMA8451Q_FIFO_SIZE
+	uint8_t fifo_cnt;				//samples in the FIFO at the last F_STATUS read
+	uint8_t int_pin;				//0 - poll, 1 - sample on INT1 (PTA14), 2 - sample on INT2 (PTA15)
+	volatile uint8_t reads_queued;	//sample reads submitted, by Run_MMA8451Q() or the PORTA ISR
+	uint8_t reads_done;				//sample reads completed
+	uint32_t fifo_ovf;				//number of times the FIFO overflowed
+	uint8_t write_err;				//a configuration write failed, the sequence starts over
+	uint32_t write_fails;			//configuration writes that failed
+	MMA8451Q_SNAPSHOT snap;
+	MMA8451Q_BLOCK block;
+	MMA8451Q_AUTOZERO zero;
 } MMA8451Q;
 
-uint8_t I2C_Read_WHO_AM_I(uint8_t slaveAddr, I2C_Packet *packet);
-uint8_t I2C_Write_XYZ_DATA_CFG(uint8_t slaveAddr, uint8_t data, I2C_Packet *packet);
-uint8_t I2C_Write_CTRL_REG1(uint8_t slaveAddr, uint8_t data, I2C_Packet *packet);
-
-uint8_t I2C_Read_OUT_X_MSB(uint8_t slaveAddr, I2C_Packet *packet);
-uint8_t I2C_Read_OUT_X_MSB_CB(uint8_t data, void *p);
-uint8_t I2C_Read_OUT_X_LSB(uint8_t slaveAddr, I2C_Packet *packet);
-uint8_t I2C_Read_OUT_X_LSB_CB(uint8_t data, void *p);
-uint8_t I2C_Read_OUT_Y_MSB(uint8_t slaveAddr, I2C_Packet *packet);
-uint8_t I2C_Read_OUT_Y_MSB_CB(uint8_t data, void *p);
-uint8_t I2C_Read_OUT_Y_LSB(uint8_t slaveAddr, I2C_Packet *packet);
-uint8_t I2C_Read_OUT_Y_LSB_CB(uint8_t data, void *p);
-uint8_t I2C_Read_OUT_Z_MSB(uint8_t slaveAddr, I2C_Packet *packet);
-uint8_t I2C_Read_OUT_Z_MSB_CB(uint8_t data, void *p);
-uint8_t I2C_Read_OUT_Z_LSB(uint8_t slaveAddr, I2C_Packet *packet);
-uint8_t I2C_Read_OUT_Z_LSB_CB(uint8_t data, void *p);
-
-
-void Init_MMA8451Q(MMA8451Q *m, I2C_Packet *packet);
-void Run_MMA8451Q(MMA8451Q *m, I2C_Packet *packet);
-void Update_MMA8451Q(MMA8451Q *m, I2C_Packet *packet);
+uint8_t I2C_Read_WHO_AM_I(uint8_t slaveAddr, I2C_Queue *q);
+uint8_t I2C_Write_CB(uint8_t *data, uint8_t count, void *p);
+uint8_t I2C_Write_XYZ_DATA_CFG(uint8_t slaveAddr, uint8_t data, MMA8451Q *m, I2C_Queue *q);
+uint8_t I2C_Write_CTRL_REG1(uint8_t slaveAddr, uint8_t data, MMA8451Q *m, I2C_Queue *q);
+uint8_t I2C_Write_CTRL_REG2(uint8_t slaveAddr, uint8_t data, MMA8451Q *m, I2C_Queue *q);
+
+uint8_t I2C_Write_F_SETUP(uint8_t slaveAddr, uint8_t data, MMA8451Q *m, I2C_Queue *q);
+uint8_t I2C_Write_CTRL_REG4(uint8_t slaveAddr, uint8_t data, MMA8451Q *m, I2C_Queue *q);
+uint8_t I2C_Write_CTRL_REG5(uint8_t slaveAddr, uint8_t data, MMA8451Q *m, I2C_Queue *q);
+
+uint8_t I2C_Read_OUT_XYZ(uint8_t slaveAddr, MMA8451Q *m, I2C_Queue *q);
+uint8_t I2C_Read_OUT_XYZ_CB(uint8_t *data, uint8_t count, void *p);
+uint8_t I2C_Read_STATUS_XYZ(uint8_t slaveAddr, MMA8451Q *m, I2C_Queue *q);
+uint8_t I2C_Read_STATUS_XYZ_CB(uint8_t *data, uint8_t count, void *p);
+uint8_t I2C_Read_F_STATUS(uint8_t slaveAddr, MMA8451Q *m, I2C_Queue *q);
+uint8_t I2C_Read_F_STATUS_CB(uint8_t *data, uint8_t count, void *p);
+uint8_t I2C_Read_FIFO(uint8_t slaveAddr, MMA8451Q *m, I2C_Queue *q);
+uint8_t I2C_Read_FIFO_CB(uint8_t *data, uint8_t count, void *p);
+uint8_t I2C_Write_OFF_XYZ(uint8_t slaveAddr, const int8_t *off, MMA8451Q *m, I2C_Queue *q);
+
+
+/**
+* @brief Change the MMA8451Q configuration
+*
+* Can be called before the first Update_MMA8451Q() or at any time after.
+* The driver waits for outstanding sample reads, puts the sensor in
+* STANDBY, rewrites the configuration and goes back to ACTIVE.  In FIFO
+* mode the samples still in the FIFO are drained after the STANDBY and
+* handed out as one more block, and the new configuration (m->cfg) only
+* takes over once that block has been consumed.
+*
+* @return void.
+*/
+void MMA8451Q_Configure(MMA8451Q *m, MMA8451Q_CONFIG *cfg);
+
+/**
+* @brief Gravity in sample counts for the configured range
+*
+* Samples are left justified 14 bit (or 8 bit with F_READ), so 1g is
+* 16384 counts at 2g, 8192 at 4g and 4096 at 8g.
+*
+* @return 1g in counts.
+*/
+__attribute__((always_inline)) static inline uint16_t MMA8451Q_One_G(const MMA8451Q *m)
+{
+	return(MMA8451Q_ONE_G >> m->cfg.range);
+}
+
+/**
+* @brief Read the latest MMA8451Q sample
+*
+* Copy the latest complete sample if it is newer than *seq.
+*
+* @param m pointer to the driver
+* @param d where to copy the sample
+* @param seq sequence number of the caller's last sample, updated on a copy
+*
+* @return 1 if a new sample was copied, 0 if there is nothing new.
+*/
+uint8_t MMA8451Q_Read_Sample(MMA8451Q *m, MMA8451Q_DATA *d, uint32_t *seq);
+
+/**
+* @brief Zero the MMA8451Q with its offset registers
+*
+* With the board lying flat (Z up), average n samples with OFF_X/Y/Z
+* cleared, then write offsets that bring X and Y to 0 and Z to 1g.  The
+* sensor applies them itself, so the correction costs no CPU time per
+* sample.  Can be called before the first Update_MMA8451Q() or at any
+* time after; normal sampling resumes when it is done.
+*
+* @param n samples to average, 1..MMA8451Q_ZERO_MAX
+*
+* @return void.
+*/
+void MMA8451Q_Auto_Zero(MMA8451Q *m, uint16_t n);
+
+/**
+* @brief Work out the offset register values for an auto zero
+*
+* @param sum sum of n flat samples per axis, taken with the offsets at 0
+* @param n number of samples
+* @param range full scale range the samples were taken at
+* @param off receives OFF_X/Y/Z, clamped to -128..127
+*
+* @return void.
+*/
+void MMA8451Q_Zero_Offsets(const int32_t sum[3], uint16_t n, MMA8451Q_RANGE range, int8_t off[3]);
+
+void Init_MMA8451Q(MMA8451Q *m, I2C_Queue *q);
+void Zero_MMA8451Q(MMA8451Q *m, I2C_Queue *q);
+void Drain_MMA8451Q(MMA8451Q *m, I2C_Queue *q);
+void MMA8451Q_INT_init(MMA8451Q *m);
+void MMA8451Q_INT_ISR(MMA8451Q *m, I2C_Queue *q);
+void Run_MMA8451Q(MMA8451Q *m, I2C_Queue *q);
+void Update_MMA8451Q(MMA8451Q *m, I2C_Queue *q);
 
 
 
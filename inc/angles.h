@@ -27,21 +27,149 @@
 #include <stdint.h>
 #include "MMA8451Q.h"
 
+//Angles are in hundredths of a degree, +/-18000 is +/-180 degrees
+#define ANGLE_SCALE		100
+
+//Angle backend used by Calc_angles.  Override from the compiler command
+//line, e.g. -DANGLE_BACKEND=ANGLE_BACKEND_LUT -DATAN_LUT_BITS=8
+#define ANGLE_BACKEND_CORDIC	0		//shift and add CORDIC
+#define ANGLE_BACKEND_LUT		1		//table lookup with linear interpolation
+#define ANGLE_BACKEND_LIBM		2		//newlib float atan2f/sqrtf, reference only
+#ifndef ANGLE_BACKEND
+#define ANGLE_BACKEND	ANGLE_BACKEND_CORDIC
+#endif
+
+//Table size for the LUT backend, 2^ATAN_LUT_BITS segments (4..8).  Each
+//table costs 2 * (2^ATAN_LUT_BITS + 1) bytes of flash and no RAM.
+#ifndef ATAN_LUT_BITS
+#define ATAN_LUT_BITS	6
+#endif
+
+//Tilt is only valid while the sensor sees gravity alone.  A sample whose
+//|a| is further than 1g >> ANGLE_DYN_SHIFT from 1g is flagged as dynamic.
+#ifndef ANGLE_DYN_SHIFT
+#define ANGLE_DYN_SHIFT	3
+#endif
+
 typedef struct _ANGLE_DATA_
 {
 	int16_t roll;
 	int16_t pitch;
 	int16_t yaw;
+	uint16_t mag;				//|a| in raw counts
+	uint8_t dynamic;			//1 if |a| is outside 1g +/- 1g >> ANGLE_DYN_SHIFT, angles unreliable
 }ANGLE_DATA;
 
+/**
+* @brief Integer square root
+*
+* Bit by bit (restoring) square root, one result bit per pass, so at
+* most 16 passes of a shift/compare/subtract loop with no multiply or
+* divide.  test/angles_test checks it against floor(sqrt(v)) for every
+* input below 2^24 and next to every square ("make sweep" for all 2^32),
+* test/angles_bench times it.  On the M0+ each pass is about a dozen
+* cycles, so the worst case is ~200 cycles, ~4us at 48MHz (counted from
+* the loop, not measured).
+*
+* @return floor(sqrt(v)).
+*/
+uint32_t Isqrt(uint32_t v);
+
+/**
+* @brief 3 axis vector magnitude
+*
+* The sum of squares of three int16 values is at most 3 * 2^30, so it
+* fits an unsigned 32 bit accumulator with no 64 bit math.
+*
+* @return sqrt(x^2 + y^2 + z^2) rounded down, 0..56755.
+*/
+uint32_t Vec_mag(int16_t x, int16_t y, int16_t z);
+
+/**
+* @brief Fixed point atan2
+*
+* CORDIC vectoring mode atan2 using only shifts and adds (no FPU on the
+* M0+), plus two 32 bit multiplies to take the gain out of the magnitude.
+* 16 iterations with 12 guard bits.  Checked against a double precision
+* atan2 over the whole int16 input plane (test/angles_test.c,
+* "make sweep"): the error is under 1 LSB (0.01 degree) for vectors at
+* least 16 counts long and at most 2 LSB for anything shorter except
+* (0,0).
+*
+* @param y y component, |y| < 2^16
+* @param x x component, |x| < 2^16
+* @param mag if not 0, receives the vector magnitude sqrt(x^2 + y^2)
+*            in the same units as x and y (error < 2 counts)
+*
+* @return angle of (x, y) in ANGLE_SCALE units, -18000..18000.
+*/
+int32_t Cordic_atan2(int32_t y, int32_t x, uint32_t *mag);
+
+/**
+* @brief Table driven atan2
+*
+* Octant reduction to a ratio in [0, 1], then linear interpolation in
+* const tables of atan(t) and sqrt(1 + t^2).  The tables are computed
+* by the compiler, so they live in flash and cost nothing at start up.
+* Max error against a double precision atan2 over the int16 input
+* plane (test/angles_test.c, "make sweep" for the whole plane), in 0.01
+* degree LSB: 4 bits - 2.7, 5 bits - 1.4, 6 bits - 1.1, 7 and 8 bits -
+* 1.0.  Magnitude error is under 2.5 counts from 6 bits up.
+*
+* @param y y component, |y| < 2^16
+* @param x x component, |x| < 2^16
+* @param mag if not 0, receives sqrt(x^2 + y^2) in the same units as x and y
+*
+* @return angle of (x, y) in ANGLE_SCALE units, -18000..18000.
+*/
+int32_t Lut_atan2(int32_t y, int32_t x, uint32_t *mag);
+
+/**
+* @brief Table driven asin
+*
+* Linear interpolation in a const table of asin(t).  The slope of asin
+* goes to infinity at +/-1, so the error is largest there: with 6 bits
+* it is 0.024 degree for |s| < 0.9 and 2.6 degrees close to 1, checked
+* over every Q15 input by test/angles_test.c.
+*
+* @param s sine in Q15, -32768..32768
+*
+* @return angle in ANGLE_SCALE units, -9000..9000.
+*/
+int32_t Lut_asin(int32_t s);
+
 /**
 * @brief Calculate angles
 *
 * Calculate angles from acceleration data.
+* roll = atan2(y, z), pitch = atan2(-x, sqrt(y^2 + z^2)).  Yaw can't be
+* seen by an accelerometer and is always 0.  Also fills in |a| and the
+* dynamic flag.  The CORDIC and LUT backends get |a| for free out of the
+* pitch step (within 3 counts of Vec_mag); the libm backend uses Vec_mag.
+*
+* @param one_g gravity in sample counts, MMA8451Q_One_G() for the current range
+*
+* @return void.
+*/
+void Calc_angles(MMA8451Q_DATA *acc, ANGLE_DATA *ang, uint16_t one_g);
+
+/**
+* @brief Calculate angles for a block of samples
+*
+* Same math as Calc_angles over n samples held as one array per axis,
+* e.g. an MMA8451Q_BLOCK.  The per sample kernel is inlined, so the loop
+* saves the call and the MMA8451Q_DATA copy per sample.
+*
+* @param x, y, z acceleration, n samples each
+* @param pitch, roll outputs, n samples each
+* @param dynamic if not 0, receives the dynamic flag of each sample
+* @param one_g gravity in sample counts, MMA8451Q_One_G() for the current range
+* @param n number of samples
 *
 * @return void.
 */
-void Calc_angles(MMA8451Q_DATA *acc, ANGLE_DATA *ang);
+void Calc_angles_block(const int16_t *x, const int16_t *y, const int16_t *z,
+					   int16_t *pitch, int16_t *roll, uint8_t *dynamic, uint16_t one_g, uint16_t n);
 
 
 #endif /* ANGLES_H_ */
@@ -0,0 +1,98 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file calib.h
+* @brief An abstraction for the accelerometer calibration
+*
+* This header file provides an abstraction of the functions to
+* correct raw acceleration data for offset, gain and axis misalignment
+*
+* @author Jon Warriner
+* @date June 25 2019
+* @version 1.0
+*
+*/
+
+#ifndef CALIB_H_
+#define CALIB_H_
+
+#include <stdint.h>
+#include "MMA8451Q.h"
+
+#define CALIB_SHIFT		15				//correction matrix is Q15
+#define CALIB_CORR_MAX	8192			//0.25, largest correction term
+
+/**
+* define the per device calibration parameters
+* a' = a - off
+* a_cal = a' + (corr * a') >> 15
+* corr is the calibration matrix minus identity, so gains and cross axis
+* terms of a few percent keep full Q15 resolution.  Each term must be
+* within +/-CALIB_CORR_MAX.
+*/
+typedef struct _CALIB_PARAM_
+{
+	int16_t off[3];					//offset in raw counts, x y z
+	int16_t corr[3][3];				//Q15, row = output axis, column = input axis
+} CALIB_PARAM;
+
+//pass through, no correction
+#define CALIB_IDENTITY		{ .off = {0, 0, 0}, .corr = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}} }
+
+//Order of the six captures handed to Calib_solve.  Each is the average of
+//many samples with the named axis pointing straight up.
+typedef enum
+{
+	CALIB_X_UP = 0,
+	CALIB_X_DOWN,
+	CALIB_Y_UP,
+	CALIB_Y_DOWN,
+	CALIB_Z_UP,
+	CALIB_Z_DOWN,
+	CALIB_ORIENTATIONS
+} CALIB_ORIENTATION;
+
+/**
+* @brief Apply the calibration to one sample in place
+*
+* 9 multiplies and 12 adds in 32 bits, outputs saturated to int16.
+*
+* @return void.
+*/
+void Calib_sample(const CALIB_PARAM *p, MMA8451Q_DATA *acc);
+
+/**
+* @brief Apply the calibration to a block of samples in place
+*
+* @param x, y, z acceleration, n samples each, e.g. an MMA8451Q_BLOCK
+*
+* @return void.
+*/
+void Calib_block(const CALIB_PARAM *p, int16_t *x, int16_t *y, int16_t *z, uint16_t n);
+
+/**
+* @brief Solve the calibration from six orientation captures
+*
+* Opposite captures give the offset (their mean) and one column of the
+* sensitivity matrix (half their difference over 1g).  The calibration
+* matrix is the inverse of the sensitivity matrix.  Uses float and runs
+* once, so it can be called on the target or built into a host tool.
+*
+* @param p receives the parameters
+* @param cap six averaged captures, indexed by CALIB_ORIENTATION
+* @param one_g gravity in raw counts, MMA8451Q_One_G() for the current range
+*
+* @return 0 on success or -1 if the captures are degenerate or a
+*         correction term is over CALIB_CORR_MAX.
+*/
+int32_t Calib_solve(CALIB_PARAM *p, const MMA8451Q_DATA cap[CALIB_ORIENTATIONS], int16_t one_g);
+
+#endif /* CALIB_H_ */
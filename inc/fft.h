@@ -0,0 +1,63 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file fft.h
+* @brief An abstraction for the fixed point FFT
+*
+* This header file provides an abstraction of the functions to
+* run an in place Q15 FFT
+*
+* @author Jon Warriner
+* @date June 26 2019
+* @version 1.0
+*
+*/
+
+#ifndef FFT_H_
+#define FFT_H_
+
+#include <stdint.h>
+
+//FFT length, 2^FFT_LOG2N points.  8 (256) or 9 (512).  The working buffer
+//is 4 bytes per point; the twiddle and bit reversal tables are in flash.
+#ifndef FFT_LOG2N
+#define FFT_LOG2N	8
+#endif
+#define FFT_N		(1 << FFT_LOG2N)
+
+typedef struct _FFT_CPX_
+{
+	int16_t re;
+	int16_t im;
+} FFT_CPX;
+
+/**
+* @brief In place FFT
+*
+* Decimation in time: a bit reversal pass from a const table, one radix-2
+* stage if FFT_LOG2N is odd, then radix-4 stages (3 complex multiplies per
+* 4 points).  Every stage scales by 1/radix, so the output is DFT / N and
+* can't overflow as long as every input has |x| <= 32767.
+*
+* @param x FFT_N points, natural order in and out
+*
+* @return void.
+*/
+void Fft_run(FFT_CPX *x);
+
+/**
+* @brief Cosine from the twiddle table
+*
+* @return cos(2 * pi * k / FFT_N) in Q15.
+*/
+int16_t Fft_cos(uint16_t k);
+
+#endif /* FFT_H_ */
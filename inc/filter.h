@@ -0,0 +1,228 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file filter.h
+* @brief An abstraction for the accelerometer low pass filter
+*
+* This header file provides an abstraction of the functions to
+* low pass filter acceleration data with a cascade of fixed point
+* biquad sections
+*
+* @author Jon Warriner
+* @date June 24 2019
+* @version 1.0
+*
+*/
+
+#ifndef FILTER_H_
+#define FILTER_H_
+
+#include <stdint.h>
+#include "MMA8451Q.h"
+
+#define BIQUAD_COEF_SHIFT	14			//coefficients are Q14, |coef| < 2
+#define BIQUAD_MAX_STAGES	2
+#define DECIM_MAX_ORDER		3
+
+//ratio^order, the CIC gain.  Decim_init() refuses a gain over 2^16, this
+//lets a fixed setup be checked at compile time instead.
+#define DECIM_GAIN(ratio, order)	(((order) == 1) ? (uint64_t)(ratio) :									\
+									 ((order) == 2) ? ((uint64_t)(ratio) * (ratio)) :						\
+									 ((uint64_t)(ratio) * (ratio) * (ratio)))
+
+//Section Qs of a 4th order Butterworth, 1 / (2 cos(pi/8)) and 1 / (2 cos(3pi/8))
+#define BIQUAD_BW4_Q1		0.5411961001461970
+#define BIQUAD_BW4_Q2		1.3065629648763766
+
+//Low pass section design, worked out by the compiler like the angle
+//tables.  Bilinear transform (RBJ cookbook) with w0 = 2 pi fc / fs and
+//alpha = sin(w0) / 2Q:
+//  a1 = -2 cos(w0) / (1 + alpha), a2 = (1 - alpha) / (1 + alpha)
+//a1 and a2 are rounded to Q14, then b0 = b2 and b1 are picked so that
+//b0 + b1 + b2 = 1 + a1 + a2 exactly, i.e. unity gain at DC after
+//quantization.  Keep fc under fs / 4; far below fs / 100 the poles get
+//too close to 1 for Q14.
+#define BIQUAD_W0(fc, fs)		(2.0 * 3.14159265358979323846 * (fc) / (fs))
+#define BIQUAD_ALPHA(fc, fs, q)	(__builtin_sin(BIQUAD_W0(fc, fs)) / (2.0 * (q)))
+#define BIQUAD_Q14(v)			((int16_t)(((v) < 0) ? (((v) * 16384.0) - 0.5) : (((v) * 16384.0) + 0.5)))
+#define BIQUAD_LP_A1(fc, fs, q)	BIQUAD_Q14(-2.0 * __builtin_cos(BIQUAD_W0(fc, fs)) / (1.0 + BIQUAD_ALPHA(fc, fs, q)))
+#define BIQUAD_LP_A2(fc, fs, q)	BIQUAD_Q14((1.0 - BIQUAD_ALPHA(fc, fs, q)) / (1.0 + BIQUAD_ALPHA(fc, fs, q)))
+#define BIQUAD_LP_G(fc, fs, q)	((1 << BIQUAD_COEF_SHIFT) + BIQUAD_LP_A1(fc, fs, q) + BIQUAD_LP_A2(fc, fs, q))
+#define BIQUAD_LP(fc, fs, q)	{ BIQUAD_LP_G(fc, fs, q) / 4,											\
+								  BIQUAD_LP_G(fc, fs, q) - (2 * (BIQUAD_LP_G(fc, fs, q) / 4)),			\
+								  BIQUAD_LP_G(fc, fs, q) / 4,											\
+								  BIQUAD_LP_A1(fc, fs, q),												\
+								  BIQUAD_LP_A2(fc, fs, q) }
+//4th order Butterworth low pass as a 2 section table initializer
+#define BIQUAD_BW4_LP(fc, fs)	{ BIQUAD_LP(fc, fs, BIQUAD_BW4_Q1), BIQUAD_LP(fc, fs, BIQUAD_BW4_Q2) }
+
+/**
+* define one biquad section
+* y[n] = b0*x[n] + b1*x[n-1] + b2*x[n-2] - a1*y[n-1] - a2*y[n-2]
+* All five coefficients are Q14.  The sum of their magnitudes must stay
+* under 4.0 so the 32 bit accumulator can't overflow.
+*/
+typedef struct _BIQUAD_COEF_
+{
+	int16_t b0;
+	int16_t b1;
+	int16_t b2;
+	int16_t a1;
+	int16_t a2;
+} BIQUAD_COEF;
+
+/**
+* define the delay line of one section.  Direct form I, the state holds
+* plain samples so a stage can never overflow internally, and err keeps
+* the bits shifted out of the last output (first order error feedback)
+* so low cutoffs don't stall short of the input.
+*/
+typedef struct _BIQUAD_STATE_
+{
+	int16_t x1;
+	int16_t x2;
+	int16_t y1;
+	int16_t y2;
+	int32_t err;
+} BIQUAD_STATE;
+
+typedef struct _BIQUAD_
+{
+	const BIQUAD_COEF *coef;
+	uint8_t stages;
+	BIQUAD_STATE state[BIQUAD_MAX_STAGES];
+} BIQUAD;
+
+/**
+* define a filter for all three axes
+*/
+typedef struct _ACCEL_FILTER_
+{
+	BIQUAD x;
+	BIQUAD y;
+	BIQUAD z;
+	uint8_t primed;				//set once the delay lines hold the first sample
+} ACCEL_FILTER;
+
+/**
+* define a CIC decimator.  order integrators run at the input rate and
+* order combs at the output rate, so the cost per sample is fixed no
+* matter how long the average is.  Order 1 is a plain boxcar average.
+* The integrators are allowed to wrap, the combs undo it.
+*/
+typedef struct _DECIM_
+{
+	uint32_t integ[DECIM_MAX_ORDER];
+	uint32_t comb[DECIM_MAX_ORDER];		//last input of each comb
+	int32_t gain;						//ratio^order
+	uint16_t ratio;
+	uint16_t phase;						//samples since the last output
+	uint8_t order;
+} DECIM;
+
+//4th order Butterworth low pass, 20Hz cutoff at ODR_800HZ
+extern const BIQUAD_COEF lp_20hz_800hz[2];
+//4th order Butterworth low pass, 5Hz cutoff at ODR_100HZ
+extern const BIQUAD_COEF lp_5hz_100hz[2];
+
+/**
+* @brief Initialize a biquad cascade
+*
+* @param f filter
+* @param coef table of stages sections
+* @param stages number of sections, 1..BIQUAD_MAX_STAGES
+* @param x0 value to preload the delay lines with
+*
+* @return void.
+*/
+void Biquad_init(BIQUAD *f, const BIQUAD_COEF *coef, uint8_t stages, int16_t x0);
+
+/**
+* @brief Run one sample through a biquad cascade
+*
+* Five 16x16 multiplies per section, all in 32 bits, so it maps onto the
+* M0+ single cycle multiplier with no 64 bit helpers.  The output of each
+* section is saturated to int16.
+*
+* @return filtered sample.
+*/
+int16_t Biquad_run(BIQUAD *f, int16_t x);
+
+/**
+* @brief Run a block of samples through a biquad cascade in place
+*
+* @return void.
+*/
+void Biquad_block(BIQUAD *f, int16_t *data, uint16_t n);
+
+/**
+* @brief Initialize the 3 axis filter
+*
+* The delay lines are preloaded with the first sample filtered, so the
+* output starts at the current attitude instead of ramping up from 0.
+*
+* @param f filter
+* @param coef table of stages sections, used for all three axes
+* @param stages number of sections, 1..BIQUAD_MAX_STAGES
+*
+* @return void.
+*/
+void Filter_init(ACCEL_FILTER *f, const BIQUAD_COEF *coef, uint8_t stages);
+
+/**
+* @brief Filter one sample in place
+*
+* @return void.
+*/
+void Filter_sample(ACCEL_FILTER *f, MMA8451Q_DATA *acc);
+
+/**
+* @brief Filter a block of samples in place
+*
+* @param x, y, z acceleration, n samples each, e.g. an MMA8451Q_BLOCK
+*
+* @return void.
+*/
+void Filter_block(ACCEL_FILTER *f, int16_t *x, int16_t *y, int16_t *z, uint16_t n);
+
+/**
+* @brief Initialize a decimator
+*
+* @param d decimator
+* @param ratio input samples per output sample
+* @param order number of CIC stages, 1..DECIM_MAX_ORDER
+*
+* @return 0 on success or -1 if ratio^order is over 2^16.  The integrators
+*         wrap, but a full scale input times ratio^order has to fit the
+*         int32 the combs hand back.
+*/
+int32_t Decim_init(DECIM *d, uint16_t ratio, uint8_t order);
+
+/**
+* @brief Feed one sample to a decimator
+*
+* @param out receives the average of the last ratio samples (order 1) or
+*            the CIC output scaled back to input units
+*
+* @return 1 if out was written, 0 otherwise.
+*/
+uint8_t Decim_run(DECIM *d, int16_t x, int16_t *out);
+
+/**
+* @brief Feed a block of samples to a decimator
+*
+* @param out receives the newest output produced by the block
+*
+* @return 1 if out was written, 0 otherwise.
+*/
+uint8_t Decim_block(DECIM *d, const int16_t *x, uint16_t n, int16_t *out);
+
+#endif /* FILTER_H_ */
@@ -0,0 +1,100 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file fmt.h
+* @brief An abstraction for the number formatting
+*
+* This header file provides an abstraction of the functions to
+* format numbers as text without the C library printf family
+*
+* @author Jon Warriner
+* @date June 29 2019
+* @version 1.0
+*
+*/
+
+#ifndef FMT_H_
+#define FMT_H_
+
+#include <stdint.h>
+
+/*
+* All of these write straight into buf and return the number of chars
+* written.  Nothing is NUL terminated, so calls can be chained with
+* p += Fmt_xxx(p, ...).  width pads on the left with spaces, 0 for none.
+* Decimal digits come from subtracting powers of 10, so there is no
+* divide (the M0+ has none).  Fmt_q() does multiply, |v| * 10^decimals in
+* 64 bits, which on the M0+ is a call to libgcc's __aeabi_lmul.
+*
+* make -C test fmtsize links fmt.c and sprintf each on their own and reads
+* .text from the maps.  Only the host has been measured: fmt.o is 584
+* bytes (x86-64, gcc 12 -Os, glibc), and glibc links vfprintf either way
+* so that run says nothing about sprintf.  The firmware links Redlib
+* (semihost_nf), so the number that matters is fmt.o against Redlib's nf
+* sprintf on the M0+.  That has not been measured; see the Makefile.
+*/
+
+/**
+* @brief Copy a string
+*
+* @return length of s.
+*/
+uint8_t Fmt_str(char *buf, const char *s);
+
+/**
+* @brief Unsigned decimal, up to 10 digits
+*
+* @return chars written.
+*/
+uint8_t Fmt_uint(char *buf, uint32_t v, uint8_t width);
+
+/**
+* @brief Signed decimal, up to 11 chars
+*
+* @return chars written.
+*/
+uint8_t Fmt_int(char *buf, int32_t v, uint8_t width);
+
+/**
+* @brief Decimal fixed point
+*
+* v is a count of 10^-decimals, e.g. 1234 with 2 decimals is "12.34" and
+* -5 is "-0.05".
+*
+* @param decimals digits after the point, 0..9
+*
+* @return chars written.
+*/
+uint8_t Fmt_fixed(char *buf, int32_t v, uint8_t decimals, uint8_t width);
+
+/**
+* @brief Binary fixed point
+*
+* v is in Q(q), rounded to decimals digits, e.g. 0x4000 in Q15 with 3
+* decimals is "0.500".
+*
+* @param q fraction bits, 0..31
+* @param decimals digits after the point, 0..9
+*
+* @return chars written.
+*/
+uint8_t Fmt_q(char *buf, int32_t v, uint8_t q, uint8_t decimals, uint8_t width);
+
+/**
+* @brief Hex, upper case, zero padded
+*
+* @param digits number of digits, 1..8, the top ones are dropped
+*
+* @return chars written.
+*/
+uint8_t Fmt_hex(char *buf, uint32_t v, uint8_t digits);
+
+#endif /* FMT_H_ */
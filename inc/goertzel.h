@@ -0,0 +1,107 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file goertzel.h
+* @brief An abstraction for the Goertzel tone detector bank
+*
+* This header file provides an abstraction of the functions to
+* measure the acceleration at a few known frequencies
+*
+* @author Jon Warriner
+* @date June 27 2019
+* @version 1.0
+*
+*/
+
+#ifndef GOERTZEL_H_
+#define GOERTZEL_H_
+
+#include <stdint.h>
+#include "ring.h"
+
+#define GOERTZEL_MAX_BINS	8
+#define GOERTZEL_SHIFT		14			//coefficients are 2cos(w) in Q14
+
+//Coefficient for a tone at f Hz sampled at fs Hz, worked out by the
+//compiler so a const table of them costs no start up time or libm.
+#define GOERTZEL_COEF_RAW(f, fs)	(__builtin_cos((2.0 * 3.14159265358979323846 * (f)) / (fs)) * 32768.0)
+#define GOERTZEL_COEF(f, fs)		((int16_t)((GOERTZEL_COEF_RAW(f, fs) > 32767.0) ? 32767 : \
+									 ((GOERTZEL_COEF_RAW(f, fs) < 0) ? (GOERTZEL_COEF_RAW(f, fs) - 0.5) : (GOERTZEL_COEF_RAW(f, fs) + 0.5))))
+
+/**
+* define a bank of Goertzel detectors sharing one block length.  The
+* results are updated together at the end of a block and ready is set;
+* blocks that end while ready is still set are dropped, so the consumer
+* always reads one block's results.  Goertzel_task clears it.
+*/
+typedef struct _GOERTZEL_
+{
+	const int16_t *coef;			//GOERTZEL_COEF per bin
+	uint8_t bins;
+	uint16_t len;					//samples per block
+	uint16_t n;						//samples into the current block
+	int32_t s1[GOERTZEL_MAX_BINS];
+	int32_t s2[GOERTZEL_MAX_BINS];
+	uint32_t power[GOERTZEL_MAX_BINS];	//amplitude^2 of the tone in counts^2
+	uint16_t amp[GOERTZEL_MAX_BINS];	//amplitude of the tone in counts
+	volatile uint8_t ready;
+	uint8_t line;					//next bin to send
+	char sbuf[24];
+} GOERTZEL;
+
+/**
+* @brief Initialize a detector bank
+*
+* @param g bank
+* @param coef GOERTZEL_COEF of each bin
+* @param bins number of bins, 1..GOERTZEL_MAX_BINS
+* @param len block length in samples.  The bin width is fs / len; for no
+*        leakage pick len so every tone is a whole number of cycles.
+*
+* @return void.
+*/
+void Goertzel_init(GOERTZEL *g, const int16_t *coef, uint8_t bins, uint16_t len);
+
+/**
+* @brief Feed one sample to the bank
+*
+* Per bin: s = x + coef * s1 - s2, where coef * s1 is done as two 16x16
+* multiplies on the halves of s1 so it stays in 32 bits.  That needs the
+* state under 2^29, which holds for |x| <= 32767 (DC included) as long as
+* len * fs / f < 200000, e.g. 400 samples with every tone above 2Hz at 800Hz.
+*
+* @return 1 at the end of a block, when the results have been updated.
+*/
+uint8_t Goertzel_run(GOERTZEL *g, int16_t x);
+
+/**
+* @brief Feed a block of samples to the bank
+*
+* @return 1 if at least one block ended.
+*/
+uint8_t Goertzel_block(GOERTZEL *g, const int16_t *x, uint16_t n);
+
+/**
+* @brief Send the results of the last block
+*
+* One line per bin, each sent when the output buffer is empty:
+* "<freq> Hz <amplitude> mg".
+*
+* @param freq frequency of each bin in Hz, for the labels
+* @param one_g 1g in input counts, MMA8451Q_One_G() for the current range
+* @param obuf output ring buffer
+* @param tx_func function to trigger transmission of the output buffer
+*
+* @return void.
+*/
+void Goertzel_task(GOERTZEL *g, const uint16_t *freq, uint16_t one_g, ring_t *obuf, void (*tx_func)());
+
+#endif /* GOERTZEL_H_ */
@@ -26,7 +26,24 @@
 
 #include <stdint.h>
 
-#define I2C_WAIT_COUNT							(10000)
+//#define I2C_POLLED
+
+//Timeouts, measured against Timer_us()
+#define I2C_BUS_TIMEOUT_US						(500)		// bus busy before a START
+#define I2C_XFER_TIMEOUT_US						(2000)		// START to last byte of a job
+#define I2C_STOP_TIMEOUT_US						(200)		// STOP generated to STOPF
+
+//Bus recovery
+#define I2C_RECOVER_CLOCKS						(9)			// SCL pulses to free a stuck slave
+#define I2C_RECOVER_HALF_US						(5)			// half SCL period, ~100kHz
+
+//Size of the data buffer carried in each packet.  Sized for a burst read of
+//the MMA8451Q status and output registers (STATUS..OUT_Z_LSB).  Longer
+//transfers supply their own buffer.
+#define I2C_DATA_SIZE							(7)
+
+//Number of transaction descriptors in the job queue
+#define I2C_QUEUE_SIZE							(8)
 
 /**
 * enumeration of states for the I2C master state-machine
@@ -39,7 +56,8 @@ typedef enum
 	WR_DONE,
 	RD_ADDRESS,
 	RD_SWITCH,
-	RD_DATA
+	RD_DATA,
+	WAIT_BUS								// waiting for the bus to go idle before the START
 #ifdef JUNK
 	RD_DATA1,
 	RD_DATA2,
@@ -48,66 +66,121 @@ typedef enum
 } I2C_STATE;
 
 /**
-* define the I2C Packet structured data type
+* enumeration of I2C job status within the queue
+*/
+typedef enum
+{
+	JOB_FREE = 0,							// slot is available
+	JOB_PENDING,							// waiting for the bus
+	JOB_ACTIVE,								// on the bus now
+	JOB_DONE,								// finished, waiting for the callback to run
+	JOB_ERROR								// failed, callback runs with a byteCount of 0
+} I2C_JOB_STATUS;
+
+/**
+* enumeration of I2C job priorities.  Pending jobs are started highest
+* priority first, in submission order within a priority.
+*/
+typedef enum
+{
+	I2C_PRI_LOW = 0,						// configuration writes etc.
+	I2C_PRI_HIGH							// high rate sensor reads
+} I2C_PRIORITY;
+
+/**
+* define the I2C Packet structured data type.  Each packet is one
+* transaction descriptor in the job queue.
 */
 typedef struct _I2C_PACKET_
 {
-	uint8_t (*i2c_callback)(uint8_t, void *);
-	I2C_STATE state;
+	uint8_t (*i2c_callback)(uint8_t *, uint8_t, void *);	// (data, byteCount, context)
+	void *context;							// passed to the callback
+	volatile I2C_STATE state;				// advanced from the I2C0 ISR
+	volatile I2C_JOB_STATUS status;
+	I2C_PRIORITY priority;
 	uint8_t read_write_n;					// read/write_n
 	uint8_t slaveAddress;
 	uint8_t command;
-	uint8_t byteCount;
+	uint8_t byteCount;						// number of data bytes to read/write
+	uint8_t idx;							// index of the next data byte
+	uint8_t *buffer;						// caller's buffer for long transfers, 0 to use data[]
 #ifdef I2C_LOG
 	uint8_t data[14];
-	uint8_t idx;
 #else
-	uint8_t data[4];
+	uint8_t data[I2C_DATA_SIZE];
 #endif
+	uint32_t seq;							// submission order
+	uint32_t t_submit;						// Timer_us() when queued
+	uint32_t t_done;						// Timer_us() when finished
 } I2C_Packet;
 
+/**
+* define the I2C job queue structured data type
+*/
+typedef struct _I2C_QUEUE_
+{
+	I2C_Packet job[I2C_QUEUE_SIZE];
+	I2C_Packet * volatile active;			// job on the bus, 0 when idle
+	volatile uint8_t stopping;				// STOP generated, waiting for STOPF
+	volatile uint32_t t_event;				// Timer_us() at the START, or at the STOP when stopping
+	uint8_t depth;							// jobs submitted but not yet reaped
+	uint8_t max_depth;						// high water mark of depth
+	uint32_t seq;							// next submission number
+	uint32_t completed;						// jobs reaped
+	uint32_t errors;						// jobs that failed
+	uint32_t latency_last;					// submit to done of the last reaped job (us)
+	uint32_t latency_max;					// worst submit to done (us)
+	uint32_t recoveries;					// number of bus recoveries
+	uint32_t recover_us;					// time taken by the last bus recovery (us)
+} I2C_Queue;
+
 /**
 * @brief Initialize I2C
 *
-* Initialize I2C for the application
+* Initialize I2C and an empty job queue for the application
 *
 * @return void.
 */
-void I2C_init(I2C_Packet *packet);
+void I2C_init(I2C_Queue *q);
 
 /**
 * @brief I2C Read
 *
-* Read from an I2C device
+* Queue a read of packet->byteCount bytes from an I2C device starting
+* at register packet->command.  Multi-byte reads rely on the slave
+* auto-incrementing its register address.  The packet is copied into
+* the queue so the caller's copy can be reused right away.  Safe to
+* call from an ISR.
 *
-* @return error.
+* @return error, non-zero if the packet is invalid or the queue is full.
 */
-uint8_t I2C_Read(I2C_Packet *packet);
+uint8_t I2C_Read(I2C_Queue *q, I2C_Packet *packet);
 
 /**
 * @brief I2C Write
 *
-* Write to an I2C device
+* Queue a write of packet->byteCount bytes to an I2C device starting
+* at register packet->command.
 *
-* @return error.
+* @return error, non-zero if the packet is invalid or the queue is full.
 */
-uint8_t I2C_Write(I2C_Packet *packet);
+uint8_t I2C_Write(I2C_Queue *q, I2C_Packet *packet);
 
 /**
 * @brief I2C Transfer Complete
 *
-* Has an I2C transfer completed?
+* Has an I2C transfer completed?  Does not wait.
 *
-* @return error.
+* @return error, non-zero while a byte is still in flight.
 */
 uint8_t I2C_Transfer_Complete();
 
 /**
 * @brief I2C Check Busy
 *
-* Is the I2C bus busy?
+* Is the I2C bus busy?  Does not wait.
 *
-* @return error.
+* @return error, non-zero while the bus is busy.
 */
 uint8_t I2C_Check_Busy();
 
@@ -116,35 +189,63 @@ uint8_t I2C_Check_Busy();
 *
 * Is the I2C in master mode?
 *
-* @return error.
+* @return error, non-zero while MST is still set.
 */
 uint8_t I2C_Check_MST();
 
+/**
+* @brief I2C Bus Recover
+*
+* Take the pins away from I2C0, clock SCL until the slave releases SDA,
+* force a STOP and hand the pins back to I2C0.  Blocks for at most
+* (I2C_RECOVER_CLOCKS + 2) SCL periods.
+*
+* @return void.
+*/
+void I2C_Bus_Recover();
+
+/**
+* @brief I2C Service
+*
+* Background loop housekeeping.  Starts a job that was waiting for
+* the bus and recovers the bus when a job or STOP has taken longer
+* than its timeout.
+*
+* @return void.
+*/
+void I2C_Service(I2C_Queue *q);
+
 /**
 * @brief Run I2C Master
 *
-* Run the I2C Master state machine
+* Run the I2C Master state machine for the active job.  When the STOP
+* of a finished job is detected the next pending job is started, so
+* the queue drains back-to-back without the foreground.
 *
-* @return error.
+* @return void.
 */
-void Run_I2C_Master(I2C_Packet *packet);
+void Run_I2C_Master(I2C_Queue *q);
 
 /**
 * @brief I2C Handler
 *
-* I2C functionality for the background loop
+* I2C functionality for the background loop.  Only needed when
+* I2C_POLLED is defined, otherwise the I2C0 ISR runs the master
+* state machine.
 *
 * @return void.
 */
-void I2C_POLL(I2C_Packet *packet);
+void I2C_POLL(I2C_Queue *q);
 
 /**
 * @brief I2C Callback Handler
 *
-* I2C Callback functionality for the background loop
+* I2C Callback functionality for the background loop.  Runs the
+* callback of every finished job, updates the latency statistics
+* and frees the slot.
 *
-* @return void.
+* @return error from the last callback.
 */
-uint8_t Check_I2C_Callback(I2C_Packet *packet, void *p);
+uint8_t Check_I2C_Callback(I2C_Queue *q);
 
 #endif /* I2C_H_ */
@@ -0,0 +1,96 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file pool.h
+* @brief An abstraction for the fixed block pool allocator
+*
+* This header file provides an abstraction of the functions to
+* allocate same sized objects from static storage instead of the heap
+*
+* @author Jon Warriner
+* @date June 29 2019
+* @version 1.0
+*
+*/
+
+#ifndef POOL_H_
+#define POOL_H_
+
+#include <stdint.h>
+
+/**
+* define the pool structured data type.  Blocks that have never been
+* handed out are taken from fresh; freed blocks are kept on a list
+* linked through their first word.
+*/
+typedef struct _POOL_
+{
+	void *free;						//list of freed blocks
+	char *fresh;					//next never used block
+	char *base;						//first block
+	char *end;						//just past the last block
+	uint16_t size;					//bytes per block, a power of 2 and at least a pointer
+} POOL;
+
+//log2 of the power of 2 block that holds n bytes, at least a pointer
+#define POOL_SHIFT(n)	(((n) <= 4) ? 2 : ((n) <= 8) ? 3 : ((n) <= 16) ? 4 : ((n) <= 32) ? 5 :				\
+						 ((n) <= 64) ? 6 : ((n) <= 128) ? 7 : ((n) <= 256) ? 8 : ((n) <= 512) ? 9 :		\
+						 ((n) <= 1024) ? 10 : ((n) <= 2048) ? 11 : ((n) <= 4096) ? 12 : ((n) <= 8192) ? 13 :	\
+						 ((n) <= 16384) ? 14 : 15)
+
+/**
+* @brief Define a pool of count blocks that each hold a type
+*
+* The blocks go in .bss and the pool needs no init call.  Each block is
+* at least a pointer in size and aligned for both type and a pointer.
+* Blocks are rounded up to a power of 2, so Pool_free() can check a
+* pointer with a mask instead of a divide, which the M0+ doesn't have.
+* A 24 byte type takes 32 byte blocks.
+*
+* @param name  Name of the POOL variable
+* @param type  Type of object the blocks hold
+* @param count Number of blocks
+*/
+#define POOL_DEFINE(name, type, count)											\
+	_Static_assert((count) > 0, "pool " #name " needs at least one block");		\
+	_Static_assert(sizeof(type) <= 0x8000, "pool " #name " blocks too big");	\
+	static union { type obj; void *next; char pad[1 << POOL_SHIFT(sizeof(type))]; } name##_blocks[count];	\
+	POOL name = { 0, (char *)name##_blocks, (char *)name##_blocks,				\
+				  (char *)&name##_blocks[count], sizeof(name##_blocks[0]) }
+
+/**
+* @brief Take a block from the pool
+*
+* Safe to call from an ISR, interrupts are masked for a few instructions.
+*
+* @param p pool
+*
+* @return pointer to the block, 0 if the pool is empty.
+*/
+void *Pool_alloc(POOL *p);
+
+/**
+* @brief Give a block back to the pool
+*
+* A block that is already free isn't caught, and freeing it twice puts it
+* on the free list twice, to be handed out to two owners.  A DEBUG build
+* looks for blk on the free list first and refuses it, at the cost of a
+* walk of the list with interrupts masked.
+*
+* @param p pool
+* @param blk block from Pool_alloc on the same pool
+*
+* @return 0 on success, -1 if blk isn't a block of this pool, or in a
+*         DEBUG build is already free.
+*/
+int32_t Pool_free(POOL *p, void *blk);
+
+#endif /* POOL_H_ */
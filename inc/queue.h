@@ -0,0 +1,155 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file queue.h
+* @brief A typed queue of fixed size records
+*
+* This header file provides a macro that builds a ring buffer of one
+* record type, moved whole with 32 bit loads and stores, for passing
+* samples, events and jobs between stages
+*
+* @author Jon Warriner
+* @date June 29 2019
+* @version 1.0
+*
+*/
+
+#ifndef QUEUE_H_
+#define QUEUE_H_
+
+#include <stdint.h>
+#include "MKL25Z4.h"
+
+//records are copied through this so the word accesses may alias them
+typedef uint32_t __attribute__((may_alias)) QUEUE_WORD;
+
+//copy one record a word at a time, n is a constant so this unrolls
+__attribute__((always_inline)) static inline void Queue_copy(QUEUE_WORD *d, const QUEUE_WORD *s, uint32_t n)
+{
+	uint32_t i;
+
+	for(i = 0; i < n; i++)
+	{
+		d[i] = s[i];
+	}
+}
+
+/**
+* @brief Define a queue type and its functions
+*
+* Builds qtype, a queue of length records of type rec, and the functions
+*   void    prefix_init(qtype *q)
+*   int32_t prefix_push(qtype *q, const rec *r)   0, or -1 when full
+*   int32_t prefix_pop(qtype *q, rec *r)          0, or -1 when empty
+*   rec    *prefix_slot(qtype *q)                 next free slot, or 0
+*   void    prefix_commit(qtype *q)               add the filled slot
+*   rec    *prefix_peek(qtype *q)                 oldest record, or 0
+*   void    prefix_drop(qtype *q)                 remove the oldest record
+*   int32_t prefix_entries(qtype *q)
+* slot/commit and peek/drop work in place, for records too big to copy.
+*
+* Like ring_t it is safe with one producer and one consumer (e.g. an ISR
+* and a task) and no critical section.  rec must be a whole number of
+* words and word aligned, and length a power of 2; both are checked at
+* compile time.
+*
+* @param qtype  Name of the queue type
+* @param prefix Prefix of the function names
+* @param rec    Record type
+* @param length Number of records
+*/
+#define QUEUE_DEFINE(qtype, prefix, rec, length)												\
+	_Static_assert(((sizeof(rec) % 4) == 0) && (__alignof__(rec) >= 4),							\
+				   #rec " must be a whole number of aligned words");							\
+	_Static_assert(((length) > 0) && (((length) & ((length) - 1)) == 0),						\
+				   #qtype " length must be a power of 2");										\
+																								\
+	typedef struct																				\
+	{																							\
+		rec slot[length];																		\
+		volatile uint32_t in;																	\
+		volatile uint32_t out;																	\
+	} qtype;																					\
+																								\
+	static inline void prefix##_init(qtype *q)													\
+	{																							\
+		q->in = 0;																				\
+		q->out = 0;																				\
+	}																							\
+																								\
+	static inline rec *prefix##_slot(qtype *q)													\
+	{																							\
+		uint32_t in = q->in;																	\
+																								\
+		if((in - q->out) >= (length))															\
+		{																						\
+			return(0);																			\
+		}																						\
+		__DMB();																				\
+		return(&q->slot[in & ((length) - 1)]);													\
+	}																							\
+																								\
+	static inline void prefix##_commit(qtype *q)												\
+	{																							\
+		__DMB();																				\
+		q->in = q->in + 1;																		\
+	}																							\
+																								\
+	static inline rec *prefix##_peek(qtype *q)													\
+	{																							\
+		uint32_t out = q->out;																	\
+																								\
+		if(out == q->in)																		\
+		{																						\
+			return(0);																			\
+		}																						\
+		__DMB();																				\
+		return(&q->slot[out & ((length) - 1)]);													\
+	}																							\
+																								\
+	static inline void prefix##_drop(qtype *q)													\
+	{																							\
+		__DMB();																				\
+		q->out = q->out + 1;																	\
+	}																							\
+																								\
+	static inline int32_t prefix##_push(qtype *q, const rec *r)									\
+	{																							\
+		rec *s = prefix##_slot(q);																\
+																								\
+		if(s == 0)																				\
+		{																						\
+			return(-1);																			\
+		}																						\
+		Queue_copy((QUEUE_WORD *)s, (const QUEUE_WORD *)r, sizeof(rec) / 4);						\
+		prefix##_commit(q);																		\
+		return(0);																				\
+	}																							\
+																								\
+	static inline int32_t prefix##_pop(qtype *q, rec *r)										\
+	{																							\
+		rec *s = prefix##_peek(q);																\
+																								\
+		if(s == 0)																				\
+		{																						\
+			return(-1);																			\
+		}																						\
+		Queue_copy((QUEUE_WORD *)r, (const QUEUE_WORD *)s, sizeof(rec) / 4);						\
+		prefix##_drop(q);																		\
+		return(0);																				\
+	}																							\
+																								\
+	static inline int32_t prefix##_entries(qtype *q)											\
+	{																							\
+		return((int32_t)(q->in - q->out));														\
+	}
+
+#endif /* QUEUE_H_ */
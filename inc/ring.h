@@ -27,28 +27,58 @@
 
 #include <stdint.h>
 
+//1 to build ring_init(), which takes the buffers from the heap.  Left at
+//0 the image doesn't link malloc at all; use RING_DEFINE instead.
+#ifndef RING_USE_HEAP
+#define RING_USE_HEAP	0
+#endif
+
 /**
-* define the ring buffer structured data type
+* define the ring buffer structured data type.  It is safe to share
+* between one producer and one consumer (e.g. a task and an ISR)
+* without disabling interrupts.  Ini and Outi are free running counts
+* that wrap at 2^32; only the producer writes Ini and only the consumer
+* writes Outi.
 */
 typedef struct
 {
     char *Buffer;
-    int32_t Length;
-    int32_t Ini;
-    int32_t Outi;
+    uint32_t Length;
+    volatile uint32_t Ini;
+    volatile uint32_t Outi;
 }ring_t;
 
+/**
+* @brief Define a ring buffer and its storage at compile time
+*
+* Places length chars of storage in .bss and a ring_t called name,
+* already pointing at it, in .data.  No heap and no init call; the
+* length is checked at compile time.  Use &name wherever a ring_t
+* pointer is wanted.
+*
+* @param name   Name of the ring_t variable
+* @param length Length of buffer in chars, must be a power of 2
+*/
+#define RING_DEFINE(name, length)                                                   \
+    _Static_assert(((length) > 0) && (((length) & ((length) - 1)) == 0),            \
+                   "ring " #name " length must be a power of 2");                   \
+    static char name##_storage[length];                                             \
+    ring_t name = { name##_storage, (length), 0, 0 }
+
+#if RING_USE_HEAP
 /**
 * @brief Create a new ring buffer of "length" chars
 *
 * Given a length (in chars) return a pointer to a new
-* ring_t type.  Return 0 on failure.  
+* ring_t type.  Return 0 on failure.  Both come from the heap,
+* see RING_DEFINE for an image without one.
 *
-* @param length Length of buffer in chars
+* @param length Length of buffer in chars, must be a power of 2
 *
 * @return pointer to ring_t type or 0 on failure
 */
 ring_t *ring_init( int32_t length );
+#endif
 
 /**
 * @brief Insert a new char into the buffer
@@ -89,4 +119,77 @@ int32_t extract( ring_t *ring, char *data );
 */
 int32_t entries( ring_t *ring );
 
+/**
+* @brief Insert a block of chars into the buffer
+*
+* Copies as much of data as there is room for, in at most two
+* memcpy()s (up to the end of the storage, then from the start).
+*
+* @param ring_t Pointer to an already initialized ring buffer
+* @param data   Data to add to the buffer
+* @param len    Number of chars in data
+*
+* @return number of chars inserted, -1 on error
+*/
+int32_t insert_block( ring_t *ring, const char *data, int32_t len );
+
+/**
+* @brief Extract (remove) a block of chars from the buffer
+*
+* Copies up to len of the oldest chars in at most two memcpy()s.
+*
+* @param ring_t Pointer to an already initialized ring buffer
+* @param data   Where to write the extracted data
+* @param len    Room in data
+*
+* @return number of chars extracted, -1 on error
+*/
+int32_t extract_block( ring_t *ring, char *data, int32_t len );
+
+/**
+* @brief Get the readable data that is contiguous in the storage
+*
+* Lets a consumer (or a DMA channel) read straight out of the ring.
+* Anything past the end of the storage shows up in the next span once
+* this one has been committed.
+*
+* @param ring_t Pointer to an already initialized ring buffer
+* @param span   Set to the oldest char in the buffer
+*
+* @return number of chars readable at *span, -1 on error
+*/
+int32_t peek_span( ring_t *ring, char **span );
+
+/**
+* @brief Remove chars that were read through peek_span()
+*
+* @param ring_t Pointer to an already initialized ring buffer
+* @param len    Number of chars consumed, at most the last span length
+*
+* @return 0 on success, -1 on failure
+*/
+int32_t commit_read( ring_t *ring, int32_t len );
+
+/**
+* @brief Get the free space that is contiguous in the storage
+*
+* Lets a producer format straight into the ring.
+*
+* @param ring_t Pointer to an already initialized ring buffer
+* @param span   Set to the first free char
+*
+* @return number of chars writable at *span, -1 on error
+*/
+int32_t write_span( ring_t *ring, char **span );
+
+/**
+* @brief Add chars that were written through write_span()
+*
+* @param ring_t Pointer to an already initialized ring buffer
+* @param len    Number of chars written, at most the last span length
+*
+* @return 0 on success, -1 on failure
+*/
+int32_t commit_write( ring_t *ring, int32_t len );
+
 #endif
@@ -0,0 +1,105 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file spectrum.h
+* @brief An abstraction for the vibration spectrum mode
+*
+* This header file provides an abstraction of the functions to
+* collect acceleration windows, transform them and report the
+* spectrum over the serial port
+*
+* @author Jon Warriner
+* @date June 26 2019
+* @version 1.0
+*
+*/
+
+#ifndef SPECTRUM_H_
+#define SPECTRUM_H_
+
+#include <stdint.h>
+#include "ring.h"
+#include "fft.h"
+
+#define SPEC_PEAKS		4				//peaks reported per window
+#define SPEC_BINS		(FFT_N / 2)		//Nyquist bin, DC .. SPEC_BINS inclusive
+
+typedef enum
+{
+	SPEC_REPORT_PEAKS = 0,			//the SPEC_PEAKS largest local maxima
+	SPEC_REPORT_FULL				//every bin, SPEC_BINS + 1 lines
+} SPEC_REPORT;
+
+typedef enum
+{
+	SPEC_COLLECT = 0,
+	SPEC_SEND
+} SPEC_STATE;
+
+/**
+* define the spectrum structured data type.  buf is the FFT working
+* buffer while collecting and transforming, and holds the bin magnitudes
+* in buf[k].re afterwards.
+*/
+typedef struct _SPECTRUM_
+{
+	FFT_CPX buf[FFT_N];
+	uint16_t idx;					//samples collected / lines sent
+	SPEC_STATE state;
+	SPEC_REPORT report;
+	uint32_t fs_chz;				//sample rate in hundredths of a Hz
+	uint16_t one_g;					//1g in input counts
+	uint16_t peak_bin[SPEC_PEAKS];
+	uint8_t peaks;					//valid entries in peak_bin
+	char sbuf[32];
+} SPECTRUM;
+
+/**
+* @brief Initialize the spectrum mode
+*
+* @param s spectrum
+* @param fs_chz sample rate in hundredths of a Hz, e.g. 80000 for 800Hz
+* @param one_g 1g in input counts, MMA8451Q_One_G() for the current range.
+*        Call again after changing the range.
+* @param report peaks or full spectrum
+*
+* @return void.
+*/
+void Spectrum_init(SPECTRUM *s, uint32_t fs_chz, uint16_t one_g, SPEC_REPORT report);
+
+/**
+* @brief Add samples to the current window
+*
+* Samples that arrive while the last window is still being sent are
+* dropped, so every window is FFT_N contiguous samples.
+*
+* @return void.
+*/
+void Spectrum_add(SPECTRUM *s, int16_t x);
+void Spectrum_add_block(SPECTRUM *s, const int16_t *x, uint16_t n);
+
+/**
+* @brief Run the spectrum mode
+*
+* Once a window is full: remove the mean, apply a Hann window, FFT and
+* take magnitudes.  Then send one line per call whenever the output
+* buffer is empty:
+* "<freq> Hz <amplitude> mg" for each peak, or "<freq> <amplitude>" for
+* each bin from DC to Nyquist.  Amplitude is the peak amplitude of a sine at that bin.
+*
+* @param obuf output ring buffer
+* @param tx_func function to trigger transmission of the output buffer
+*
+* @return void.
+*/
+void Spectrum_task(SPECTRUM *s, ring_t *obuf, void (*tx_func)());
+
+#endif /* SPECTRUM_H_ */
@@ -0,0 +1,110 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file stats.h
+* @brief An abstraction for the streaming vibration statistics
+*
+* This header file provides an abstraction of the functions to
+* summarize acceleration data per window
+*
+* @author Jon Warriner
+* @date June 28 2019
+* @version 1.0
+*
+*/
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdint.h>
+#include "ring.h"
+
+/**
+* define the running sums of one axis.  64 bit sums can't overflow for
+* any window that fits a uint16_t.
+*/
+typedef struct _STATS_ACC_
+{
+	int64_t sum;
+	uint64_t sumsq;
+	int16_t min;
+	int16_t max;
+} STATS_ACC;
+
+/**
+* define the summary of one axis over a window, in raw counts
+*/
+typedef struct _STATS_RESULT_
+{
+	int16_t mean;
+	int16_t min;
+	int16_t max;
+	uint16_t rms;					//including the mean
+	uint16_t ac_rms;				//about the mean, i.e. standard deviation
+	uint16_t peak;					//largest |x - mean|
+	uint16_t crest;					//peak / ac_rms in hundredths
+} STATS_RESULT;
+
+typedef struct _STATS_
+{
+	STATS_ACC acc[3];
+	uint16_t len;					//samples per window
+	uint16_t n;						//samples into the current window
+	STATS_RESULT res[3];			//x y z of the last window
+	volatile uint8_t ready;			//set when res is new, cleared once it has been sent
+	uint8_t line;					//next axis to send
+	char sbuf[48];
+} STATS;
+
+/**
+* @brief Initialize the statistics
+*
+* @param len window length in samples
+*
+* @return void.
+*/
+void Stats_init(STATS *s, uint16_t len);
+
+/**
+* @brief Add one sample
+*
+* One add, one 16x16 multiply and a 64 bit add per axis.  At the end of
+* a window the results are published, unless the last ones have not been
+* sent yet, and the sums restart.
+*
+* @return 1 at the end of a window.
+*/
+uint8_t Stats_run(STATS *s, int16_t x, int16_t y, int16_t z);
+
+/**
+* @brief Add a block of samples
+*
+* @param x, y, z acceleration, n samples each, e.g. an MMA8451Q_BLOCK
+*
+* @return 1 if at least one window ended.
+*/
+uint8_t Stats_block(STATS *s, const int16_t *x, const int16_t *y, const int16_t *z, uint16_t n);
+
+/**
+* @brief Send the last window's results
+*
+* One line per axis, each sent when the output buffer is empty:
+* "<axis> <mean> sd <ac_rms> pk <peak> cf <crest>", sd being the ac rms,
+* the standard deviation about the mean
+*
+* @param obuf output ring buffer
+* @param tx_func function to trigger transmission of the output buffer
+*
+* @return void.
+*/
+void Stats_task(STATS *s, ring_t *obuf, void (*tx_func)());
+
+#endif /* STATS_H_ */
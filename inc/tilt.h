@@ -0,0 +1,113 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file tilt.h
+* @brief An abstraction for the tilt limit event detector
+*
+* This header file provides an abstraction of the functions to
+* detect when the board tips past a limit and report it as events
+*
+* @author Jon Warriner
+* @date June 28 2019
+* @version 1.0
+*
+*/
+
+#ifndef TILT_H_
+#define TILT_H_
+
+#include <stdint.h>
+#include "ring.h"
+#include "queue.h"
+
+#define TILT_EVENTS		4				//events waiting to be sent, power of 2
+
+/**
+* define the detector settings, angles in ANGLE_SCALE units
+*/
+typedef struct _TILT_CFG_
+{
+	int16_t pitch_limit;			//|pitch| past this is tipped
+	int16_t roll_limit;				//|roll| past this is tipped
+	int16_t hyst;					//both must come back under limit - hyst to recover
+	uint16_t debounce;				//samples in a row needed to change state
+} TILT_CFG;
+
+typedef enum
+{
+	TILT_NONE = 0,
+	TILT_TIPPED,
+	TILT_LEVEL
+} TILT_EVENT_TYPE;
+
+//a queue record must be whole words, and arm-none-eabi enums are only as
+//wide as their values, so the type is kept in a uint32_t
+typedef struct _TILT_EVENT_
+{
+	uint32_t type;					//TILT_EVENT_TYPE
+	int16_t pitch;
+	int16_t roll;
+} TILT_EVENT;
+
+QUEUE_DEFINE(TILT_QUEUE, Tilt_queue, TILT_EVENT, TILT_EVENTS)
+
+typedef struct _TILT_
+{
+	TILT_CFG cfg;
+	uint8_t tipped;					//current debounced state
+	uint16_t count;					//samples in a row that disagree with the state
+	TILT_QUEUE ev;					//events waiting to be sent
+	uint32_t ev_lost;				//events dropped because the queue was full
+	char sbuf[24];
+} TILT;
+
+/**
+* @brief Initialize the detector
+*
+* Starts in the level state.
+*
+* @return void.
+*/
+void Tilt_init(TILT *t, const TILT_CFG *cfg);
+
+/**
+* @brief Run one sample through the detector
+*
+* Samples flagged dynamic by Calc_angles are ignored: they neither count
+* towards a change nor reset the debounce count.
+*
+* @return TILT_TIPPED or TILT_LEVEL when the state changes, else TILT_NONE.
+*/
+TILT_EVENT_TYPE Tilt_run(TILT *t, int16_t pitch, int16_t roll, uint8_t dynamic);
+
+/**
+* @brief Run a block of samples through the detector
+*
+* @param dynamic per sample dynamic flags, or 0
+*
+* @return the last state change in the block, or TILT_NONE.
+*/
+TILT_EVENT_TYPE Tilt_block(TILT *t, const int16_t *pitch, const int16_t *roll, const uint8_t *dynamic, uint16_t n);
+
+/**
+* @brief Send the next queued event
+*
+* One event per call, sent when the output buffer is empty, as
+* "TILT <pitch> <roll>" or "LEVEL <pitch> <roll>".
+*
+* @param obuf output ring buffer
+* @param tx_func function to trigger transmission of the output buffer
+*
+* @return void.
+*/
+void Tilt_task(TILT *t, ring_t *obuf, void (*tx_func)());
+
+#endif /* TILT_H_ */
@@ -0,0 +1,57 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file timer.h
+* @brief An abstraction for the SysTick time base
+*
+* This header file provides an abstraction of the functions to
+* read a free running microsecond time base
+*
+* @author Jon Warriner
+* @date June 20 2019
+* @version 1.0
+*
+*/
+
+#ifndef TIMER_H_
+#define TIMER_H_
+
+#include <stdint.h>
+
+/**
+* @brief Initialize the time base
+*
+* Configure SysTick for a 1ms interrupt off the core clock.  SysTick
+* is given the highest priority so the time base stays correct when
+* it is read from other ISRs.
+*
+* @return void.
+*/
+void Timer_init();
+
+/**
+* @brief Read the time base
+*
+* Free running microsecond count.  Wraps every ~71 minutes, so only
+* use differences of two readings.
+*
+* @return microseconds since Timer_init().
+*/
+uint32_t Timer_us();
+
+/**
+* @brief Read the millisecond tick
+*
+* @return milliseconds since Timer_init().
+*/
+uint32_t Timer_ms();
+
+#endif /* TIMER_H_ */
@@ -20,15 +20,21 @@
 *
 */
  
-#include <stdio.h>
 #include "clock_config.h"
 #include "uart.h"
 #include "i2c.h"
+#include "timer.h"
 #include "MMA8451Q.h"
 #include "led.h"
 #include "ring.h"
 #include "disp.h"
 #include "angles.h"
+#include "filter.h"
+#include "calib.h"
+#include "spectrum.h"
+#include "goertzel.h"
+#include "stats.h"
+#include "tilt.h"
 #include "MKL25Z4.h"
 
 //#define PART_2
@@ -36,40 +42,133 @@
 //#define PART_4
 #define PART_5
 
-#define TX_BUF_SIZE	32
+//report the vibration spectrum of Z instead of the angle display
+//#define SPECTRUM_MODE
+//report per second vibration statistics instead of the angle display
+//#define STATS_MODE
+//send only tilt limit events instead of the angle display
+//#define TILT_MODE
+//report the amplitude of a few machine frequencies instead of the angle display
+//#define TONE_MODE
 
-ring_t *tx_buf = 0;
+#define TX_BUF_SIZE	64
+
+//accelerometer output data rate.  The low pass, spectrum and tone
+//detector are all designed from it at compile time.
+#define ACCEL_ODR		MMA8451Q_ODR_800HZ
+#define ACCEL_FS_CHZ	MMA8451Q_ODR_CHZ(ACCEL_ODR)
+//samples per FIFO drain, 0 to poll the output registers instead
+#define ACCEL_FIFO_WMRK	16
+//MMA8451Q interrupt pin that triggers sample reads, 0 to poll
+#define ACCEL_INT_PIN	1
+//samples to average for the offset register auto zero at start up, board
+//must be flat.  0 leaves OFF_X/Y/Z at their reset value.
+#define ACCEL_AUTO_ZERO	0
+//cutoff of the low pass ahead of the angle calculation, in Hz
+#define ACCEL_LP_HZ		20
+//samples averaged into each display update, 800Hz / 80 = 10 updates/s
+#define DISP_DECIM_RATIO	80
+#define DISP_DECIM_ORDER	1
+//tone detector block, 400 samples at 800Hz = 2Hz bins, 2 blocks/s
+#define TONE_LEN		400
+//statistics window, 800 samples at 800Hz = 1 report/s
+#define STATS_LEN		800
+
+RING_DEFINE(tx_ring, TX_BUF_SIZE);
+ring_t *tx_buf = &tx_ring;
 
 disp_t disp = {0};
 
-I2C_Packet gPacket = {0};
+I2C_Queue gI2C = {0};
+
+_Static_assert(ACCEL_FIFO_WMRK <= MMA8451Q_FIFO_SIZE, "ACCEL_FIFO_WMRK is more than the FIFO holds");
+MMA8451Q accel = {.fifo_wmrk = ACCEL_FIFO_WMRK, .int_pin = ACCEL_INT_PIN,
+                  .cfg = {.odr = ACCEL_ODR, .mods = MMA8451Q_MODS_NORMAL, .range = MMA8451Q_RANGE_2G}};
+
+//per device calibration, from Calib_solve on six orientation captures
+const CALIB_PARAM accel_calib = CALIB_IDENTITY;
+
+_Static_assert((ACCEL_LP_HZ * 400) <= ACCEL_FS_CHZ, "ACCEL_LP_HZ must be under a quarter of the ODR");
+const BIQUAD_COEF accel_lp[2] = BIQUAD_BW4_LP(ACCEL_LP_HZ, ACCEL_FS_CHZ / 100.0);
+ACCEL_FILTER accel_filt = {0};
+
+#ifdef SPECTRUM_MODE
+SPECTRUM spec;
+#endif
 
-MMA8451Q accel = {0};
+#ifdef TONE_MODE
+//machine frequencies to watch on Z, all under half the ODR
+_Static_assert((120 * 200) < ACCEL_FS_CHZ, "tone above the Nyquist frequency");
+const uint16_t tone_freq[] = { 50, 100, 120 };
+const int16_t tone_coef[] = { GOERTZEL_COEF(50, ACCEL_FS_CHZ / 100.0), GOERTZEL_COEF(100, ACCEL_FS_CHZ / 100.0),
+                              GOERTZEL_COEF(120, ACCEL_FS_CHZ / 100.0) };
+GOERTZEL tones;
+#endif
+
+#ifdef STATS_MODE
+STATS stats;
+#endif
+
+//tipped past 30 degrees either way for 0.1s at 800Hz, level again under 25
+const TILT_CFG tilt_cfg = {.pitch_limit = 30 * ANGLE_SCALE, .roll_limit = 30 * ANGLE_SCALE,
+                           .hyst = 5 * ANGLE_SCALE, .debounce = 80};
+TILT tilt;
+
+_Static_assert((DISP_DECIM_RATIO > 0) && (DISP_DECIM_ORDER > 0) && (DISP_DECIM_ORDER <= DECIM_MAX_ORDER) &&
+               (DECIM_GAIN(DISP_DECIM_RATIO, DISP_DECIM_ORDER) <= 0x10000), "Decim_init would refuse the display decimator");
+DECIM disp_decim = {0};
+int16_t disp_val = 0;
 
 ANGLE_DATA angles = {0};
 
+MMA8451Q_DATA sample = {0};
+uint32_t sample_seq = 0;
+
+int16_t block_pitch[MMA8451Q_FIFO_SIZE];
+int16_t block_roll[MMA8451Q_FIFO_SIZE];
+uint8_t block_dynamic[MMA8451Q_FIFO_SIZE];
+
 /*
  * @brief   Application entry point.
  */
 int main(void) {
+    TILT_EVENT_TYPE tilt_ev;
+
   	/* Init board hardware. */
     BOARD_InitBootClocks();
 
     //Inialize the GPIO for LED blinking
     LED_init();
 
-    tx_buf = ring_init(TX_BUF_SIZE);
     //Initialize the display module
     disp_init(&disp, tx_buf, &UART_EN_TX_INT);
 
     //Initialize UART0
     UART_init();
 
+    //Initialize the time base
+    Timer_init();
+
     //Initialize the I2C module
-    I2C_init(&gPacket);
+    I2C_init(&gI2C);
+
+#if ACCEL_AUTO_ZERO
+    MMA8451Q_Auto_Zero(&accel, ACCEL_AUTO_ZERO);
+#endif
 
-    //just letting this print to the console window to let me know the code started.
-    printf("Hello World\n");
+    //Initialize the accelerometer low pass filter
+    Filter_init(&accel_filt, accel_lp, 2);
+    Decim_init(&disp_decim, DISP_DECIM_RATIO, DISP_DECIM_ORDER);
+    Tilt_init(&tilt, &tilt_cfg);
+#ifdef TONE_MODE
+    Goertzel_init(&tones, tone_coef, sizeof(tone_coef) / sizeof(tone_coef[0]), TONE_LEN);
+#endif
+#ifdef SPECTRUM_MODE
+    Spectrum_init(&spec, ACCEL_FS_CHZ, MMA8451Q_One_G(&accel), SPEC_REPORT_PEAKS);
+#endif
+#ifdef STATS_MODE
+    Stats_init(&stats, STATS_LEN);
+#endif
 
     /* Force the counter to be placed into memory. */
     volatile static int i = 0 ;
@@ -77,13 +176,89 @@ int main(void) {
     /* Enter an infinite loop, just incrementing a counter. */
     while(1) {
         i++;
+#if defined(SPECTRUM_MODE)
+        Spectrum_task(&spec, tx_buf, &UART_EN_TX_INT);
+#elif defined(STATS_MODE)
+        Stats_task(&stats, tx_buf, &UART_EN_TX_INT);
+#elif defined(TILT_MODE)
+        Tilt_task(&tilt, tx_buf, &UART_EN_TX_INT);
+#elif defined(TONE_MODE)
+        Goertzel_task(&tones, tone_freq, MMA8451Q_One_G(&accel), tx_buf, &UART_EN_TX_INT);
+#else
         Display_task(&disp);
-        Display_New_Val(&disp,accel.data.data.x_data);
-       	Update_MMA8451Q(&accel, &gPacket);
-        I2C_POLL(&gPacket);
-        Check_I2C_Callback(&gPacket, (void *)&accel);
+#endif
+       	Update_MMA8451Q(&accel, &gI2C);
+#ifdef I2C_POLLED
+        I2C_POLL(&gI2C);
+#endif
+        I2C_Service(&gI2C);
+        Check_I2C_Callback(&gI2C);
 
-        Calc_angles(&accel.data.data, &angles);
+        tilt_ev = TILT_NONE;
+        if(accel.fifo_wmrk == 0)
+        {
+            //only recalculate when the driver has published a new sample
+            if(MMA8451Q_Read_Sample(&accel, &sample, &sample_seq))
+            {
+                Calib_sample(&accel_calib, &sample);
+#ifdef TONE_MODE
+                Goertzel_run(&tones, sample.z_data);
+#endif
+#ifdef STATS_MODE
+                Stats_run(&stats, sample.x_data, sample.y_data, sample.z_data);
+#endif
+#ifdef SPECTRUM_MODE
+                //vibration needs the samples before the low pass
+                Spectrum_add(&spec, sample.z_data);
+#endif
+                Filter_sample(&accel_filt, &sample);
+                Calc_angles(&sample, &angles, MMA8451Q_One_G(&accel));
+                tilt_ev = Tilt_run(&tilt, angles.pitch, angles.roll, angles.dynamic);
+                //every sample goes into the display average
+                if(Decim_run(&disp_decim, sample.x_data, &disp_val))
+                {
+                    Display_New_Val(&disp, disp_val);
+                }
+            }
+        }
+        else if(accel.block.ready)
+        {
+            //calibrate, filter, then run the whole block through the angle calculation
+            Calib_block(&accel_calib, accel.block.x, accel.block.y, accel.block.z, accel.block.count);
+#ifdef TONE_MODE
+            Goertzel_block(&tones, accel.block.z, accel.block.count);
+#endif
+#ifdef STATS_MODE
+            Stats_block(&stats, accel.block.x, accel.block.y, accel.block.z, accel.block.count);
+#endif
+#ifdef SPECTRUM_MODE
+            Spectrum_add_block(&spec, accel.block.z, accel.block.count);
+#endif
+            Filter_block(&accel_filt, accel.block.x, accel.block.y, accel.block.z, accel.block.count);
+            Calc_angles_block(accel.block.x, accel.block.y, accel.block.z,
+                              block_pitch, block_roll, block_dynamic, MMA8451Q_One_G(&accel), accel.block.count);
+            angles.pitch = block_pitch[accel.block.count - 1];
+            angles.roll = block_roll[accel.block.count - 1];
+            angles.dynamic = block_dynamic[accel.block.count - 1];
+            tilt_ev = Tilt_block(&tilt, block_pitch, block_roll, block_dynamic, accel.block.count);
+            if(Decim_block(&disp_decim, accel.block.x, accel.block.count, &disp_val))
+            {
+                Display_New_Val(&disp, disp_val);
+            }
+            //hand the block back to the driver so it can drain the FIFO again
+            accel.block.ready = 0;
+            MMA8451Q_Read_Sample(&accel, &sample, &sample_seq);
+        }
+
+        //LED on while tipped past the limit
+        if(tilt_ev == TILT_TIPPED)
+        {
+            LED_set();
+        }
+        else if(tilt_ev == TILT_LEVEL)
+        {
+            LED_clear();
+        }
     }
     return 0 ;
 }
@@ -106,3 +281,17 @@ char temp;
 		}
 	}
 }
+
+#ifndef I2C_POLLED
+void I2C0_DriverIRQHandler(void)
+{
+	//each byte on the bus raises IICIF, advance the master state machine right away
+	Run_I2C_Master(&gI2C);
+}
+#endif
+
+void PORTA_DriverIRQHandler(void)
+{
+	//the accelerometer has a new sample (or a full watermark) for us
+	MMA8451Q_INT_ISR(&accel, &gI2C);
+}
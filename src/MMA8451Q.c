@@ -20,246 +20,869 @@
 *
 */
 
+#include "MKL25Z4.h"
 #include "MMA8451Q.h"
 
+static uint8_t MMA8451Q_INT_Pin(MMA8451Q *m)
+{
+	return((m->int_pin == 1) ? MMA8451Q_INT1_PIN : MMA8451Q_INT2_PIN);
+}
+
+static uint8_t MMA8451Q_Ctrl_Reg1(MMA8451Q *m)
+{
+	uint8_t ctrl_reg1 = (m->cfg.odr << CTRL_REG1_DR_SHIFT) & CTRL_REG1_DR_MASK;
+
+	// the FIFO only works with 14-bit data
+	if((m->fifo_wmrk == 0) && m->cfg.f_read)
+	{
+		ctrl_reg1 |= CTRL_REG1_F_READ;
+	}
+
+	return(ctrl_reg1);
+}
+
+static void MMA8451Q_Publish(MMA8451Q *m)
+{
+	// the back buffer has to be complete before it becomes the front
+	__DMB();
+	m->snap.front ^= 1;
+	m->snap.seq++;
+}
 
-uint8_t I2C_Read_WHO_AM_I(uint8_t slaveAddr, I2C_Packet *packet)
+uint8_t MMA8451Q_Read_Sample(MMA8451Q *m, MMA8451Q_DATA *d, uint32_t *seq)
 {
+	uint32_t s;
+
+	s = m->snap.seq;
+	if(s == *seq)
+	{
+		// nothing new
+		return 0;
+	}
+
+	// if a publish lands while we copy, copy again
+	do
+	{
+		s = m->snap.seq;
+		__DMB();
+		*d = m->snap.buf[m->snap.front].data;
+		__DMB();
+	} while(s != m->snap.seq);
+
+	*seq = s;
+	return 1;
+}
+
+
+uint8_t I2C_Read_WHO_AM_I(uint8_t slaveAddr, I2C_Queue *q)
+{
+	I2C_Packet packet = {0};
 	uint8_t error;
 
-	packet->command = WHO_AM_I;
-	packet->slaveAddress = slaveAddr;
-	//packet->i2c_callback = I2C_Read_UI_Status_CB;
+	packet.command = WHO_AM_I;
+	packet.slaveAddress = slaveAddr;
+	packet.byteCount = 1;
+	packet.priority = I2C_PRI_LOW;
+	//packet.i2c_callback = I2C_Read_UI_Status_CB;
 
-	error = I2C_Read(packet);
+	error = I2C_Read(q, &packet);
 
 	return(error);
 }
 
-uint8_t I2C_Write_XYZ_DATA_CFG(uint8_t slaveAddr, uint8_t data, I2C_Packet *packet)
+uint8_t I2C_Write_CB(uint8_t *data, uint8_t count, void *p)
 {
-	packet->command = XYZ_DATA_CFG;
-	packet->slaveAddress = slaveAddr;
+	MMA8451Q *m = (MMA8451Q *)p;
 
-	packet->data[0] = data;
+	(void)data;
 
-	return I2C_Write(packet);
+	m->pending--;
+
+	// a byteCount of 0 means the write never made it to the sensor
+	if(count == 0)
+	{
+		m->write_err = 1;
+		m->write_fails++;
+		return 1;
+	}
+
+	return 0;
 }
 
-uint8_t I2C_Write_CTRL_REG1(uint8_t slaveAddr, uint8_t data, I2C_Packet *packet)
+uint8_t I2C_Write_XYZ_DATA_CFG(uint8_t slaveAddr, uint8_t data, MMA8451Q *m, I2C_Queue *q)
 {
-	packet->command = CTRL_REG1;
-	packet->slaveAddress = slaveAddr;
+	I2C_Packet packet = {0};
+
+	packet.command = XYZ_DATA_CFG;
+	packet.slaveAddress = slaveAddr;
+	packet.byteCount = 1;
+	packet.priority = I2C_PRI_LOW;
+	packet.i2c_callback = I2C_Write_CB;
+	packet.context = m;
 
-	packet->data[0] = data;
+	packet.data[0] = data;
 
-	return I2C_Write(packet);
+	return I2C_Write(q, &packet);
 }
 
-uint8_t I2C_Read_OUT_X_MSB(uint8_t slaveAddr, I2C_Packet *packet)
+uint8_t I2C_Write_CTRL_REG1(uint8_t slaveAddr, uint8_t data, MMA8451Q *m, I2C_Queue *q)
 {
-	uint8_t error;
+	I2C_Packet packet = {0};
 
-	packet->command = OUT_X_MSB;
-	packet->slaveAddress = slaveAddr;
-	packet->i2c_callback = I2C_Read_OUT_X_MSB_CB;
+	packet.command = CTRL_REG1;
+	packet.slaveAddress = slaveAddr;
+	packet.byteCount = 1;
+	packet.priority = I2C_PRI_LOW;
+	packet.i2c_callback = I2C_Write_CB;
+	packet.context = m;
 
-	error = I2C_Read(packet);
+	packet.data[0] = data;
 
-	return(error);
+	return I2C_Write(q, &packet);
 }
 
-uint8_t I2C_Read_OUT_X_MSB_CB(uint8_t data, void *p)
+uint8_t I2C_Write_CTRL_REG2(uint8_t slaveAddr, uint8_t data, MMA8451Q *m, I2C_Queue *q)
 {
-	MMA8451Q *m = (MMA8451Q *)p;
+	I2C_Packet packet = {0};
 
-	m->data.sdata.x_data_msb = data;
+	packet.command = CTRL_REG2;
+	packet.slaveAddress = slaveAddr;
+	packet.byteCount = 1;
+	packet.priority = I2C_PRI_LOW;
+	packet.i2c_callback = I2C_Write_CB;
+	packet.context = m;
 
-	return 0;
+	packet.data[0] = data;
+
+	return I2C_Write(q, &packet);
 }
 
-uint8_t I2C_Read_OUT_X_LSB(uint8_t slaveAddr, I2C_Packet *packet)
+uint8_t I2C_Write_F_SETUP(uint8_t slaveAddr, uint8_t data, MMA8451Q *m, I2C_Queue *q)
 {
-	uint8_t error;
+	I2C_Packet packet = {0};
 
-	packet->command = OUT_X_LSB;
-	packet->slaveAddress = slaveAddr;
-	packet->i2c_callback = I2C_Read_OUT_X_LSB_CB;
+	packet.command = F_SETUP;
+	packet.slaveAddress = slaveAddr;
+	packet.byteCount = 1;
+	packet.priority = I2C_PRI_LOW;
+	packet.i2c_callback = I2C_Write_CB;
+	packet.context = m;
 
-	error = I2C_Read(packet);
+	packet.data[0] = data;
 
-	return(error);
+	return I2C_Write(q, &packet);
 }
 
-uint8_t I2C_Read_OUT_X_LSB_CB(uint8_t data, void *p)
+uint8_t I2C_Write_CTRL_REG4(uint8_t slaveAddr, uint8_t data, MMA8451Q *m, I2C_Queue *q)
 {
-	MMA8451Q *m = (MMA8451Q *)p;
+	I2C_Packet packet = {0};
 
-	m->data.sdata.x_data_lsb = data;
+	packet.command = CTRL_REG4;
+	packet.slaveAddress = slaveAddr;
+	packet.byteCount = 1;
+	packet.priority = I2C_PRI_LOW;
+	packet.i2c_callback = I2C_Write_CB;
+	packet.context = m;
 
-	return 0;
+	packet.data[0] = data;
+
+	return I2C_Write(q, &packet);
+}
+
+uint8_t I2C_Write_CTRL_REG5(uint8_t slaveAddr, uint8_t data, MMA8451Q *m, I2C_Queue *q)
+{
+	I2C_Packet packet = {0};
+
+	packet.command = CTRL_REG5;
+	packet.slaveAddress = slaveAddr;
+	packet.byteCount = 1;
+	packet.priority = I2C_PRI_LOW;
+	packet.i2c_callback = I2C_Write_CB;
+	packet.context = m;
+
+	packet.data[0] = data;
+
+	return I2C_Write(q, &packet);
+}
+
+uint8_t I2C_Write_OFF_XYZ(uint8_t slaveAddr, const int8_t *off, MMA8451Q *m, I2C_Queue *q)
+{
+	I2C_Packet packet = {0};
+
+	// OFF_X, OFF_Y and OFF_Z are contiguous, one burst writes all three
+	packet.command = OFF_X;
+	packet.slaveAddress = slaveAddr;
+	packet.byteCount = 3;
+	packet.priority = I2C_PRI_LOW;
+	packet.i2c_callback = I2C_Write_CB;
+	packet.context = m;
+
+	packet.data[0] = (uint8_t)off[0];
+	packet.data[1] = (uint8_t)off[1];
+	packet.data[2] = (uint8_t)off[2];
+
+	return I2C_Write(q, &packet);
 }
 
-uint8_t I2C_Read_OUT_Y_MSB(uint8_t slaveAddr, I2C_Packet *packet)
+uint8_t I2C_Read_OUT_XYZ(uint8_t slaveAddr, MMA8451Q *m, I2C_Queue *q)
 {
+	I2C_Packet packet = {0};
 	uint8_t error;
 
-	packet->command = OUT_Y_MSB;
-	packet->slaveAddress = slaveAddr;
-	packet->i2c_callback = I2C_Read_OUT_Y_MSB_CB;
+	// The output registers are contiguous and the MMA8451Q auto-increments
+	// the register address, so all six bytes come back in one transaction.
+	packet.command = OUT_X_MSB;
+	packet.slaveAddress = slaveAddr;
+	// with F_READ the auto-increment skips the LSBs
+	packet.byteCount = (MMA8451Q_Ctrl_Reg1(m) & CTRL_REG1_F_READ) ? 3 : 6;
+	// sample reads must never wait behind configuration traffic
+	packet.priority = I2C_PRI_HIGH;
+	packet.i2c_callback = I2C_Read_OUT_XYZ_CB;
+	packet.context = m;
 
-	error = I2C_Read(packet);
+	error = I2C_Read(q, &packet);
 
 	return(error);
 }
 
-uint8_t I2C_Read_OUT_Y_MSB_CB(uint8_t data, void *p)
+static uint8_t MMA8451Q_Store_XYZ(MMA8451Q *m, const uint8_t *data, uint8_t count)
 {
-	MMA8451Q *m = (MMA8451Q *)p;
+	XYZ_DATA *back = &m->snap.buf[m->snap.front ^ 1];
 
-	m->data.sdata.y_data_msb = data;
+	if(count == 3)
+	{
+		// 8-bit fast read, MSBs only
+		back->sdata.x_data_msb = data[0];
+		back->sdata.x_data_lsb = 0;
+		back->sdata.y_data_msb = data[1];
+		back->sdata.y_data_lsb = 0;
+		back->sdata.z_data_msb = data[2];
+		back->sdata.z_data_lsb = 0;
+	}
+	else if(count >= 6)
+	{
+		back->sdata.x_data_msb = data[0];
+		back->sdata.x_data_lsb = data[1];
+		back->sdata.y_data_msb = data[2];
+		back->sdata.y_data_lsb = data[3];
+		back->sdata.z_data_msb = data[4];
+		back->sdata.z_data_lsb = data[5];
+	}
+	else
+	{
+		return 1;
+	}
+
+	MMA8451Q_Publish(m);
 
 	return 0;
 }
 
-uint8_t I2C_Read_OUT_Y_LSB(uint8_t slaveAddr, I2C_Packet *packet)
+uint8_t I2C_Read_OUT_XYZ_CB(uint8_t *data, uint8_t count, void *p)
 {
-	uint8_t error;
+	MMA8451Q *m = (MMA8451Q *)p;
 
-	packet->command = OUT_Y_LSB;
-	packet->slaveAddress = slaveAddr;
-	packet->i2c_callback = I2C_Read_OUT_Y_LSB_CB;
+	m->reads_done++;
 
-	error = I2C_Read(packet);
+	return(MMA8451Q_Store_XYZ(m, data, count));
+}
 
-	return(error);
+uint8_t I2C_Read_STATUS_XYZ(uint8_t slaveAddr, MMA8451Q *m, I2C_Queue *q)
+{
+	I2C_Packet packet = {0};
+
+	// STATUS sits just before OUT_X_MSB, so one burst gets the data ready
+	// flag and the sample it applies to.  FIFO off.  The auto zero samples
+	// with F_READ off whatever the configuration says.
+	packet.command = STATUS;
+	packet.slaveAddress = slaveAddr;
+	packet.byteCount = ((m->state != MMA8451Q_ZERO) && (MMA8451Q_Ctrl_Reg1(m) & CTRL_REG1_F_READ)) ? 4 : 7;
+	packet.priority = I2C_PRI_HIGH;
+	packet.i2c_callback = I2C_Read_STATUS_XYZ_CB;
+	packet.context = m;
+
+	return I2C_Read(q, &packet);
 }
 
-uint8_t I2C_Read_OUT_Y_LSB_CB(uint8_t data, void *p)
+uint8_t I2C_Read_STATUS_XYZ_CB(uint8_t *data, uint8_t count, void *p)
 {
 	MMA8451Q *m = (MMA8451Q *)p;
 
-	m->data.sdata.y_data_lsb = data;
+	m->reads_done++;
+
+	if(count < 4)
+	{
+		return 1;
+	}
+
+	// only publish a sample the sensor says is new
+	if(data[0] & STATUS_ZYXDR)
+	{
+		return(MMA8451Q_Store_XYZ(m, &data[1], count - 1));
+	}
 
 	return 0;
 }
 
-uint8_t I2C_Read_OUT_Z_MSB(uint8_t slaveAddr, I2C_Packet *packet)
+uint8_t I2C_Read_F_STATUS(uint8_t slaveAddr, MMA8451Q *m, I2C_Queue *q)
 {
-	uint8_t error;
+	I2C_Packet packet = {0};
 
-	packet->command = OUT_Z_MSB;
-	packet->slaveAddress = slaveAddr;
-	packet->i2c_callback = I2C_Read_OUT_Z_MSB_CB;
+	// STATUS reads as F_STATUS when the FIFO is enabled
+	packet.command = STATUS;
+	packet.slaveAddress = slaveAddr;
+	packet.byteCount = 1;
+	packet.priority = I2C_PRI_HIGH;
+	packet.i2c_callback = I2C_Read_F_STATUS_CB;
+	packet.context = m;
 
-	error = I2C_Read(packet);
-
-	return(error);
+	return I2C_Read(q, &packet);
 }
 
-uint8_t I2C_Read_OUT_Z_MSB_CB(uint8_t data, void *p)
+uint8_t I2C_Read_F_STATUS_CB(uint8_t *data, uint8_t count, void *p)
 {
 	MMA8451Q *m = (MMA8451Q *)p;
 
-	m->data.sdata.z_data_msb = data;
+	m->pending--;
+
+	if(count < 1)
+	{
+		return 1;
+	}
+
+	if(data[0] & F_STATUS_F_OVF)
+	{
+		m->fifo_ovf++;
+	}
+
+	// Drain once the watermark has been reached.  If MMA8451Q_Configure()
+	// or an auto zero started while this read was on the bus, step now
+	// belongs to that sequence, so leave it alone.
+	m->fifo_cnt = data[0] & F_STATUS_F_CNT_MASK;
+	if((m->state == MMA8451Q_RUN) && (m->fifo_cnt >= m->fifo_wmrk))
+	{
+		m->step = 1;
+	}
 
 	return 0;
 }
 
-uint8_t I2C_Read_OUT_Z_LSB(uint8_t slaveAddr, I2C_Packet *packet)
+uint8_t I2C_Read_FIFO(uint8_t slaveAddr, MMA8451Q *m, I2C_Queue *q)
 {
-	uint8_t error;
+	I2C_Packet packet = {0};
 
-	packet->command = OUT_Z_LSB;
-	packet->slaveAddress = slaveAddr;
-	packet->i2c_callback = I2C_Read_OUT_Z_LSB_CB;
+	// In FIFO mode the register address wraps from OUT_Z_LSB back to
+	// OUT_X_MSB, so one burst read drains fifo_cnt samples.
+	m->block.count = m->fifo_cnt;
 
-	error = I2C_Read(packet);
+	packet.command = OUT_X_MSB;
+	packet.slaveAddress = slaveAddr;
+	packet.byteCount = m->block.count * sizeof(MMA8451Q_DATA);
+	packet.buffer = m->block.raw;
+	packet.priority = I2C_PRI_HIGH;
+	packet.i2c_callback = I2C_Read_FIFO_CB;
+	packet.context = m;
 
-	return(error);
+	return I2C_Read(q, &packet);
 }
 
-uint8_t I2C_Read_OUT_Z_LSB_CB(uint8_t data, void *p)
+uint8_t I2C_Read_FIFO_CB(uint8_t *data, uint8_t count, void *p)
 {
 	MMA8451Q *m = (MMA8451Q *)p;
+	MMA8451Q_BLOCK *b = &m->block;
+	XYZ_DATA *back = &m->snap.buf[m->snap.front ^ 1];
+	uint8_t i;
+
+	m->reads_done++;
+	if(m->state == MMA8451Q_RUN)
+	{
+		m->step = 0;
+	}
+
+	if(count < sizeof(MMA8451Q_DATA))
+	{
+		return 1;
+	}
+
+	// the sensor sends MSB first, X Y Z interleaved
+	for(i = 0; i < b->count; i++, data += sizeof(MMA8451Q_DATA))
+	{
+		b->x[i] = (int16_t)((data[0] << 8) | data[1]);
+		b->y[i] = (int16_t)((data[2] << 8) | data[3]);
+		b->z[i] = (int16_t)((data[4] << 8) | data[5]);
+	}
 
-	m->data.sdata.z_data_lsb = data;
+	// keep the single sample view up to date with the newest sample
+	back->data.x_data = b->x[b->count - 1];
+	back->data.y_data = b->y[b->count - 1];
+	back->data.z_data = b->z[b->count - 1];
+	MMA8451Q_Publish(m);
+	b->ready = 1;
 
 	return 0;
 }
 
-void Init_MMA8451Q(MMA8451Q *m, I2C_Packet *packet)
+static void MMA8451Q_Zero_Restart(MMA8451Q *m)
+{
+	m->zero.sum[0] = 0;
+	m->zero.sum[1] = 0;
+	m->zero.sum[2] = 0;
+	m->zero.cnt = 0;
+	m->zero.seq = m->snap.seq;
+}
+
+void MMA8451Q_Configure(MMA8451Q *m, MMA8451Q_CONFIG *cfg)
+{
+	// stop the INT pin from starting new reads while we reconfigure
+	if(m->int_pin && (m->state == MMA8451Q_RUN))
+	{
+		PORTA->PCR[MMA8451Q_INT_Pin(m)] = PORT_PCR_MUX(1) | PORT_PCR_ISF_MASK;
+	}
+
+	// The samples in the FIFO were made with the old configuration, so
+	// they are drained and consumed before it changes.  A drain already
+	// under way picks up the latest configuration when it is done.
+	m->cfg_next = *cfg;
+	if(m->state == MMA8451Q_DRAIN)
+	{
+		return;
+	}
+	if(m->fifo_wmrk && (m->state == MMA8451Q_RUN))
+	{
+		m->step = 0;
+		m->state = MMA8451Q_DRAIN;
+		return;
+	}
+
+	m->cfg = *cfg;
+
+	// An auto zero under way starts its sampling over, the samples so far
+	// were made with the old configuration.  The init sequence hands back
+	// to it when it is done.
+	if(m->state == MMA8451Q_ZERO)
+	{
+		MMA8451Q_Zero_Restart(m);
+	}
+
+	// run the init sequence again, it starts with STANDBY
+	m->step = 0;
+	m->state = MMA8451Q_INIT;
+}
+
+void MMA8451Q_Auto_Zero(MMA8451Q *m, uint16_t n)
 {
-	if(packet->state == WR_ADDRESS)
+	if(n > MMA8451Q_ZERO_MAX)
 	{
-		switch(m->step)
+		n = MMA8451Q_ZERO_MAX;
+	}
+
+	MMA8451Q_Zero_Restart(m);
+	m->zero.n = n;
+
+	// if we are already running, stop the INT pin and start over.  Before
+	// that the init sequence hands over to the auto zero when it is done.
+	if((n != 0) && (m->state == MMA8451Q_RUN))
+	{
+		if(m->int_pin)
 		{
-		case 0:
-			I2C_Write_CTRL_REG1(MMA8451Q_ADDR, 0x01, packet);		// set to ACTIVE mode
-			m->step++;
-			break;
-		case 1:
-			I2C_Write_XYZ_DATA_CFG(MMA8451Q_ADDR, 0x00, packet);	//2g scaling
-			m->step++;
-			break;
-		default:
-			// we ran out of init stuff to do, switch to run mode
-			m->step = 0;
-			m->state = MMA8451Q_RUN;
-			break;
+			PORTA->PCR[MMA8451Q_INT_Pin(m)] = PORT_PCR_MUX(1) | PORT_PCR_ISF_MASK;
+		}
+		m->step = 0;
+		m->state = MMA8451Q_ZERO;
+	}
+}
+
+static int32_t MMA8451Q_Div_Round(int32_t a, int32_t b)
+{
+	return((a >= 0) ? ((a + (b / 2)) / b) : -((-a + (b / 2)) / b));
+}
+
+void MMA8451Q_Zero_Offsets(const int32_t sum[3], uint16_t n, MMA8451Q_RANGE range, int8_t off[3])
+{
+	int32_t one_g = MMA8451Q_ONE_G >> range;
+	int32_t err;
+	int32_t v;
+	uint8_t i;
+
+	for(i = 0; i < 3; i++)
+	{
+		// flat means X = Y = 0 and Z = +1g
+		err = MMA8451Q_Div_Round(sum[i], n);
+		if(i == 2)
+		{
+			err -= one_g;
+		}
+
+		// counts to 2mg offset LSBs, the offset is added to the output
+		v = -MMA8451Q_Div_Round(err * (1000 / MMA8451Q_OFF_MG_PER_LSB), one_g);
+		if(v > INT8_MAX)
+		{
+			v = INT8_MAX;
+		}
+		else if(v < INT8_MIN)
+		{
+			v = INT8_MIN;
 		}
+		off[i] = (int8_t)v;
 	}
 }
 
-void Run_MMA8451Q(MMA8451Q *m, I2C_Packet *packet)
+void Zero_MMA8451Q(MMA8451Q *m, I2C_Queue *q)
 {
-	if(packet->state == WR_ADDRESS)
+	static const int8_t no_off[3] = {0, 0, 0};
+	uint8_t error = 0;
+	uint8_t ctrl_reg1 = MMA8451Q_Ctrl_Reg1(m) & ~CTRL_REG1_F_READ;
+	MMA8451Q_DATA d;
+
+	// let any sample read that is still on the bus finish first
+	if(m->reads_queued != m->reads_done)
+	{
+		return;
+	}
+
+	// The offset registers can only be written in STANDBY, so clear them,
+	// sample, then write the result and run the init sequence again to get
+	// back to ACTIVE with the FIFO and the INT pin set up.  Sampling is
+	// done with the FIFO off, since reading OUT_X/Y/Z in FIFO mode pops
+	// samples, and polls STATUS so no sample is counted twice.
+	switch(m->step)
 	{
-		//I2C_Read_WHO_AM_I(MMA8451Q_ADDR, packet);
-		switch(m->step)
+	case 0:
+		error = I2C_Write_CTRL_REG1(MMA8451Q_ADDR, ctrl_reg1, m, q);	// STANDBY
+		break;
+	case 1:
+		error = I2C_Write_F_SETUP(MMA8451Q_ADDR, 0, m, q);				// FIFO off
+		break;
+	case 2:
+		error = I2C_Write_OFF_XYZ(MMA8451Q_ADDR, no_off, m, q);
+		break;
+	case 3:
+		error = I2C_Write_CTRL_REG1(MMA8451Q_ADDR, ctrl_reg1 | CTRL_REG1_ACTIVE, m, q);
+		break;
+	case 4:
+		// collect samples, one read in flight at a time
+		if(m->pending != 0)
 		{
-		case 0:
-			I2C_Read_OUT_X_MSB(MMA8451Q_ADDR, packet);
-			m->step++;
-			break;
-		case 1:
-			I2C_Read_OUT_X_LSB(MMA8451Q_ADDR, packet);
-			m->step++;
-			break;
-		case 2:
-			I2C_Read_OUT_Y_MSB(MMA8451Q_ADDR, packet);
-			m->step++;
-			break;
-		case 3:
-			I2C_Read_OUT_Y_LSB(MMA8451Q_ADDR, packet);
-			m->step++;
-			break;
-		case 4:
-			I2C_Read_OUT_Z_MSB(MMA8451Q_ADDR, packet);
-			m->step++;
-			break;
-		case 5:
-			I2C_Read_OUT_Z_LSB(MMA8451Q_ADDR, packet);
-			m->step++;
-			break;
-		case 6:
+			return;
+		}
+		if(MMA8451Q_Read_Sample(m, &d, &m->zero.seq))
+		{
+			// the first conversions after going ACTIVE can be stale
+			if(m->zero.cnt >= MMA8451Q_ZERO_SKIP)
+			{
+				m->zero.sum[0] += d.x_data;
+				m->zero.sum[1] += d.y_data;
+				m->zero.sum[2] += d.z_data;
+			}
+			if(++m->zero.cnt >= (m->zero.n + MMA8451Q_ZERO_SKIP))
+			{
+				MMA8451Q_Zero_Offsets(m->zero.sum, m->zero.n, m->cfg.range, m->zero.off);
+				m->step++;
+				return;
+			}
+		}
+		if(I2C_Read_STATUS_XYZ(MMA8451Q_ADDR, m, q) == 0)
+		{
+			m->reads_queued++;
+		}
+		return;
+	case 5:
+		error = I2C_Write_CTRL_REG1(MMA8451Q_ADDR, ctrl_reg1, m, q);	// STANDBY
+		break;
+	case 6:
+		error = I2C_Write_OFF_XYZ(MMA8451Q_ADDR, m->zero.off, m, q);
+		break;
+	default:
+		if(m->pending == 0)
+		{
+			m->zero.n = 0;
 			m->step = 0;
-			break;
-		default:
+			m->state = MMA8451Q_INIT;
+		}
+		return;
+	}
+
+	if(error == 0)
+	{
+		m->pending++;
+		m->step++;
+	}
+}
+
+void Drain_MMA8451Q(MMA8451Q *m, I2C_Queue *q)
+{
+	uint8_t error = 0;
+
+	// one step at a time, and the consumer hands each block back first
+	if((m->pending != 0) || (m->reads_queued != m->reads_done) || m->block.ready)
+	{
+		return;
+	}
+
+	switch(m->step)
+	{
+	case 0:
+		error = I2C_Write_CTRL_REG1(MMA8451Q_ADDR, MMA8451Q_Ctrl_Reg1(m), m, q);	// STANDBY, no more samples
+		break;
+	case 1:
+		error = I2C_Read_F_STATUS(MMA8451Q_ADDR, m, q);
+		break;
+	case 2:
+		// whatever was made before the STANDBY, in one burst
+		if(m->fifo_cnt != 0)
+		{
+			if(I2C_Read_FIFO(MMA8451Q_ADDR, m, q) == 0)
+			{
+				m->reads_queued++;
+				m->step++;
+			}
+			return;
+		}
+		m->step++;
+		return;
+	default:
+		// the last block at the old range is gone, run the init sequence
+		// from after its STANDBY
+		m->cfg = m->cfg_next;
+		m->step = 1;
+		m->state = MMA8451Q_INIT;
+		return;
+	}
+
+	if(error == 0)
+	{
+		m->pending++;
+		m->step++;
+	}
+}
+
+void Init_MMA8451Q(MMA8451Q *m, I2C_Queue *q)
+{
+	uint8_t error = 0;
+	uint8_t f_setup = 0;
+	uint8_t int_en = 0;
+	uint8_t int_cfg = 0;
+	uint8_t ctrl_reg1;
+
+	// let any sample read that is still on the bus finish first
+	if(m->reads_queued != m->reads_done)
+	{
+		return;
+	}
+
+	ctrl_reg1 = MMA8451Q_Ctrl_Reg1(m);
+
+	// the watermark can't be more than the FIFO holds, and a block only
+	// has room for a full FIFO
+	if(m->fifo_wmrk > MMA8451Q_FIFO_SIZE)
+	{
+		m->fifo_wmrk = MMA8451Q_FIFO_SIZE;
+	}
+
+	if(m->fifo_wmrk)
+	{
+		f_setup = F_SETUP_F_MODE_CIRC | (m->fifo_wmrk & F_SETUP_F_WMRK_MASK);
+	}
+
+	// In FIFO mode interrupt on the watermark, otherwise on each new sample
+	if(m->int_pin)
+	{
+		int_en = (m->fifo_wmrk) ? CTRL_REG4_INT_EN_FIFO : CTRL_REG4_INT_EN_DRDY;
+		if(m->int_pin == 1)
+		{
+			int_cfg = int_en;
+		}
+	}
+
+	// The whole init sequence is queued up front.  If the queue is full
+	// we try the same step again on the next pass.  Everything but
+	// CTRL_REG1 ACTIVE can only be written in STANDBY.
+	switch(m->step)
+	{
+	case 0:
+		error = I2C_Write_CTRL_REG1(MMA8451Q_ADDR, ctrl_reg1, m, q);	// STANDBY
+		break;
+	case 1:
+		error = I2C_Write_CTRL_REG2(MMA8451Q_ADDR, m->cfg.mods & CTRL_REG2_MODS_MASK, m, q);	// oversampling
+		break;
+	case 2:
+		// F_MODE can't go straight from one non-zero mode to another, it
+		// has to be disabled (00) first
+		error = I2C_Write_F_SETUP(MMA8451Q_ADDR, 0, m, q);				// FIFO off
+		break;
+	case 3:
+		error = I2C_Write_F_SETUP(MMA8451Q_ADDR, f_setup, m, q);		// FIFO mode and watermark
+		break;
+	case 4:
+		error = I2C_Write_XYZ_DATA_CFG(MMA8451Q_ADDR, m->cfg.range & XYZ_DATA_CFG_FS_MASK, m, q);	// range
+		break;
+	case 5:
+		error = I2C_Write_CTRL_REG4(MMA8451Q_ADDR, int_en, m, q);		// interrupt enables
+		break;
+	case 6:
+		error = I2C_Write_CTRL_REG5(MMA8451Q_ADDR, int_cfg, m, q);	// INT1/INT2 routing
+		break;
+	case 7:
+		error = I2C_Write_CTRL_REG1(MMA8451Q_ADDR, ctrl_reg1 | CTRL_REG1_ACTIVE, m, q);	// set to ACTIVE mode
+		break;
+	default:
+		// we ran out of init stuff to do, switch to run mode once it is all on the sensor
+		if(m->pending == 0)
+		{
 			m->step = 0;
-			break;
+			if(m->zero.n)
+			{
+				// an auto zero was asked for, sample with the new configuration first
+				m->state = MMA8451Q_ZERO;
+				return;
+			}
+			if(m->int_pin)
+			{
+				MMA8451Q_INT_init(m);
+			}
+			m->state = MMA8451Q_RUN;
+		}
+		return;
+	}
+
+	if(error == 0)
+	{
+		m->pending++;
+		m->step++;
+	}
+}
+
+void MMA8451Q_INT_init(MMA8451Q *m)
+{
+	//PORTA = 1 - PORTA clock enabled
+	SIM->SCGC5 |= SIM_SCGC5_PORTA(1);
+
+	//MUX = 001 - GPIO input, IRQC = 0000 - interrupt disarmed until Run_MMA8451Q()
+	PORTA->PCR[MMA8451Q_INT_Pin(m)] = PORT_PCR_MUX(1) | PORT_PCR_ISF_MASK;
+	GPIOA->PDDR &= ~(1 << MMA8451Q_INT_Pin(m));
+
+	//set PORTA interrupt priority to 1
+#define PORTA_PRI	1
+	NVIC->IP[_IP_IDX(PORTA_IRQn)]  = ((uint32_t)(NVIC->IP[_IP_IDX(PORTA_IRQn)]  & ~(0xFFUL << _BIT_SHIFT(PORTA_IRQn))) |
+	   (((PORTA_PRI << (8U - __NVIC_PRIO_BITS)) & (uint32_t)0xFFUL) << _BIT_SHIFT(PORTA_IRQn)));
+
+	//enable the PORTA IRQ
+	NVIC->ISER[0U] = (uint32_t)(1UL << (((uint32_t)(int32_t)PORTA_IRQn) & 0x1FUL));
+}
+
+void MMA8451Q_INT_ISR(MMA8451Q *m, I2C_Queue *q)
+{
+	uint8_t pin = MMA8451Q_INT_Pin(m);
+	uint8_t error;
+
+	if(!(PORTA->ISFR & (1 << pin)))
+	{
+		return;
+	}
+
+	// The INT pins are active low and stay low until the data is read,
+	// so the pin is level triggered and disarmed until this read is done.
+	// That gives exactly one read per sample (or per watermark).
+	PORTA->PCR[pin] = PORT_PCR_MUX(1) | PORT_PCR_ISF_MASK;
+
+	if(m->fifo_wmrk)
+	{
+		// the watermark interrupt means at least fifo_wmrk samples are waiting
+		m->fifo_cnt = m->fifo_wmrk;
+		error = I2C_Read_FIFO(MMA8451Q_ADDR, m, q);
+	}
+	else
+	{
+		error = I2C_Read_OUT_XYZ(MMA8451Q_ADDR, m, q);
+	}
+
+	// if the queue was full the pin gets re-armed and fires again
+	if(error == 0)
+	{
+		m->reads_queued++;
+	}
+}
+
+void Run_MMA8451Q(MMA8451Q *m, I2C_Queue *q)
+{
+	// keep one job outstanding
+	if((m->pending != 0) || (m->reads_queued != m->reads_done))
+	{
+		return;
+	}
+
+	if(m->int_pin)
+	{
+		// The last read is done, so re-arm the INT pin once the block has
+		// been consumed.  The PORTA ISR takes it from there.
+		if(m->block.ready == 0)
+		{
+			PORTA->PCR[MMA8451Q_INT_Pin(m)] = PORT_PCR_MUX(1) | PORT_PCR_IRQC(8);
+		}
+		return;
+	}
+
+	if(m->fifo_wmrk == 0)
+	{
+		//I2C_Read_WHO_AM_I(MMA8451Q_ADDR, q);
+		// polled, so only publish when STATUS says the sample is new
+		if(I2C_Read_STATUS_XYZ(MMA8451Q_ADDR, m, q) == 0)
+		{
+			m->reads_queued++;
+		}
+	}
+	else if(m->block.ready == 0)
+	{
+		// Don't drain until the last block has been consumed.  The
+		// samples wait in the sensor's FIFO in the meantime.
+		if(m->step == 0)
+		{
+			if(I2C_Read_F_STATUS(MMA8451Q_ADDR, m, q) == 0)
+			{
+				m->pending++;
+			}
+		}
+		else if(I2C_Read_FIFO(MMA8451Q_ADDR, m, q) == 0)
+		{
+			m->reads_queued++;
 		}
 	}
 }
-void Update_MMA8451Q(MMA8451Q *m, I2C_Packet *packet)
+
+void Update_MMA8451Q(MMA8451Q *m, I2C_Queue *q)
 {
+	// A configuration write failed.  Once the writes queued with it are
+	// done, run the sequence it belonged to again from its STANDBY, so the
+	// sensor never ends up half set up behind our back.
+	if(m->write_err && (m->pending == 0))
+	{
+		m->write_err = 0;
+		if(m->state == MMA8451Q_ZERO)
+		{
+			MMA8451Q_Zero_Restart(m);
+		}
+		else if(m->state != MMA8451Q_DRAIN)
+		{
+			m->state = MMA8451Q_INIT;
+		}
+		m->step = 0;
+	}
+
 	if(m->state == MMA8451Q_INIT)
 	{
-		Init_MMA8451Q(m, packet);
+		Init_MMA8451Q(m, q);
+	}
+	else if(m->state == MMA8451Q_ZERO)
+	{
+		Zero_MMA8451Q(m, q);
+	}
+	else if(m->state == MMA8451Q_DRAIN)
+	{
+		Drain_MMA8451Q(m, q);
 	}
 	else
 	{
-		Run_MMA8451Q(m, packet);
+		Run_MMA8451Q(m, q);
 	}
 
 }
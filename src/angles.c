@@ -21,13 +21,298 @@
 */
 
 #include "angles.h"
+#if ANGLE_BACKEND == ANGLE_BACKEND_LIBM
+#include <math.h>
+#endif
 
-void Calc_angles(MMA8451Q_DATA *acc, ANGLE_DATA *ang)
+#define CORDIC_ITER		16
+#define CORDIC_SHIFT	12				//guard bits added to the inputs
+#define CORDIC_KINV		19898			//1/K = 0.607253 in Q15, K is the CORDIC gain
+
+//atan(2^-i) in ANGLE_SCALE units, Q8
+static const int32_t cordic_atan[CORDIC_ITER] =
+{
+	1152000, 680065, 359328, 182400, 91554, 45822, 22916, 11459,
+	5730, 2865, 1432, 716, 358, 179, 90, 45
+};
+
+int32_t Cordic_atan2(int32_t y, int32_t x, uint32_t *mag)
+{
+	int32_t angle = 0;
+	int32_t xt;
+	uint8_t i;
+
+	x <<= CORDIC_SHIFT;
+	y <<= CORDIC_SHIFT;
+
+	// CORDIC only converges for +/-99.7 degrees, so rotate the left half
+	// plane by 90 degrees first
+	if(x < 0)
+	{
+		xt = x;
+		if(y >= 0)
+		{
+			x = y;
+			y = -xt;
+			angle = (90 * ANGLE_SCALE) << 8;
+		}
+		else
+		{
+			x = -y;
+			y = xt;
+			angle = -((90 * ANGLE_SCALE) << 8);
+		}
+	}
+
+	// drive y to zero, accumulating the rotation in angle
+	for(i = 0; i < CORDIC_ITER; i++)
+	{
+		xt = x;
+		if(y > 0)
+		{
+			x += y >> i;
+			y -= xt >> i;
+			angle += cordic_atan[i];
+		}
+		else
+		{
+			x -= y >> i;
+			y += xt >> i;
+			angle -= cordic_atan[i];
+		}
+	}
+
+	// x is now the magnitude times the CORDIC gain, under 2^30.  x * 1/K
+	// would need 64 bits, an __aeabi_lmul call on the M0+, so it is done
+	// as two 32 bit multiplies of its top and bottom 15 bits, which gives
+	// the same result to the bit.
+	if(mag != 0)
+	{
+		*mag = (((uint32_t)x >> 15) * CORDIC_KINV) + ((((uint32_t)x & 0x7FFF) * CORDIC_KINV) >> 15);
+		*mag = (*mag + (1UL << (CORDIC_SHIFT - 1))) >> CORDIC_SHIFT;
+	}
+
+	return((angle + 128) >> 8);
+}
+
+#define LUT_SIZE		(1 << ATAN_LUT_BITS)
+#define LUT_FRAC_BITS	(16 - ATAN_LUT_BITS)		//bits of the Q16 ratio below the table index
+#define LUT_Q			2							//angle tables are ANGLE_SCALE units in Q2
+#define LUT_PI			3.14159265358979323846
+
+//Table entries are constant expressions that GCC folds at compile time
+#define LUT_T(i)		((double)(i) / LUT_SIZE)
+#define LUT_ATAN(i)		((uint16_t)(__builtin_atan(LUT_T(i)) * (180.0 * ANGLE_SCALE * (1 << LUT_Q) / LUT_PI) + 0.5))
+#define LUT_ASIN(i)		((uint16_t)(__builtin_asin(LUT_T(i)) * (180.0 * ANGLE_SCALE * (1 << LUT_Q) / LUT_PI) + 0.5))
+#define LUT_SEC(i)		((uint16_t)(__builtin_sqrt(1.0 + (LUT_T(i) * LUT_T(i))) * 32768.0 + 0.5))
+
+#define LUT_REP4(f, i)		f(i), f((i) + 1), f((i) + 2), f((i) + 3)
+#define LUT_REP16(f, i)		LUT_REP4(f, i), LUT_REP4(f, (i) + 4), LUT_REP4(f, (i) + 8), LUT_REP4(f, (i) + 12)
+#define LUT_REP32(f, i)		LUT_REP16(f, i), LUT_REP16(f, (i) + 16)
+#define LUT_REP64(f, i)		LUT_REP32(f, i), LUT_REP32(f, (i) + 32)
+#define LUT_REP128(f, i)	LUT_REP64(f, i), LUT_REP64(f, (i) + 64)
+#define LUT_REP256(f, i)	LUT_REP128(f, i), LUT_REP128(f, (i) + 128)
+
+#if ATAN_LUT_BITS == 4
+#define LUT_TABLE(f)	{ LUT_REP16(f, 0), f(16) }
+#elif ATAN_LUT_BITS == 5
+#define LUT_TABLE(f)	{ LUT_REP32(f, 0), f(32) }
+#elif ATAN_LUT_BITS == 6
+#define LUT_TABLE(f)	{ LUT_REP64(f, 0), f(64) }
+#elif ATAN_LUT_BITS == 7
+#define LUT_TABLE(f)	{ LUT_REP128(f, 0), f(128) }
+#elif ATAN_LUT_BITS == 8
+#define LUT_TABLE(f)	{ LUT_REP256(f, 0), f(256) }
+#else
+#error "ATAN_LUT_BITS must be 4..8"
+#endif
+
+//atan(t), asin(t) and sqrt(1 + t^2) for t = 0..1, one extra entry for the interpolation
+static const uint16_t lut_atan[LUT_SIZE + 1] = LUT_TABLE(LUT_ATAN);
+static const uint16_t lut_asin[LUT_SIZE + 1] = LUT_TABLE(LUT_ASIN);
+static const uint16_t lut_sec[LUT_SIZE + 1] = LUT_TABLE(LUT_SEC);
+
+static uint32_t Lut_interp(const uint16_t *tab, uint32_t t)
+{
+	uint32_t i = t >> LUT_FRAC_BITS;
+	uint32_t f = t & ((1UL << LUT_FRAC_BITS) - 1);
+
+	return(tab[i] + ((((int32_t)tab[i + 1] - (int32_t)tab[i]) * (int32_t)f) >> LUT_FRAC_BITS));
+}
+
+int32_t Lut_atan2(int32_t y, int32_t x, uint32_t *mag)
+{
+	uint32_t ax = (x < 0) ? -x : x;
+	uint32_t ay = (y < 0) ? -y : y;
+	uint32_t lo;
+	uint32_t hi;
+	uint32_t t;
+	int32_t angle;
+
+	if(ay <= ax)
+	{
+		lo = ay;
+		hi = ax;
+	}
+	else
+	{
+		lo = ax;
+		hi = ay;
+	}
+
+	if(hi == 0)
+	{
+		if(mag != 0)
+		{
+			*mag = 0;
+		}
+		return 0;
+	}
+
+	// ratio in Q16, kept below 1.0 so the interpolation stays in the table
+	t = (lo << 16) / hi;
+	if(t > 0xFFFF)
+	{
+		t = 0xFFFF;
+	}
+
+	// first octant, then unfold to the full circle
+	angle = Lut_interp(lut_atan, t);
+	if(ay > ax)
+	{
+		angle = ((90 * ANGLE_SCALE) << LUT_Q) - angle;
+	}
+	if(x < 0)
+	{
+		angle = ((180 * ANGLE_SCALE) << LUT_Q) - angle;
+	}
+	if(y < 0)
+	{
+		angle = -angle;
+	}
+
+	// |v| = hi * sqrt(1 + (lo/hi)^2)
+	if(mag != 0)
+	{
+		*mag = ((hi * Lut_interp(lut_sec, t)) + (1UL << 14)) >> 15;
+	}
+
+	return((angle + (1 << (LUT_Q - 1))) >> LUT_Q);
+}
+
+int32_t Lut_asin(int32_t s)
 {
-	//Bogus test code just to illustrate how to access the data structures.
-	//Here we are just copying the input data to the outputs.
-	ang->pitch = acc->x_data;
-	ang->roll = acc->y_data;
-	ang->yaw = acc->z_data;
+	uint32_t t = (s < 0) ? -s : s;
+	int32_t angle;
+
+	// Q15 to Q16
+	t <<= 1;
+	if(t > 0xFFFF)
+	{
+		// asin(1) is the last table entry
+		angle = lut_asin[LUT_SIZE];
+	}
+	else
+	{
+		angle = Lut_interp(lut_asin, t);
+	}
+
+	angle = (angle + (1 << (LUT_Q - 1))) >> LUT_Q;
+
+	return((s < 0) ? -angle : angle);
 }
 
+uint32_t Isqrt(uint32_t v)
+{
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+
+	//start at the highest power of 4 that isn't above v
+	while(bit > v)
+	{
+		bit >>= 2;
+	}
+
+	while(bit != 0)
+	{
+		if(v >= (root + bit))
+		{
+			v -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return(root);
+}
+
+uint32_t Vec_mag(int16_t x, int16_t y, int16_t z)
+{
+	uint32_t sum;
+
+	sum = (uint32_t)((int32_t)x * x);
+	sum += (uint32_t)((int32_t)y * y);
+	sum += (uint32_t)((int32_t)z * z);
+
+	return(Isqrt(sum));
+}
+
+__attribute__((always_inline)) static inline uint8_t Angle_dynamic(uint32_t mag, uint32_t lo, uint32_t hi)
+{
+	return((mag < lo) || (mag > hi));
+}
+
+__attribute__((always_inline)) static inline void Angle_calc(int32_t x, int32_t y, int32_t z, int16_t *pitch, int16_t *roll, uint32_t *mag)
+{
+#if ANGLE_BACKEND == ANGLE_BACKEND_LIBM
+	float r = sqrtf(((float)y * y) + ((float)z * z));
+
+	*roll = lroundf(atan2f(y, z) * (180.0f * ANGLE_SCALE / 3.14159265f));
+	*pitch = lroundf(atan2f(-x, r) * (180.0f * ANGLE_SCALE / 3.14159265f));
+	*mag = Vec_mag(x, y, z);
+#else
+	uint32_t r;
+
+	// the roll step also gives us the length of (y, z) for pitch, and the
+	// pitch step gives the length of (x, y, z)
+#if ANGLE_BACKEND == ANGLE_BACKEND_LUT
+	*roll = Lut_atan2(y, z, &r);
+	*pitch = Lut_atan2(-x, r, mag);
+#else
+	*roll = Cordic_atan2(y, z, &r);
+	*pitch = Cordic_atan2(-x, r, mag);
+#endif
+#endif
+}
+
+void Calc_angles(MMA8451Q_DATA *acc, ANGLE_DATA *ang, uint16_t one_g)
+{
+	uint32_t mag;
+
+	Angle_calc(acc->x_data, acc->y_data, acc->z_data, &ang->pitch, &ang->roll, &mag);
+	ang->yaw = 0;
+	ang->mag = mag;
+	ang->dynamic = Angle_dynamic(mag, one_g - (one_g >> ANGLE_DYN_SHIFT), one_g + (one_g >> ANGLE_DYN_SHIFT));
+}
+
+void Calc_angles_block(const int16_t *x, const int16_t *y, const int16_t *z,
+					   int16_t *pitch, int16_t *roll, uint8_t *dynamic, uint16_t one_g, uint16_t n)
+{
+	uint32_t lo = one_g - (one_g >> ANGLE_DYN_SHIFT);
+	uint32_t hi = one_g + (one_g >> ANGLE_DYN_SHIFT);
+	uint32_t mag;
+	uint16_t i;
+
+	for(i = 0; i < n; i++)
+	{
+		Angle_calc(x[i], y[i], z[i], &pitch[i], &roll[i], &mag);
+		if(dynamic)
+		{
+			dynamic[i] = Angle_dynamic(mag, lo, hi);
+		}
+	}
+}
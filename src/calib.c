@@ -0,0 +1,141 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file calib.c
+* @brief Accelerometer calibration
+*
+* This source file implements a Q15 offset, gain and misalignment
+* correction and the six orientation solver for its parameters
+*
+* @author Jon Warriner
+* @date June 25, 2019
+* @version 1.0
+*
+*/
+
+#include "calib.h"
+
+static inline int16_t Calib_sat(int32_t v)
+{
+	if(v > INT16_MAX)
+	{
+		return(INT16_MAX);
+	}
+	if(v < INT16_MIN)
+	{
+		return(INT16_MIN);
+	}
+	return((int16_t)v);
+}
+
+__attribute__((always_inline)) static inline void Calib_apply(const CALIB_PARAM *p, int16_t *x, int16_t *y, int16_t *z)
+{
+	int32_t ax = *x - p->off[0];
+	int32_t ay = *y - p->off[1];
+	int32_t az = *z - p->off[2];
+	int32_t cx, cy, cz;
+
+	//|a'| < 2^16 and |corr| <= 2^13, so the sum of three products is
+	//under 3 * 2^29 and can't overflow
+	cx = (p->corr[0][0] * ax) + (p->corr[0][1] * ay) + (p->corr[0][2] * az);
+	cy = (p->corr[1][0] * ax) + (p->corr[1][1] * ay) + (p->corr[1][2] * az);
+	cz = (p->corr[2][0] * ax) + (p->corr[2][1] * ay) + (p->corr[2][2] * az);
+
+	*x = Calib_sat(ax + (cx >> CALIB_SHIFT));
+	*y = Calib_sat(ay + (cy >> CALIB_SHIFT));
+	*z = Calib_sat(az + (cz >> CALIB_SHIFT));
+}
+
+void Calib_sample(const CALIB_PARAM *p, MMA8451Q_DATA *acc)
+{
+	Calib_apply(p, &acc->x_data, &acc->y_data, &acc->z_data);
+}
+
+void Calib_block(const CALIB_PARAM *p, int16_t *x, int16_t *y, int16_t *z, uint16_t n)
+{
+	uint16_t i;
+
+	for(i = 0; i < n; i++)
+	{
+		Calib_apply(p, &x[i], &y[i], &z[i]);
+	}
+}
+
+int32_t Calib_solve(CALIB_PARAM *p, const MMA8451Q_DATA cap[CALIB_ORIENTATIONS], int16_t one_g)
+{
+	float s[3][3];
+	float inv[3][3];
+	float det;
+	float v;
+	int32_t q;
+	uint8_t i, j;
+
+	if(one_g <= 0)
+	{
+		return(-1);
+	}
+
+	//offset is the mean of each pair of opposite captures, averaged over
+	//all three pairs
+	p->off[0] = (int16_t)(((int32_t)cap[0].x_data + cap[1].x_data + cap[2].x_data +
+						   cap[3].x_data + cap[4].x_data + cap[5].x_data) / 6);
+	p->off[1] = (int16_t)(((int32_t)cap[0].y_data + cap[1].y_data + cap[2].y_data +
+						   cap[3].y_data + cap[4].y_data + cap[5].y_data) / 6);
+	p->off[2] = (int16_t)(((int32_t)cap[0].z_data + cap[1].z_data + cap[2].z_data +
+						   cap[3].z_data + cap[4].z_data + cap[5].z_data) / 6);
+
+	//column j of the sensitivity matrix is the response to 1g along axis j
+	for(j = 0; j < 3; j++)
+	{
+		s[0][j] = (cap[2 * j].x_data - cap[(2 * j) + 1].x_data) / (2.0f * one_g);
+		s[1][j] = (cap[2 * j].y_data - cap[(2 * j) + 1].y_data) / (2.0f * one_g);
+		s[2][j] = (cap[2 * j].z_data - cap[(2 * j) + 1].z_data) / (2.0f * one_g);
+	}
+
+	//inverse by cofactors
+	inv[0][0] = (s[1][1] * s[2][2]) - (s[1][2] * s[2][1]);
+	inv[0][1] = (s[0][2] * s[2][1]) - (s[0][1] * s[2][2]);
+	inv[0][2] = (s[0][1] * s[1][2]) - (s[0][2] * s[1][1]);
+	inv[1][0] = (s[1][2] * s[2][0]) - (s[1][0] * s[2][2]);
+	inv[1][1] = (s[0][0] * s[2][2]) - (s[0][2] * s[2][0]);
+	inv[1][2] = (s[0][2] * s[1][0]) - (s[0][0] * s[1][2]);
+	inv[2][0] = (s[1][0] * s[2][1]) - (s[1][1] * s[2][0]);
+	inv[2][1] = (s[0][1] * s[2][0]) - (s[0][0] * s[2][1]);
+	inv[2][2] = (s[0][0] * s[1][1]) - (s[0][1] * s[1][0]);
+
+	det = (s[0][0] * inv[0][0]) + (s[0][1] * inv[1][0]) + (s[0][2] * inv[2][0]);
+	if((det < 0.25f) || (det > 4.0f))
+	{
+		//an axis is dead, swapped or the captures were mislabeled
+		return(-1);
+	}
+
+	for(i = 0; i < 3; i++)
+	{
+		for(j = 0; j < 3; j++)
+		{
+			v = inv[i][j] / det;
+			if(i == j)
+			{
+				v -= 1.0f;
+			}
+
+			q = (int32_t)((v * (1 << CALIB_SHIFT)) + ((v < 0) ? -0.5f : 0.5f));
+			if((q > CALIB_CORR_MAX) || (q < -CALIB_CORR_MAX))
+			{
+				return(-1);
+			}
+			p->corr[i][j] = (int16_t)q;
+		}
+	}
+
+	return(0);
+}
@@ -20,9 +20,8 @@
 
 */
 
-#include <stdio.h>
-#include <string.h>
 #include "disp.h"
+#include "fmt.h"
 
 int32_t disp_init(disp_t *d, ring_t *obuf, void (*tx_func)())
 {
@@ -52,7 +51,8 @@ int32_t disp_init(disp_t *d, ring_t *obuf, void (*tx_func)())
 */
 void Display_task(disp_t *d)
 {
-	size_t i;
+	char *p;
+	uint8_t len;
 
 	//if pointer isn't initialized return without doing anything
 	if(d == 0)
@@ -66,13 +66,15 @@ void Display_task(disp_t *d)
 	//and check again later.
 	if((d->trig) && (entries(d->obuf) == 0))
 	{
-		sprintf(d->sbuf, "%c[2J%c[HAngle - %d\r\n", (char)27, (char)27, d->val);
+		//clear screen, home, then the value
+		p = d->sbuf;
+		p += Fmt_str(p, "\033[2J\033[HAngle - ");
+		p += Fmt_int(p, d->val, 0);
+		p += Fmt_str(p, "\r\n");
+		len = p - d->sbuf;
 
 		//move the string to the TX buffer
-		for(i = 0; i <= strlen(d->sbuf); i++)
-		{
-			insert(d->obuf, d->sbuf[i]);
-		}
+		insert_block(d->obuf, d->sbuf, len);
 
 		//kick off the transmit by enabling the interrupt
 		d->transmit_trig();
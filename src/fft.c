@@ -0,0 +1,169 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file fft.c
+* @brief Fixed point radix-4 FFT
+*
+* This source file implements an in place Q15 FFT with its tables
+* in flash
+*
+* @author Jon Warriner
+* @date June 26, 2019
+* @version 1.0
+*
+*/
+
+#include "fft.h"
+
+#if (FFT_LOG2N != 8) && (FFT_LOG2N != 9)
+#error "FFT_LOG2N must be 8 or 9"
+#endif
+
+#define FFT_QUARTER		(FFT_N / 4)
+
+// Both tables are built by the compiler, see angles.c for the trick
+#define FFT_PI			3.14159265358979323846
+#define FFT_SIN(i)		((int16_t)(__builtin_sin((2.0 * FFT_PI * (i)) / FFT_N) * 32767.0 + 0.5))
+
+// bit b of the reversed index is bit (FFT_LOG2N - 1 - b) of the index
+#define FFT_BRBIT(i, b)	((((i) >> (FFT_LOG2N - 1 - (b))) & 1) << (b))
+#define FFT_BR8(i)		(FFT_BRBIT(i, 0) | FFT_BRBIT(i, 1) | FFT_BRBIT(i, 2) | FFT_BRBIT(i, 3) | \
+						 FFT_BRBIT(i, 4) | FFT_BRBIT(i, 5) | FFT_BRBIT(i, 6) | FFT_BRBIT(i, 7))
+#if FFT_LOG2N == 9
+#define FFT_BR(i)		(FFT_BR8(i) | FFT_BRBIT(i, 8))
+#else
+#define FFT_BR(i)		FFT_BR8(i)
+#endif
+
+#define FFT_REP4(f, i)		f(i), f((i) + 1), f((i) + 2), f((i) + 3)
+#define FFT_REP16(f, i)		FFT_REP4(f, i), FFT_REP4(f, (i) + 4), FFT_REP4(f, (i) + 8), FFT_REP4(f, (i) + 12)
+#define FFT_REP64(f, i)		FFT_REP16(f, i), FFT_REP16(f, (i) + 16), FFT_REP16(f, (i) + 32), FFT_REP16(f, (i) + 48)
+#define FFT_REP256(f, i)	FFT_REP64(f, i), FFT_REP64(f, (i) + 64), FFT_REP64(f, (i) + 128), FFT_REP64(f, (i) + 192)
+
+//sin over the first quarter wave, FFT_N / 4 + 1 points
+#if FFT_LOG2N == 9
+static const int16_t fft_sin[FFT_QUARTER + 1] = { FFT_REP64(FFT_SIN, 0), FFT_REP64(FFT_SIN, 64), FFT_SIN(128) };
+static const uint16_t fft_bitrev[FFT_N] = { FFT_REP256(FFT_BR, 0), FFT_REP256(FFT_BR, 256) };
+#else
+static const int16_t fft_sin[FFT_QUARTER + 1] = { FFT_REP64(FFT_SIN, 0), FFT_SIN(64) };
+static const uint16_t fft_bitrev[FFT_N] = { FFT_REP256(FFT_BR, 0) };
+#endif
+
+int16_t Fft_cos(uint16_t k)
+{
+	uint16_t r;
+
+	k &= FFT_N - 1;
+	r = k & (FFT_QUARTER - 1);
+
+	switch(k / FFT_QUARTER)
+	{
+	case 0:
+		return(fft_sin[FFT_QUARTER - r]);
+	case 1:
+		return(-fft_sin[r]);
+	case 2:
+		return(-fft_sin[FFT_QUARTER - r]);
+	default:
+		return(fft_sin[r]);
+	}
+}
+
+// x * (c - js), Q15
+__attribute__((always_inline)) static inline void Fft_twiddle(const FFT_CPX *x, uint16_t k, int32_t *re, int32_t *im)
+{
+	int32_t c = Fft_cos(k);
+	int32_t s = Fft_cos(k - FFT_QUARTER);
+
+	*re = ((x->re * c) + (x->im * s) + (1 << 14)) >> 15;
+	*im = ((x->im * c) - (x->re * s) + (1 << 14)) >> 15;
+}
+
+void Fft_run(FFT_CPX *x)
+{
+	FFT_CPX t;
+	FFT_CPX *a, *b, *c, *d;
+	int32_t t1r, t1i, t2r, t2i, t3r, t3i;
+	int32_t s0r, s0i, s1r, s1i, s2r, s2i, s3r, s3i;
+	uint16_t i, j, k, span, step;
+
+	for(i = 0; i < FFT_N; i++)
+	{
+		j = fft_bitrev[i];
+		if(i < j)
+		{
+			t = x[i];
+			x[i] = x[j];
+			x[j] = t;
+		}
+	}
+
+#if FFT_LOG2N & 1
+	// radix-2 first so the rest is a whole number of radix-4 stages
+	for(i = 0; i < FFT_N; i += 2)
+	{
+		s0r = x[i].re;
+		s0i = x[i].im;
+		s1r = x[i + 1].re;
+		s1i = x[i + 1].im;
+		x[i].re = (s0r + s1r + 1) >> 1;
+		x[i].im = (s0i + s1i + 1) >> 1;
+		x[i + 1].re = (s0r - s1r + 1) >> 1;
+		x[i + 1].im = (s0i - s1i + 1) >> 1;
+	}
+	span = 2;
+#else
+	span = 1;
+#endif
+
+	// Each pass merges four length span DFTs into one of length 4 * span.
+	// After bit reversal the four inputs sit at offsets 0, span, 2 * span
+	// and 3 * span and hold the residues 0, 2, 1 and 3 mod 4.
+	for(; span < FFT_N; span *= 4)
+	{
+		step = FFT_N / (4 * span);
+
+		for(j = 0; j < span; j++)
+		{
+			for(k = j; k < FFT_N; k += 4 * span)
+			{
+				a = &x[k];
+				b = a + span;
+				c = b + span;
+				d = c + span;
+
+				Fft_twiddle(c, j * step, &t1r, &t1i);
+				Fft_twiddle(b, 2 * j * step, &t2r, &t2i);
+				Fft_twiddle(d, 3 * j * step, &t3r, &t3i);
+
+				s0r = a->re + t2r;
+				s0i = a->im + t2i;
+				s1r = a->re - t2r;
+				s1i = a->im - t2i;
+				s2r = t1r + t3r;
+				s2i = t1i + t3i;
+				s3r = t1r - t3r;
+				s3i = t1i - t3i;
+
+				// bins k, k + N/4, k + N/2, k + 3N/4 of this sub DFT,
+				// the odd ones pick up a -j and +j on the t1 - t3 term
+				a->re = (s0r + s2r + 2) >> 2;
+				a->im = (s0i + s2i + 2) >> 2;
+				b->re = (s1r + s3i + 2) >> 2;
+				b->im = (s1i - s3r + 2) >> 2;
+				c->re = (s0r - s2r + 2) >> 2;
+				c->im = (s0i - s2i + 2) >> 2;
+				d->re = (s1r - s3i + 2) >> 2;
+				d->im = (s1i + s3r + 2) >> 2;
+			}
+		}
+	}
+}
@@ -0,0 +1,227 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file filter.c
+* @brief Fixed point biquad low pass filter
+*
+* This source file implements a cascade of Q14 biquad sections for
+* the accelerometer data
+*
+* @author Jon Warriner
+* @date June 24, 2019
+* @version 1.0
+*
+*/
+
+#include "filter.h"
+
+// see BIQUAD_LP in filter.h for the design
+const BIQUAD_COEF lp_20hz_800hz[2] = BIQUAD_BW4_LP(20, 800);
+const BIQUAD_COEF lp_5hz_100hz[2] = BIQUAD_BW4_LP(5, 100);
+
+static inline int16_t Biquad_sat(int32_t v)
+{
+	if(v > INT16_MAX)
+	{
+		return(INT16_MAX);
+	}
+	if(v < INT16_MIN)
+	{
+		return(INT16_MIN);
+	}
+	return((int16_t)v);
+}
+
+void Biquad_init(BIQUAD *f, const BIQUAD_COEF *coef, uint8_t stages, int16_t x0)
+{
+	uint8_t i;
+
+	if(stages > BIQUAD_MAX_STAGES)
+	{
+		stages = BIQUAD_MAX_STAGES;
+	}
+
+	f->coef = coef;
+	f->stages = stages;
+
+	//every section has unity DC gain, so a constant input is a steady state
+	for(i = 0; i < stages; i++)
+	{
+		f->state[i].x1 = x0;
+		f->state[i].x2 = x0;
+		f->state[i].y1 = x0;
+		f->state[i].y2 = x0;
+		f->state[i].err = 0;
+	}
+}
+
+int16_t Biquad_run(BIQUAD *f, int16_t x)
+{
+	const BIQUAD_COEF *c = f->coef;
+	BIQUAD_STATE *s = f->state;
+	int32_t acc;
+	int16_t y;
+	uint8_t i;
+
+	for(i = 0; i < f->stages; i++, c++, s++)
+	{
+		acc = s->err;
+		acc += (int32_t)c->b0 * x;
+		acc += (int32_t)c->b1 * s->x1;
+		acc += (int32_t)c->b2 * s->x2;
+		acc -= (int32_t)c->a1 * s->y1;
+		acc -= (int32_t)c->a2 * s->y2;
+
+		//keep the fraction for next time, arithmetic shift floors
+		y = Biquad_sat(acc >> BIQUAD_COEF_SHIFT);
+		s->err = acc & ((1 << BIQUAD_COEF_SHIFT) - 1);
+
+		s->x2 = s->x1;
+		s->x1 = x;
+		s->y2 = s->y1;
+		s->y1 = y;
+
+		//output of this section feeds the next
+		x = y;
+	}
+
+	return(x);
+}
+
+void Biquad_block(BIQUAD *f, int16_t *data, uint16_t n)
+{
+	uint16_t i;
+
+	for(i = 0; i < n; i++)
+	{
+		data[i] = Biquad_run(f, data[i]);
+	}
+}
+
+void Filter_init(ACCEL_FILTER *f, const BIQUAD_COEF *coef, uint8_t stages)
+{
+	Biquad_init(&f->x, coef, stages, 0);
+	Biquad_init(&f->y, coef, stages, 0);
+	Biquad_init(&f->z, coef, stages, 0);
+	f->primed = 0;
+}
+
+void Filter_sample(ACCEL_FILTER *f, MMA8451Q_DATA *acc)
+{
+	if(!f->primed)
+	{
+		Biquad_init(&f->x, f->x.coef, f->x.stages, acc->x_data);
+		Biquad_init(&f->y, f->y.coef, f->y.stages, acc->y_data);
+		Biquad_init(&f->z, f->z.coef, f->z.stages, acc->z_data);
+		f->primed = 1;
+	}
+
+	acc->x_data = Biquad_run(&f->x, acc->x_data);
+	acc->y_data = Biquad_run(&f->y, acc->y_data);
+	acc->z_data = Biquad_run(&f->z, acc->z_data);
+}
+
+void Filter_block(ACCEL_FILTER *f, int16_t *x, int16_t *y, int16_t *z, uint16_t n)
+{
+	if(n == 0)
+	{
+		return;
+	}
+
+	if(!f->primed)
+	{
+		Biquad_init(&f->x, f->x.coef, f->x.stages, x[0]);
+		Biquad_init(&f->y, f->y.coef, f->y.stages, y[0]);
+		Biquad_init(&f->z, f->z.coef, f->z.stages, z[0]);
+		f->primed = 1;
+	}
+
+	//one axis at a time keeps each delay line in registers
+	Biquad_block(&f->x, x, n);
+	Biquad_block(&f->y, y, n);
+	Biquad_block(&f->z, z, n);
+}
+
+int32_t Decim_init(DECIM *d, uint16_t ratio, uint8_t order)
+{
+	uint8_t i;
+
+	if((ratio == 0) || (order == 0) || (order > DECIM_MAX_ORDER))
+	{
+		return(-1);
+	}
+
+	d->gain = 1;
+	for(i = 0; i < order; i++)
+	{
+		if(d->gain > (0x10000 / ratio))
+		{
+			return(-1);
+		}
+		d->gain *= ratio;
+	}
+
+	for(i = 0; i < DECIM_MAX_ORDER; i++)
+	{
+		d->integ[i] = 0;
+		d->comb[i] = 0;
+	}
+
+	d->ratio = ratio;
+	d->order = order;
+	d->phase = 0;
+
+	return(0);
+}
+
+uint8_t Decim_run(DECIM *d, int16_t x, int16_t *out)
+{
+	uint32_t v = (uint32_t)(int32_t)x;
+	uint32_t t;
+	uint8_t i;
+
+	for(i = 0; i < d->order; i++)
+	{
+		d->integ[i] += v;
+		v = d->integ[i];
+	}
+
+	if(++d->phase < d->ratio)
+	{
+		return(0);
+	}
+	d->phase = 0;
+
+	for(i = 0; i < d->order; i++)
+	{
+		t = v;
+		v -= d->comb[i];
+		d->comb[i] = t;
+	}
+
+	//|x| * ratio^order fits in an int32, so the modulo 2^32 result is exact
+	*out = (int16_t)((int32_t)v / d->gain);
+
+	return(1);
+}
+
+uint8_t Decim_block(DECIM *d, const int16_t *x, uint16_t n, int16_t *out)
+{
+	uint8_t ret = 0;
+	uint16_t i;
+
+	for(i = 0; i < n; i++)
+	{
+		ret |= Decim_run(d, x[i], out);
+	}
+
+	return(ret);
+}
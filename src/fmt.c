@@ -0,0 +1,191 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file fmt.c
+* @brief Number formatting
+*
+* This source file implements small decimal, fixed point and hex
+* formatters to replace sprintf
+*
+* @author Jon Warriner
+* @date June 29, 2019
+* @version 1.0
+*
+*/
+
+#include "fmt.h"
+
+#define FMT_MAX_DIGITS	10
+
+static const uint32_t fmt_pow10[FMT_MAX_DIGITS] =
+{
+	1000000000, 100000000, 10000000, 1000000, 100000,
+	10000, 1000, 100, 10, 1
+};
+
+static const char fmt_hex[16] = "0123456789ABCDEF";
+
+// Decimal digits of v into buf, at least min_digits of them (leading zeros)
+static uint8_t Fmt_digits(char *buf, uint32_t v, uint8_t min_digits)
+{
+	uint8_t n = 0;
+	uint8_t i;
+	char d;
+
+	for(i = 0; i < FMT_MAX_DIGITS; i++)
+	{
+		d = '0';
+		while(v >= fmt_pow10[i])
+		{
+			v -= fmt_pow10[i];
+			d++;
+		}
+
+		if((n != 0) || (d != '0') || ((FMT_MAX_DIGITS - i) <= min_digits))
+		{
+			buf[n++] = d;
+		}
+	}
+
+	return(n);
+}
+
+// Move len chars right so the field is width wide, space filled
+static uint8_t Fmt_pad(char *buf, uint8_t len, uint8_t width)
+{
+	uint8_t pad;
+	uint8_t i;
+
+	if(width <= len)
+	{
+		return(len);
+	}
+
+	pad = width - len;
+	for(i = len; i > 0; i--)
+	{
+		buf[i - 1 + pad] = buf[i - 1];
+	}
+	for(i = 0; i < pad; i++)
+	{
+		buf[i] = ' ';
+	}
+
+	return(width);
+}
+
+uint8_t Fmt_str(char *buf, const char *s)
+{
+	uint8_t n = 0;
+
+	while(s[n] != 0)
+	{
+		buf[n] = s[n];
+		n++;
+	}
+
+	return(n);
+}
+
+uint8_t Fmt_uint(char *buf, uint32_t v, uint8_t width)
+{
+	return(Fmt_pad(buf, Fmt_digits(buf, v, 1), width));
+}
+
+uint8_t Fmt_int(char *buf, int32_t v, uint8_t width)
+{
+	uint8_t n = 0;
+
+	if(v < 0)
+	{
+		buf[n++] = '-';
+	}
+	// 0 - (uint32_t)v is also right for INT32_MIN
+	n += Fmt_digits(&buf[n], (v < 0) ? (0 - (uint32_t)v) : (uint32_t)v, 1);
+
+	return(Fmt_pad(buf, n, width));
+}
+
+// Magnitude in 10^-decimals units as digits with a point
+static uint8_t Fmt_ufixed(char *buf, uint32_t v, uint8_t decimals)
+{
+	uint8_t n;
+	uint8_t i;
+
+	// all the digits with at least one before the point, then open a gap
+	// for the point
+	n = Fmt_digits(buf, v, decimals + 1);
+	if(decimals != 0)
+	{
+		for(i = 0; i < decimals; i++)
+		{
+			buf[n - i] = buf[n - i - 1];
+		}
+		buf[n - decimals] = '.';
+		n++;
+	}
+
+	return(n);
+}
+
+uint8_t Fmt_fixed(char *buf, int32_t v, uint8_t decimals, uint8_t width)
+{
+	uint8_t n = 0;
+
+	if(v < 0)
+	{
+		buf[n++] = '-';
+	}
+	n += Fmt_ufixed(&buf[n], (v < 0) ? (0 - (uint32_t)v) : (uint32_t)v, decimals);
+
+	return(Fmt_pad(buf, n, width));
+}
+
+uint8_t Fmt_q(char *buf, int32_t v, uint8_t q, uint8_t decimals, uint8_t width)
+{
+	uint64_t m = (v < 0) ? (0 - (uint32_t)v) : (uint32_t)v;
+	uint8_t n = 0;
+
+	// |v| * 10^decimals / 2^q, rounded
+	m = (m * fmt_pow10[FMT_MAX_DIGITS - 1 - decimals]) + ((q != 0) ? (1ULL << (q - 1)) : 0);
+	m >>= q;
+	if(m > UINT32_MAX)
+	{
+		m = UINT32_MAX;
+	}
+
+	// no "-0.000" for values that round to 0
+	if((v < 0) && (m != 0))
+	{
+		buf[n++] = '-';
+	}
+	n += Fmt_ufixed(&buf[n], (uint32_t)m, decimals);
+
+	return(Fmt_pad(buf, n, width));
+}
+
+uint8_t Fmt_hex(char *buf, uint32_t v, uint8_t digits)
+{
+	uint8_t i;
+
+	if(digits > 8)
+	{
+		digits = 8;
+	}
+
+	for(i = digits; i > 0; i--)
+	{
+		buf[i - 1] = fmt_hex[v & 0xF];
+		v >>= 4;
+	}
+
+	return(digits);
+}
@@ -0,0 +1,166 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file goertzel.c
+* @brief Goertzel tone detector bank
+*
+* This source file implements a bank of fixed point Goertzel filters
+*
+* @author Jon Warriner
+* @date June 27, 2019
+* @version 1.0
+*
+*/
+
+#include "goertzel.h"
+#include "angles.h"
+#include "fmt.h"
+
+void Goertzel_init(GOERTZEL *g, const int16_t *coef, uint8_t bins, uint16_t len)
+{
+	uint8_t i;
+
+	if(bins > GOERTZEL_MAX_BINS)
+	{
+		bins = GOERTZEL_MAX_BINS;
+	}
+
+	g->coef = coef;
+	g->bins = bins;
+	g->len = (len == 0) ? 1 : len;
+	g->n = 0;
+	g->ready = 0;
+	g->line = 0;
+
+	for(i = 0; i < GOERTZEL_MAX_BINS; i++)
+	{
+		g->s1[i] = 0;
+		g->s2[i] = 0;
+		g->power[i] = 0;
+		g->amp[i] = 0;
+	}
+}
+
+// (s * c) >> 14 for |s| < 2^29 with two 32 bit multiplies
+__attribute__((always_inline)) static inline int32_t Goertzel_mul(int32_t s, int16_t c)
+{
+	return(((s >> 16) * c * (1 << (16 - GOERTZEL_SHIFT))) + (((int32_t)(s & 0xFFFF) * c) >> GOERTZEL_SHIFT));
+}
+
+static void Goertzel_finish(GOERTZEL *g)
+{
+	int64_t s1, s2, x2;
+	uint32_t len2 = (uint32_t)g->len * g->len;
+	uint8_t sh;
+	uint8_t i;
+
+	// |X|^2 = s1^2 + s2^2 - coef * s1 * s2, and a tone of amplitude A
+	// gives |X| = A * len / 2.  Once per block, so 64 bits is fine here.
+	for(i = 0; i < g->bins; i++)
+	{
+		s1 = g->s1[i];
+		s2 = g->s2[i];
+
+		// coef * s1 * s2 only fits 64 bits with the state under 2^23
+		for(sh = 0; (s1 >= (1 << 23)) || (s1 <= -(1 << 23)) || (s2 >= (1 << 23)) || (s2 <= -(1 << 23)); sh++)
+		{
+			s1 >>= 1;
+			s2 >>= 1;
+		}
+
+		x2 = (s1 * s1) + (s2 * s2) - ((g->coef[i] * s1 * s2) >> GOERTZEL_SHIFT);
+		if(x2 < 0)
+		{
+			x2 = 0;
+		}
+
+		// if the last results are still going out, this block is dropped
+		if(!g->ready)
+		{
+			x2 = ((x2 << (2 * sh)) * 4) / len2;
+			g->power[i] = (x2 > UINT32_MAX) ? UINT32_MAX : (uint32_t)x2;
+			g->amp[i] = Isqrt(g->power[i]);
+		}
+
+		g->s1[i] = 0;
+		g->s2[i] = 0;
+	}
+
+	// a dropped block must not restart the report that is going out
+	if(!g->ready)
+	{
+		g->line = 0;
+		g->ready = 1;
+	}
+	g->n = 0;
+}
+
+uint8_t Goertzel_run(GOERTZEL *g, int16_t x)
+{
+	int32_t s;
+	uint8_t i;
+
+	for(i = 0; i < g->bins; i++)
+	{
+		s = x + Goertzel_mul(g->s1[i], g->coef[i]) - g->s2[i];
+		g->s2[i] = g->s1[i];
+		g->s1[i] = s;
+	}
+
+	if(++g->n < g->len)
+	{
+		return(0);
+	}
+
+	Goertzel_finish(g);
+
+	return(1);
+}
+
+uint8_t Goertzel_block(GOERTZEL *g, const int16_t *x, uint16_t n)
+{
+	uint8_t ret = 0;
+	uint16_t i;
+
+	for(i = 0; i < n; i++)
+	{
+		ret |= Goertzel_run(g, x[i]);
+	}
+
+	return(ret);
+}
+
+void Goertzel_task(GOERTZEL *g, const uint16_t *freq, uint16_t one_g, ring_t *obuf, void (*tx_func)())
+{
+	char *p;
+	uint8_t len;
+
+	if((!g->ready) || (entries(obuf) != 0))
+	{
+		return;
+	}
+
+	p = g->sbuf;
+	p += Fmt_uint(p, freq[g->line], 0);
+	p += Fmt_str(p, " Hz ");
+	p += Fmt_uint(p, ((uint32_t)g->amp[g->line] * 1000) / one_g, 0);
+	p += Fmt_str(p, " mg\r\n");
+	len = p - g->sbuf;
+
+	insert_block(obuf, g->sbuf, len);
+	tx_func();
+
+	if(++g->line >= g->bins)
+	{
+		g->line = 0;
+		g->ready = 0;
+	}
+}
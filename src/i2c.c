@@ -20,10 +20,12 @@
 *
 */
 
+#include <string.h>
 #include "MKL25Z4.h"
 #include "i2c.h"
+#include "timer.h"
 
-void I2C_init(I2C_Packet *packet)
+void I2C_init(I2C_Queue *q)
 {
 
     //I2C0 = 1 - I2C0 clock enabled
@@ -73,9 +75,9 @@ void I2C_init(I2C_Packet *packet)
 
 	// Input Glitch Filter Register
 	// Stop Hold Enabled
-	// Stop Detection Interrupt Disabled
+	// Stop Detection Interrupt Enabled (starts the next queued job)
 	// No Filter/Bypass
-	I2C0->FLT = I2C_FLT_SHEN(1);
+	I2C0->FLT = I2C_FLT_SHEN(1) | I2C_FLT_STOPIE(1);
 
 	// Range Address Register (For Slave Only)
 	I2C0->RA = I2C_RA_RAD(0x00);
@@ -91,39 +93,31 @@ void I2C_init(I2C_Packet *packet)
 	if(I2C0->S & I2C_S_ARBL_MASK)
 		I2C0->S &= I2C_S_ARBL_MASK;
 
-	packet->state = WR_ADDRESS;
-	packet->i2c_callback = 0;
-}
-
-uint8_t I2C_Read(I2C_Packet *packet)
-{
-	volatile uint8_t temp;
+	// empty job queue
+	memset(q, 0, sizeof(I2C_Queue));
 
-	// I2C Transfer done?
-	temp = I2C_Transfer_Complete();
+#ifndef I2C_POLLED
+	//set I2C0 interrupt priority to 1
+#define I2C_PRI	1
+	NVIC->IP[_IP_IDX(I2C0_IRQn)]  = ((uint32_t)(NVIC->IP[_IP_IDX(I2C0_IRQn)]  & ~(0xFFUL << _BIT_SHIFT(I2C0_IRQn))) |
+	   (((I2C_PRI << (8U - __NVIC_PRIO_BITS)) & (uint32_t)0xFFUL) << _BIT_SHIFT(I2C0_IRQn)));
 
-	if(temp > 0)
-	{
-		__asm("bkpt");
-		return temp;
-	}
-
-	// Ensure the bus isn't busy
-	temp = I2C_Check_Busy();
-
-	if(temp > 0)
-	{
-		__asm("bkpt");
-		return temp;
-	}
+	//enable the I2C0 IRQ
+	NVIC->ISER[0U] = (uint32_t)(1UL << (((uint32_t)(int32_t)I2C0_IRQn) & 0x1FUL));
+#endif
+}
 
-	// MST bit should be clear by the time we want to start another message
-	temp =  I2C_Check_MST();
+static uint8_t I2C_Start(I2C_Queue *q, I2C_Packet *packet)
+{
+	packet->status = JOB_ACTIVE;
+	q->t_event = Timer_us();
 
-	if(temp > 0)
+	// The bus has to be idle and MST clear before we can generate a START.
+	// If not, park the job in WAIT_BUS and let I2C_Service() retry it.
+	if(I2C_Check_Busy() || I2C_Check_MST())
 	{
-		__asm("bkpt");
-		return temp;
+		packet->state = WAIT_BUS;
+		return 1;
 	}
 
 	// Return to Transmit Mode
@@ -135,89 +129,145 @@ uint8_t I2C_Read(I2C_Packet *packet)
 	// Transmit data first byte which is slave address
 	// This kicks off the I2C transaction which will be
 	// further handled by a state machine running in
-	// the background loop or an ISR
-	packet->read_write_n = 1;
+	// the I2C0 ISR
+	packet->idx = 0;
 	packet->state = WR_COMMAND;
 	I2C0->D = (packet->slaveAddress << 1);
 
 	return 0;
 }
 
-uint8_t I2C_Write(I2C_Packet *packet)
+static void I2C_Finish(I2C_Queue *q, I2C_JOB_STATUS status)
 {
-	volatile uint8_t temp;
+	I2C_Packet *packet = q->active;
 
-	// Any previous I2C Transfers done?
-	temp = I2C_Transfer_Complete();
+	packet->state = WR_ADDRESS;
+	packet->t_done = Timer_us();
+	// make sure the data is in RAM before the foreground can see the status
+	__DMB();
+	packet->status = status;
+
+	// every finish generates a STOP, the next job starts on STOPF
+	q->active = 0;
+	q->stopping = 1;
+	q->t_event = packet->t_done;
+}
 
-	if(temp > 0)
+static void I2C_Start_Next(I2C_Queue *q)
+{
+	I2C_Packet *next = 0;
+	uint8_t i;
+
+	// must be called from the ISR or with interrupts masked
+	if(q->active != 0)
 	{
-		__asm("bkpt");
-		return temp;
+		return;
 	}
 
-	// Ensure the bus isn't busy
-	temp = I2C_Check_Busy();
+	// highest priority first, oldest first within a priority
+	for(i = 0; i < I2C_QUEUE_SIZE; i++)
+	{
+		if(q->job[i].status != JOB_PENDING)
+		{
+			continue;
+		}
+		if((next == 0) || (q->job[i].priority > next->priority) ||
+		   ((q->job[i].priority == next->priority) && ((int32_t)(q->job[i].seq - next->seq) < 0)))
+		{
+			next = &q->job[i];
+		}
+	}
 
-	if(temp > 0)
+	if(next != 0)
 	{
-		__asm("bkpt");
-		return temp;
+		q->active = next;
+		I2C_Start(q, next);
 	}
+}
 
-	// MST bit should be clear by the time we want to start another message
-	temp =  I2C_Check_MST();
+static uint8_t I2C_Submit(I2C_Queue *q, I2C_Packet *packet)
+{
+	I2C_Packet *slot = 0;
+	uint32_t primask;
+	uint8_t i;
 
-	if(temp > 0)
+	// The data buffer has to be able to hold the whole transfer
+	if((packet->byteCount == 0) ||
+	   ((packet->buffer == 0) && (packet->byteCount > sizeof(packet->data))))
 	{
-		__asm("bkpt");
-		return temp;
+		return 1;
 	}
 
-//#ifndef I2C_LOG
-//	// calculate the PEC
-//	packet->PEC = I2C_Calc_PEC(packet, 0);
-//#endif
+	// Jobs can be submitted from the foreground and from other ISRs, so
+	// claiming and filling the slot has to happen in one go
+	primask = __get_PRIMASK();
+	__disable_irq();
 
-	// Return to Transmit Mode
-	I2C0->C1 |= I2C_C1_TX_MASK;
+	for(i = 0; i < I2C_QUEUE_SIZE; i++)
+	{
+		if(q->job[i].status == JOB_FREE)
+		{
+			slot = &q->job[i];
+			break;
+		}
+	}
 
-	// Start-bit generation
-	I2C0->C1 |= I2C_C1_MST_MASK;
+	if(slot == 0)
+	{
+		// queue is full
+		__set_PRIMASK(primask);
+		return 3;
+	}
 
-	// Transmit data first byte which is slave address
-	// This kicks off the I2C transaction which will be
-	// further handled by a state machine running in
-	// the background loop or an ISR
-	packet->read_write_n = 0;
-	packet->state = WR_COMMAND;
-	I2C0->D = (packet->slaveAddress << 1);
+	*slot = *packet;
+	if(slot->buffer == 0)
+	{
+		// short transfers use the copy of data[] in the slot
+		slot->buffer = slot->data;
+	}
+	slot->state = WR_ADDRESS;
+	slot->seq = q->seq++;
+	slot->t_submit = Timer_us();
+	slot->status = JOB_PENDING;
+
+	q->depth++;
+	if(q->depth > q->max_depth)
+	{
+		q->max_depth = q->depth;
+	}
+
+	// If the bus is idle nothing is going to start this job for us.
+	// Otherwise the ISR will pick it up at the next STOP.
+	if((q->active == 0) && (q->stopping == 0))
+	{
+		I2C_Start_Next(q);
+	}
+
+	__set_PRIMASK(primask);
 
 	return 0;
 }
 
-uint8_t I2C_Transfer_Complete()
+uint8_t I2C_Read(I2C_Queue *q, I2C_Packet *packet)
 {
-	volatile uint8_t temp;
-	volatile uint16_t waitCount;
+	packet->read_write_n = 1;
 
-	waitCount = 0;
+	return I2C_Submit(q, packet);
+}
 
-	// Wait for any I2C transfer to finish
-	while(!(I2C0->S & I2C_S_TCF_MASK))
-	{
-		waitCount++;
+uint8_t I2C_Write(I2C_Queue *q, I2C_Packet *packet)
+{
+	packet->read_write_n = 0;
 
-		if(waitCount == I2C_WAIT_COUNT)
-		{
-			if((I2C0->C1 & I2C_C1_TX_MASK) == I2C_C1_TX_MASK)
-				I2C0->D = 0xFF;
-			else
-				temp = I2C0->D;
+	return I2C_Submit(q, packet);
+}
 
-			__asm("bkpt");
-			return 2;
-		}
+uint8_t I2C_Transfer_Complete()
+{
+	// Has the last byte finished?
+	if(!(I2C0->S & I2C_S_TCF_MASK))
+	{
+		return 2;
 	}
 
 	return 0;
@@ -225,26 +275,10 @@ uint8_t I2C_Transfer_Complete()
 
 uint8_t I2C_Check_Busy()
 {
-	volatile uint8_t temp;
-	volatile uint16_t waitCount;
-
-	waitCount = 0;
-
-	// Ensure we aren't busy
-	while((I2C0->S & I2C_S_BUSY_MASK))
+	// Is anybody holding the bus?
+	if(I2C0->S & I2C_S_BUSY_MASK)
 	{
-		waitCount++;
-
-		if(waitCount == I2C_WAIT_COUNT)
-		{
-			if((I2C0->C1 & I2C_C1_TX_MASK) == I2C_C1_TX_MASK)
-				I2C0->D = 0xFF;
-			else
-				temp = I2C0->D;
-
-			__asm("bkpt");
-			return 2;
-		}
+		return 2;
 	}
 
 	return 0;
@@ -256,19 +290,178 @@ uint8_t I2C_Check_MST()
 	if(I2C0->C1 & I2C_C1_MST_MASK)
 	{
 		error = 2;
-		__asm("bkpt");
 	}
 
 	return(error);
 }
 
-void Run_I2C_Master(I2C_Packet *packet)
+static void I2C_Delay_us(uint32_t us)
+{
+	uint32_t t = Timer_us();
+
+	while((Timer_us() - t) < us)
+	{
+	}
+}
+
+void I2C_Bus_Recover()
+{
+	uint8_t i;
+
+	// Hand PTE24 (SCL) and PTE25 (SDA) to GPIO.  The output latch is
+	// left low so the data direction alone either pulls a line low or
+	// releases it to the pull-up, like an open drain.
+	I2C0->C1 &= ~I2C_C1_IICEN_MASK;
+	GPIOE->PCOR = (1 << 24) | (1 << 25);
+	GPIOE->PDDR &= ~((1 << 24) | (1 << 25));
+	PORTE->PCR[24] = PORT_PCR_MUX(1);
+	PORTE->PCR[25] = PORT_PCR_MUX(1);
+	I2C_Delay_us(I2C_RECOVER_HALF_US);
+
+	// Clock SCL until the slave lets go of SDA.  Nine clocks is enough
+	// to finish any byte plus its ACK.
+	for(i = 0; (i < I2C_RECOVER_CLOCKS) && !(GPIOE->PDIR & (1 << 25)); i++)
+	{
+		GPIOE->PDDR |= (1 << 24);
+		I2C_Delay_us(I2C_RECOVER_HALF_US);
+		GPIOE->PDDR &= ~(1 << 24);
+		I2C_Delay_us(I2C_RECOVER_HALF_US);
+	}
+
+	// Force a STOP: SDA low while SCL is low, release SCL, then SDA
+	GPIOE->PDDR |= (1 << 24);
+	I2C_Delay_us(I2C_RECOVER_HALF_US);
+	GPIOE->PDDR |= (1 << 25);
+	I2C_Delay_us(I2C_RECOVER_HALF_US);
+	GPIOE->PDDR &= ~(1 << 24);
+	I2C_Delay_us(I2C_RECOVER_HALF_US);
+	GPIOE->PDDR &= ~(1 << 25);
+	I2C_Delay_us(I2C_RECOVER_HALF_US);
+
+	// Give the pins back to I2C0 and clear whatever the glitch left behind
+	PORTE->PCR[24] = PORT_PCR_MUX(5);
+	PORTE->PCR[25] = PORT_PCR_MUX(5);
+	I2C0->C1 = I2C_C1_IICEN(1) | I2C_C1_IICIE(1);
+	I2C0->S = I2C_S_ARBL_MASK | I2C_S_IICIF_MASK;
+	I2C0->FLT |= I2C_FLT_STOPF_MASK;
+}
+
+static void I2C_Recover(I2C_Queue *q)
+{
+	I2C_Packet *packet = q->active;
+	uint32_t t = Timer_us();
+
+	// A job that got on the bus has lost its data, a job that was
+	// still waiting for the bus just gets another go afterwards.
+	if((packet != 0) && (packet->state != WAIT_BUS))
+	{
+		I2C_Finish(q, JOB_ERROR);
+		packet = 0;
+	}
+
+	I2C_Bus_Recover();
+
+	q->stopping = 0;
+	q->recoveries++;
+	q->recover_us = Timer_us() - t;
+
+	if(packet != 0)
+	{
+		I2C_Start(q, packet);
+	}
+	else
+	{
+		I2C_Start_Next(q);
+	}
+}
+
+void I2C_Service(I2C_Queue *q)
+{
+	I2C_Packet *packet;
+	uint32_t elapsed;
+
+#ifndef I2C_POLLED
+	// keep the ISR from changing the queue under us
+	NVIC_DisableIRQ(I2C0_IRQn);
+#endif
+
+	packet = q->active;
+	elapsed = Timer_us() - q->t_event;
+
+	if(packet != 0)
+	{
+		if(packet->state == WAIT_BUS)
+		{
+			if(!I2C_Check_Busy() && !I2C_Check_MST())
+			{
+				// the bus came free, go
+				I2C_Start(q, packet);
+			}
+			else if(elapsed > I2C_BUS_TIMEOUT_US)
+			{
+				// somebody is holding the bus
+				I2C_Recover(q);
+			}
+		}
+		else if(elapsed > I2C_XFER_TIMEOUT_US)
+		{
+			// the job stalled part way through
+			I2C_Recover(q);
+		}
+	}
+	else if(q->stopping && (elapsed > I2C_STOP_TIMEOUT_US))
+	{
+		// never saw our STOP on the bus
+		I2C_Recover(q);
+	}
+
+#ifndef I2C_POLLED
+	NVIC_EnableIRQ(I2C0_IRQn);
+#endif
+}
+
+void Run_I2C_Master(I2C_Queue *q)
 {
-	volatile uint8_t dummy;
+	I2C_Packet *packet;
+
+	// STOP detected?
+	if(I2C0->FLT & I2C_FLT_STOPF_MASK)
+	{
+		I2C0->FLT |= I2C_FLT_STOPF_MASK;
+		q->stopping = 0;
+
+		if(q->active == 0)
+		{
+			// The bus is free now, clear the interrupt flag that came with
+			// the STOP and kick off the next queued job
+			I2C0->S |= I2C_S_IICIF_MASK;
+			I2C_Start_Next(q);
+			return;
+		}
+	}
+
+	packet = q->active;
+
+	// Lost arbitration?  The hardware has already dropped MST.
+	if(I2C0->S & I2C_S_ARBL_MASK)
+	{
+		I2C0->S = I2C_S_ARBL_MASK | I2C_S_IICIF_MASK;
+		if(packet != 0)
+		{
+			I2C_Finish(q, JOB_ERROR);
+		}
+		return;
+	}
 
 	// Clear Interrupt flag
 	I2C0->S |= I2C_S_IICIF_MASK;
 
+	if(packet == 0)
+	{
+		// nothing on the bus that we know about
+		return;
+	}
+
 	// TX or RX mode?
 	if(I2C0->C1 & I2C_C1_TX_MASK)
 	{
@@ -279,12 +472,10 @@ void Run_I2C_Master(I2C_Packet *packet)
 		// generate a stop condition.
 		if(I2C0->S & I2C_S_RXAK_MASK)
 		{
-			// reset the packet state
-			packet->state = WR_ADDRESS;
-			// The data is going to be invalid so don't execute the callback.
-			packet->i2c_callback = 0;
 			// Generate STOP signal
 			I2C0->C1 &= ~I2C_C1_MST_MASK;
+			// The data is going to be invalid so flag the job as failed.
+			I2C_Finish(q, JOB_ERROR);
 //			__asm("bkpt");
 		}
 		else
@@ -308,14 +499,18 @@ void Run_I2C_Master(I2C_Packet *packet)
 				}
 				break;
 			case WR_DATA1:
-				I2C0->D = packet->data[0];
-				packet->state++;
+				I2C0->D = packet->buffer[packet->idx++];
+				// stay here until the last data byte has gone out
+				if(packet->idx >= packet->byteCount)
+				{
+					packet->state++;
+				}
 				break;
 			case WR_DONE:
-				// reset the packet state
-				packet->state = WR_ADDRESS;
 				// Generate STOP signal
 				I2C0->C1 &= ~I2C_C1_MST_MASK;
+				// let the foreground know the write finished
+				I2C_Finish(q, JOB_DONE);
 				break;
 			case RD_ADDRESS:
 				// generate repeated start
@@ -325,16 +520,19 @@ void Run_I2C_Master(I2C_Packet *packet)
 				break;
 			case RD_SWITCH:
 				I2C0->C1 &= ~I2C_C1_TX_MASK;		// switch to receive mode
-				dummy = I2C0->D;
+				// a single byte read has to NACK the very first byte
+				if(packet->byteCount == 1)
+				{
+					I2C0->C1 |= I2C_C1_TXAK_MASK;
+				}
+				(void)I2C0->D;
 				packet->state++;
 				break;
 			default:
-				// reset the packet state
-				packet->state = WR_ADDRESS;
-				// The data is going to be invalid so don't execute the callback.
-				packet->i2c_callback = 0;
 				// Generate STOP signal
 				I2C0->C1 &= ~I2C_C1_MST_MASK;
+				// The data is going to be invalid so flag the job as failed.
+				I2C_Finish(q, JOB_ERROR);
 //				__asm("bkpt");
 				break;
 			}
@@ -348,12 +546,29 @@ void Run_I2C_Master(I2C_Packet *packet)
 		switch(packet->state)
 		{
 		case RD_DATA:
-			packet->state = WR_ADDRESS;
-			// Generate STOP signal
-			I2C0->C1 &= ~I2C_C1_MST_MASK;
-			// switch back to TX mode before we read the data
-			I2C0->C1 |= I2C_C1_TX_MASK;
-			packet->data[0] = I2C0->D;
+			if(packet->idx >= (packet->byteCount - 1))
+			{
+				// last byte
+				packet->state = WR_DONE;
+				// Generate STOP signal
+				I2C0->C1 &= ~I2C_C1_MST_MASK;
+				// switch back to TX mode before we read the data so
+				// that reading D doesn't clock in another byte
+				I2C0->C1 |= I2C_C1_TX_MASK;
+				I2C0->C1 &= ~I2C_C1_TXAK_MASK;
+			}
+			else if(packet->idx == (packet->byteCount - 2))
+			{
+				// second to last byte, NACK the byte that follows it
+				I2C0->C1 |= I2C_C1_TXAK_MASK;
+			}
+			// reading D starts the reception of the next byte
+			packet->buffer[packet->idx++] = I2C0->D;
+			// let the foreground know the data is ready
+			if(packet->state == WR_DONE)
+			{
+				I2C_Finish(q, JOB_DONE);
+			}
 			break;
 #ifdef JUNK
 		case RD_DATA1:
@@ -376,38 +591,71 @@ void Run_I2C_Master(I2C_Packet *packet)
 			break;
 #endif
 		default:
-			// reset the packet state
-			packet->state = WR_ADDRESS;
-			// The data is going to be invalid so don't execute the callback.
-			packet->i2c_callback = 0;
 			// Generate STOP signal
 			I2C0->C1 &= ~I2C_C1_MST_MASK;
-			dummy = I2C0->D;
+			I2C0->C1 |= I2C_C1_TX_MASK;
+			I2C0->C1 &= ~I2C_C1_TXAK_MASK;
+			(void)I2C0->D;
+			// The data is going to be invalid so flag the job as failed.
+			I2C_Finish(q, JOB_ERROR);
 			break;
 		}
 	}
-//	dummy_flag = 0;
 }
 
-void I2C_POLL(I2C_Packet *packet)
+void I2C_POLL(I2C_Queue *q)
 {
-	if(I2C0->S & I2C_S_IICIF_MASK)
+	if((I2C0->S & I2C_S_IICIF_MASK) || (I2C0->FLT & I2C_FLT_STOPF_MASK))
 	{
-		Run_I2C_Master(packet);
+		Run_I2C_Master(q);
 	}
 }
 
-uint8_t Check_I2C_Callback(I2C_Packet *packet, void *p)
+uint8_t Check_I2C_Callback(I2C_Queue *q)
 {
 	uint8_t error = 0;
-	if((packet->i2c_callback != 0) && (packet->state == WR_ADDRESS))
+	uint8_t i;
+	uint32_t latency;
+	uint32_t primask;
+	I2C_Packet *packet;
+
+	for(i = 0; i < I2C_QUEUE_SIZE; i++)
 	{
-		error = packet->i2c_callback(packet->data[0], p);
+		packet = &q->job[i];
+
+		if((packet->status != JOB_DONE) && (packet->status != JOB_ERROR))
+		{
+			continue;
+		}
+		// pairs with the barrier in I2C_Finish()
+		__DMB();
+
+		latency = packet->t_done - packet->t_submit;
+		q->latency_last = latency;
+		if(latency > q->latency_max)
+		{
+			q->latency_max = latency;
+		}
+		q->completed++;
+
+		if(packet->i2c_callback != 0)
+		{
+			// a byteCount of 0 tells the callback the job failed
+			error = packet->i2c_callback(packet->buffer,
+					(packet->status == JOB_DONE) ? packet->byteCount : 0, packet->context);
+		}
+		if(packet->status == JOB_ERROR)
+		{
+			q->errors++;
+		}
+
 		// we only want to run the callback once
-		packet->i2c_callback = 0;
-		// make sure TXAK is cleared
-		I2C0->C1 &= ~I2C_C1_TXAK_MASK;
+		primask = __get_PRIMASK();
+		__disable_irq();
+		packet->status = JOB_FREE;
+		q->depth--;
+		__set_PRIMASK(primask);
 	}
+
 	return(error);
 }
-
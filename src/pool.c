@@ -0,0 +1,86 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file pool.c
+* @brief Fixed block pool allocator
+*
+* This source file implements allocation of same sized blocks from
+* static storage, in constant time and without the heap
+*
+* @author Jon Warriner
+* @date June 29, 2019
+* @version 1.0
+*
+*/
+
+#include "pool.h"
+#include "MKL25Z4.h"
+
+void *Pool_alloc(POOL *p)
+{
+	void *blk;
+	uint32_t primask;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	blk = p->free;
+	if(blk != 0)
+	{
+		p->free = *(void **)blk;
+	}
+	else if(p->fresh < p->end)
+	{
+		blk = p->fresh;
+		p->fresh += p->size;
+	}
+
+	__set_PRIMASK(primask);
+
+	return(blk);
+}
+
+int32_t Pool_free(POOL *p, void *blk)
+{
+	uint32_t primask;
+#ifdef DEBUG
+	void *f;
+#endif
+
+	// only whole blocks that have been handed out, size is a power of 2
+	if(((char *)blk < p->base) || ((char *)blk >= p->fresh) ||
+	   ((((uint32_t)((char *)blk - p->base)) & (p->size - 1)) != 0))
+	{
+		return(-1);
+	}
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+#ifdef DEBUG
+	// a block freed twice would be handed out twice
+	for(f = p->free; f != 0; f = *(void **)f)
+	{
+		if(f == blk)
+		{
+			__set_PRIMASK(primask);
+			return(-1);
+		}
+	}
+#endif
+
+	*(void **)blk = p->free;
+	p->free = blk;
+
+	__set_PRIMASK(primask);
+
+	return(0);
+}
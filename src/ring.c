@@ -23,15 +23,28 @@
 */
 
 #include "ring.h"
+#include "MKL25Z4.h"
+#include <string.h>
+#if RING_USE_HEAP
 #include <stdlib.h>
+#endif
 
+// Single producer, single consumer: only the producer writes Ini and only
+// the consumer writes Outi, so neither side needs a critical section.
+// Each side publishes its index with a barrier after the data it covers,
+// and the consumer has a barrier between seeing Ini and reading the data.
+// Both indices run freely and wrap modulo 2^32, which is well defined for
+// unsigned types; Ini - Outi is still the fill level across the wrap.
+
+#if RING_USE_HEAP
 ring_t *ring_init( int32_t length )
 {
 char *pbuf = 0;
 ring_t *r = 0;
 
-    // make sure the requested length makes sense
-    if(length <= 0)
+    // make sure the requested length makes sense, the indices are masked
+    // with Length - 1 so it has to be a power of 2
+    if((length <= 0) || ((length & (length - 1)) != 0))
     {
         return 0;
     }
@@ -49,20 +62,29 @@ ring_t *r = 0;
     }
     else
     {
+        free(pbuf);
+        free(r);
         return 0;
     }
 
 }
+#endif
 
 int32_t insert( ring_t *ring, char data )
 {
+uint32_t ini;
+
     if(ring == 0)
     {
         return(-1);  //invalid pointer
     }
-    else if( ring->Ini - ring->Outi < ring->Length ) 
+
+    ini = ring->Ini;
+    if( ini - ring->Outi < ring->Length ) 
     {
-        ring->Buffer[ring->Ini++ & (ring->Length - 1)] = data;
+        ring->Buffer[ini & (ring->Length - 1)] = data;
+        __DMB();
+        ring->Ini = ini + 1;
         return 0;
     }
     else
@@ -73,13 +95,20 @@ int32_t insert( ring_t *ring, char data )
 
 int32_t extract( ring_t *ring, char *data )
 {
+uint32_t outi;
+
     if(ring == 0)
     {
         return(-1);  //invalid pointer
     }
-    else if( ring->Outi != ring->Ini )
+
+    outi = ring->Outi;
+    if( outi != ring->Ini )
     {
-        *data = ring->Buffer[ring->Outi++ & (ring->Length - 1)];
+        __DMB();
+        *data = ring->Buffer[outi & (ring->Length - 1)];
+        __DMB();
+        ring->Outi = outi + 1;
         return 0;
     }
     else
@@ -96,7 +125,159 @@ int32_t entries( ring_t *ring )
     }
     else
     {
-        return((ring->Ini - ring->Outi));
+        return((int32_t)(ring->Ini - ring->Outi));
+    }
+}
+
+int32_t insert_block( ring_t *ring, const char *data, int32_t len )
+{
+uint32_t ini;
+uint32_t room;
+uint32_t pos;
+uint32_t first;
+
+    if((ring == 0) || (data == 0) || (len < 0))
+    {
+        return(-1);  //invalid pointer
+    }
+
+    // only what fits
+    ini = ring->Ini;
+    room = ring->Length - (ini - ring->Outi);
+    if((uint32_t)len > room)
+    {
+        len = room;
+    }
+
+    // up to the end of the storage, then wrap to the start
+    pos = ini & (ring->Length - 1);
+    first = ring->Length - pos;
+    if(first > (uint32_t)len)
+    {
+        first = len;
+    }
+    memcpy(&ring->Buffer[pos], data, first);
+    memcpy(ring->Buffer, &data[first], len - first);
+
+    __DMB();
+    ring->Ini = ini + len;
+
+    return(len);
+}
+
+int32_t extract_block( ring_t *ring, char *data, int32_t len )
+{
+uint32_t outi;
+uint32_t used;
+uint32_t pos;
+uint32_t first;
+
+    if((ring == 0) || (data == 0) || (len < 0))
+    {
+        return(-1);  //invalid pointer
+    }
+
+    // only what is there
+    outi = ring->Outi;
+    used = ring->Ini - outi;
+    if((uint32_t)len > used)
+    {
+        len = used;
+    }
+    __DMB();
+
+    // up to the end of the storage, then wrap to the start
+    pos = outi & (ring->Length - 1);
+    first = ring->Length - pos;
+    if(first > (uint32_t)len)
+    {
+        first = len;
+    }
+    memcpy(data, &ring->Buffer[pos], first);
+    memcpy(&data[first], ring->Buffer, len - first);
+
+    __DMB();
+    ring->Outi = outi + len;
+
+    return(len);
+}
+
+int32_t peek_span( ring_t *ring, char **span )
+{
+uint32_t used;
+uint32_t pos;
+
+    if((ring == 0) || (span == 0))
+    {
+        return(-1);  //invalid pointer
+    }
+
+    pos = ring->Outi;
+    used = ring->Ini - pos;
+    __DMB();
+    pos &= ring->Length - 1;
+    *span = &ring->Buffer[pos];
+
+    // stop at the end of the storage
+    return((used < (ring->Length - pos)) ? used : (ring->Length - pos));
+}
+
+int32_t commit_read( ring_t *ring, int32_t len )
+{
+uint32_t outi;
+
+    if(ring == 0)
+    {
+        return(-1);  //invalid pointer
+    }
+
+    outi = ring->Outi;
+    if((len < 0) || ((uint32_t)len > (ring->Ini - outi)))
+    {
+        return(-1);  //more than is in the buffer
+    }
+
+    __DMB();
+    ring->Outi = outi + len;
+    return(0);
+}
+
+int32_t write_span( ring_t *ring, char **span )
+{
+uint32_t room;
+uint32_t pos;
+
+    if((ring == 0) || (span == 0))
+    {
+        return(-1);  //invalid pointer
     }
+
+    pos = ring->Ini;
+    room = ring->Length - (pos - ring->Outi);
+    __DMB();
+    pos &= ring->Length - 1;
+    *span = &ring->Buffer[pos];
+
+    // stop at the end of the storage
+    return((room < (ring->Length - pos)) ? room : (ring->Length - pos));
 }
 
+int32_t commit_write( ring_t *ring, int32_t len )
+{
+uint32_t ini;
+
+    if(ring == 0)
+    {
+        return(-1);  //invalid pointer
+    }
+
+    ini = ring->Ini;
+    if((len < 0) || ((uint32_t)len > (ring->Length - (ini - ring->Outi))))
+    {
+        return(-1);  //more than there is room for
+    }
+
+    __DMB();
+    ring->Ini = ini + len;
+    return(0);
+}
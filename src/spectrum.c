@@ -0,0 +1,181 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file spectrum.c
+* @brief Vibration spectrum mode
+*
+* This source file implements windowed FFT spectra of the acceleration
+* data and reports them over the serial port
+*
+* @author Jon Warriner
+* @date June 26, 2019
+* @version 1.0
+*
+*/
+
+#include "spectrum.h"
+#include "angles.h"
+#include "fmt.h"
+
+void Spectrum_init(SPECTRUM *s, uint32_t fs_chz, uint16_t one_g, SPEC_REPORT report)
+{
+	s->idx = 0;
+	s->state = SPEC_COLLECT;
+	s->report = report;
+	s->fs_chz = fs_chz;
+	s->one_g = one_g;
+	s->peaks = 0;
+}
+
+void Spectrum_add(SPECTRUM *s, int16_t x)
+{
+	if((s->state != SPEC_COLLECT) || (s->idx >= FFT_N))
+	{
+		return;
+	}
+
+	s->buf[s->idx].re = x;
+	s->idx++;
+}
+
+void Spectrum_add_block(SPECTRUM *s, const int16_t *x, uint16_t n)
+{
+	uint16_t i;
+
+	for(i = 0; i < n; i++)
+	{
+		Spectrum_add(s, x[i]);
+	}
+}
+
+static void Spectrum_transform(SPECTRUM *s)
+{
+	int32_t sum = 0;
+	int32_t mean;
+	int32_t v;
+	uint16_t i, j;
+
+	for(i = 0; i < FFT_N; i++)
+	{
+		sum += s->buf[i].re;
+	}
+	mean = sum / FFT_N;
+
+	// Hann window, w = (1 - cos) / 2 in Q15.  (x - mean) needs 17 bits, so
+	// the window product is shifted one extra bit to keep |x| <= 32767 for
+	// the FFT.
+	for(i = 0; i < FFT_N; i++)
+	{
+		v = s->buf[i].re - mean;
+		s->buf[i].re = (v * ((32767 - Fft_cos(i)) >> 1)) >> 16;
+		s->buf[i].im = 0;
+	}
+
+	Fft_run(s->buf);
+
+	// the input is real, so bins above N/2 mirror the ones below
+	for(i = 0; i <= SPEC_BINS; i++)
+	{
+		s->buf[i].re = Isqrt(((int32_t)s->buf[i].re * s->buf[i].re) +
+							 ((int32_t)s->buf[i].im * s->buf[i].im));
+	}
+
+	// keep the largest local maxima, biggest first, DC is never a peak
+	s->peaks = 0;
+	for(i = 1; i < SPEC_BINS; i++)
+	{
+		if((s->buf[i].re == 0) || (s->buf[i].re <= s->buf[i - 1].re) || (s->buf[i].re < s->buf[i + 1].re))
+		{
+			continue;
+		}
+
+		for(j = s->peaks; (j > 0) && (s->buf[s->peak_bin[j - 1]].re < s->buf[i].re); j--)
+		{
+			if(j < SPEC_PEAKS)
+			{
+				s->peak_bin[j] = s->peak_bin[j - 1];
+			}
+		}
+		if(j < SPEC_PEAKS)
+		{
+			s->peak_bin[j] = i;
+			if(s->peaks < SPEC_PEAKS)
+			{
+				s->peaks++;
+			}
+		}
+	}
+}
+
+void Spectrum_task(SPECTRUM *s, ring_t *obuf, void (*tx_func)())
+{
+	uint32_t bin;
+	uint32_t f_chz;
+	uint32_t amp;
+	char *p;
+	uint8_t len;
+
+	if(s->state == SPEC_COLLECT)
+	{
+		if(s->idx < FFT_N)
+		{
+			return;
+		}
+
+		Spectrum_transform(s);
+		s->idx = 0;
+		s->state = SPEC_SEND;
+	}
+
+	// one line at a time, and only when the last one is gone
+	if(entries(obuf) != 0)
+	{
+		return;
+	}
+
+	if(s->report == SPEC_REPORT_PEAKS)
+	{
+		if(s->idx >= s->peaks)
+		{
+			s->idx = 0;
+			s->state = SPEC_COLLECT;
+			return;
+		}
+		bin = s->peak_bin[s->idx];
+	}
+	else
+	{
+		if(s->idx > SPEC_BINS)
+		{
+			s->idx = 0;
+			s->state = SPEC_COLLECT;
+			return;
+		}
+		bin = s->idx;
+	}
+
+	// a sine of amplitude A lands in its bin as A / 8: 1/2 for the real
+	// input, 1/2 for the Hann window and 1/2 for the extra shift
+	f_chz = (bin * s->fs_chz) / FFT_N;
+	amp = ((uint32_t)s->buf[bin].re * 8 * 1000) / s->one_g;
+
+	p = s->sbuf;
+	p += Fmt_fixed(p, f_chz, 2, 0);
+	p += Fmt_str(p, (s->report == SPEC_REPORT_PEAKS) ? " Hz " : " ");
+	p += Fmt_uint(p, amp, 0);
+	p += Fmt_str(p, (s->report == SPEC_REPORT_PEAKS) ? " mg\r\n" : "\r\n");
+	len = p - s->sbuf;
+
+	insert_block(obuf, s->sbuf, len);
+	tx_func();
+
+	s->idx++;
+}
@@ -0,0 +1,177 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file stats.c
+* @brief Streaming vibration statistics
+*
+* This source file implements per window mean, RMS, peak and crest
+* factor of the acceleration data
+*
+* @author Jon Warriner
+* @date June 28, 2019
+* @version 1.0
+*
+*/
+
+#include "stats.h"
+#include "angles.h"
+#include "fmt.h"
+
+static void Stats_clear(STATS *s)
+{
+	uint8_t i;
+
+	for(i = 0; i < 3; i++)
+	{
+		s->acc[i].sum = 0;
+		s->acc[i].sumsq = 0;
+		s->acc[i].min = INT16_MAX;
+		s->acc[i].max = INT16_MIN;
+	}
+	s->n = 0;
+}
+
+void Stats_init(STATS *s, uint16_t len)
+{
+	s->len = (len == 0) ? 1 : len;
+	s->ready = 0;
+	s->line = 0;
+	Stats_clear(s);
+}
+
+__attribute__((always_inline)) static inline void Stats_add(STATS_ACC *a, int16_t x)
+{
+	a->sum += x;
+	a->sumsq += (uint32_t)((int32_t)x * x);
+	if(x < a->min)
+	{
+		a->min = x;
+	}
+	if(x > a->max)
+	{
+		a->max = x;
+	}
+}
+
+static void Stats_finish(STATS_ACC *a, uint16_t n, STATS_RESULT *r)
+{
+	int64_t mean;
+	int64_t var;
+	int32_t pk;
+
+	mean = a->sum / n;
+
+	// sum of squares about the mean, sum^2 < 2^62 for n < 2^16
+	var = ((int64_t)a->sumsq - ((a->sum * a->sum) / n)) / n;
+	if(var < 0)
+	{
+		var = 0;
+	}
+
+	r->mean = (int16_t)mean;
+	r->min = a->min;
+	r->max = a->max;
+	r->rms = Isqrt((uint32_t)(a->sumsq / n));
+	r->ac_rms = Isqrt((uint32_t)var);
+
+	pk = a->max - (int32_t)mean;
+	if(((int32_t)mean - a->min) > pk)
+	{
+		pk = (int32_t)mean - a->min;
+	}
+	r->peak = (pk > UINT16_MAX) ? UINT16_MAX : pk;
+
+	if(r->ac_rms == 0)
+	{
+		r->crest = 0;
+	}
+	else
+	{
+		pk = ((uint32_t)r->peak * 100) / r->ac_rms;
+		r->crest = (pk > UINT16_MAX) ? UINT16_MAX : pk;
+	}
+}
+
+uint8_t Stats_run(STATS *s, int16_t x, int16_t y, int16_t z)
+{
+	uint8_t i;
+
+	Stats_add(&s->acc[0], x);
+	Stats_add(&s->acc[1], y);
+	Stats_add(&s->acc[2], z);
+
+	if(++s->n < s->len)
+	{
+		return(0);
+	}
+
+	// if the last window is still going out, this one is dropped
+	if(!s->ready)
+	{
+		for(i = 0; i < 3; i++)
+		{
+			Stats_finish(&s->acc[i], s->n, &s->res[i]);
+		}
+		s->line = 0;
+		s->ready = 1;
+	}
+	Stats_clear(s);
+
+	return(1);
+}
+
+uint8_t Stats_block(STATS *s, const int16_t *x, const int16_t *y, const int16_t *z, uint16_t n)
+{
+	uint8_t ret = 0;
+	uint16_t i;
+
+	for(i = 0; i < n; i++)
+	{
+		ret |= Stats_run(s, x[i], y[i], z[i]);
+	}
+
+	return(ret);
+}
+
+void Stats_task(STATS *s, ring_t *obuf, void (*tx_func)())
+{
+	STATS_RESULT *r;
+	char *p;
+	uint8_t len;
+
+	if((!s->ready) || (entries(obuf) != 0))
+	{
+		return;
+	}
+
+	r = &s->res[s->line];
+	p = s->sbuf;
+	*p++ = 'X' + s->line;
+	*p++ = ' ';
+	p += Fmt_int(p, r->mean, 0);
+	p += Fmt_str(p, " sd ");
+	p += Fmt_uint(p, r->ac_rms, 0);
+	p += Fmt_str(p, " pk ");
+	p += Fmt_uint(p, r->peak, 0);
+	p += Fmt_str(p, " cf ");
+	p += Fmt_fixed(p, r->crest, 2, 0);
+	p += Fmt_str(p, "\r\n");
+	len = p - s->sbuf;
+
+	insert_block(obuf, s->sbuf, len);
+	tx_func();
+
+	if(++s->line >= 3)
+	{
+		s->line = 0;
+		s->ready = 0;
+	}
+}
@@ -0,0 +1,134 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file tilt.c
+* @brief Tilt limit event detector
+*
+* This source file implements a debounced, hysteretic tilt limit
+* detector and its event messages
+*
+* @author Jon Warriner
+* @date June 28, 2019
+* @version 1.0
+*
+*/
+
+#include "tilt.h"
+#include "fmt.h"
+
+void Tilt_init(TILT *t, const TILT_CFG *cfg)
+{
+	t->cfg = *cfg;
+	t->tipped = 0;
+	t->count = 0;
+	Tilt_queue_init(&t->ev);
+	t->ev_lost = 0;
+}
+
+static inline int16_t Tilt_abs(int16_t v)
+{
+	return((v < 0) ? -v : v);
+}
+
+TILT_EVENT_TYPE Tilt_run(TILT *t, int16_t pitch, int16_t roll, uint8_t dynamic)
+{
+	TILT_EVENT e;
+	uint8_t change;
+
+	if(dynamic)
+	{
+		return(TILT_NONE);
+	}
+
+	// level -> tipped past either limit, tipped -> level only once both
+	// are back inside by the hysteresis
+	if(t->tipped)
+	{
+		change = (Tilt_abs(pitch) < (t->cfg.pitch_limit - t->cfg.hyst)) &&
+				 (Tilt_abs(roll) < (t->cfg.roll_limit - t->cfg.hyst));
+	}
+	else
+	{
+		change = (Tilt_abs(pitch) > t->cfg.pitch_limit) || (Tilt_abs(roll) > t->cfg.roll_limit);
+	}
+
+	if(!change)
+	{
+		t->count = 0;
+		return(TILT_NONE);
+	}
+
+	if(++t->count < t->cfg.debounce)
+	{
+		return(TILT_NONE);
+	}
+
+	t->count = 0;
+	t->tipped ^= 1;
+
+	e.type = (t->tipped) ? TILT_TIPPED : TILT_LEVEL;
+	e.pitch = pitch;
+	e.roll = roll;
+	if(Tilt_queue_push(&t->ev, &e) != 0)
+	{
+		t->ev_lost++;
+	}
+
+	return((t->tipped) ? TILT_TIPPED : TILT_LEVEL);
+}
+
+TILT_EVENT_TYPE Tilt_block(TILT *t, const int16_t *pitch, const int16_t *roll, const uint8_t *dynamic, uint16_t n)
+{
+	TILT_EVENT_TYPE ev = TILT_NONE;
+	TILT_EVENT_TYPE r;
+	uint16_t i;
+
+	for(i = 0; i < n; i++)
+	{
+		r = Tilt_run(t, pitch[i], roll[i], (dynamic) ? dynamic[i] : 0);
+		if(r != TILT_NONE)
+		{
+			ev = r;
+		}
+	}
+
+	return(ev);
+}
+
+void Tilt_task(TILT *t, ring_t *obuf, void (*tx_func)())
+{
+	TILT_EVENT *e;
+	char *p;
+	uint8_t len;
+
+	if(entries(obuf) != 0)
+	{
+		return;
+	}
+
+	e = Tilt_queue_peek(&t->ev);
+	if(e == 0)
+	{
+		return;
+	}
+
+	p = t->sbuf;
+	p += Fmt_str(p, (e->type == TILT_TIPPED) ? "TILT " : "LEVEL ");
+	p += Fmt_int(p, e->pitch, 0);
+	*p++ = ' ';
+	p += Fmt_int(p, e->roll, 0);
+	p += Fmt_str(p, "\r\n");
+	len = p - t->sbuf;
+	Tilt_queue_drop(&t->ev);
+
+	insert_block(obuf, t->sbuf, len);
+	tx_func();
+}
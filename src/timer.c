@@ -0,0 +1,80 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file timer.c
+* @brief SysTick time base
+*
+* This source file implements a free running time base on SysTick
+*
+* @author Jon Warriner
+* @date June 20, 2019
+* @version 1.0
+*
+*/
+
+#include "MKL25Z4.h"
+#include "timer.h"
+
+static volatile uint32_t ms_tick = 0;
+static uint32_t us_per_tick_q16 = 65536;
+
+void Timer_init()
+{
+	//us per tick in Q16, rounded up, so Timer_us() multiplies instead of
+	//calling the library divide.  Worked out from the clock itself, not a
+	//whole number of ticks per us, so 20.97MHz isn't taken as 20MHz.  A ms
+	//of ticks times this is about 1000 << 16, well inside 32 bits.
+	us_per_tick_q16 = (uint32_t)(((1000000ULL << 16) + SystemCoreClock - 1) / SystemCoreClock);
+
+	//1ms SysTick interrupt off the core clock
+	SysTick_Config(SystemCoreClock / 1000U);
+
+	//SysTick_Config leaves SysTick at the lowest priority.  Move it to the
+	//highest so Timer_us() can't miss a wrap when called from another ISR.
+	NVIC_SetPriority(SysTick_IRQn, 0);
+}
+
+uint32_t Timer_ms()
+{
+	return(ms_tick);
+}
+
+uint32_t Timer_us()
+{
+	uint32_t tick;
+	uint32_t ms;
+	uint32_t val;
+
+	//if the tick changes while we read VAL, read both again
+	do
+	{
+		tick = ms_tick;
+		ms = tick;
+		val = SysTick->VAL;
+
+		//With PRIMASK set, or from an ISR SysTick can't preempt, a wrap
+		//only shows up as a pending SysTick.  Count it here, and read VAL
+		//again since the first read may have been before the reload.
+		if(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+		{
+			val = SysTick->VAL;
+			ms++;
+		}
+	} while(tick != ms_tick);
+
+	//SysTick counts down from LOAD
+	return((ms * 1000U) + (((SysTick->LOAD - val) * us_per_tick_q16) >> 16));
+}
+
+void SysTick_Handler(void)
+{
+	ms_tick++;
+}
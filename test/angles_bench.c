@@ -0,0 +1,202 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file angles_bench.c
+* @brief Host benchmark of the angle math
+*
+* ns per call on the build machine against libm.  Only the ratios mean
+* anything for the M0+, which has no FPU and no divide.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <math.h>
+#include "angles.h"
+#include "test.h"
+
+#define BENCH_N			(1 << 16)		//inputs per pass
+#define BENCH_PASSES	64
+
+static int16_t bx[BENCH_N], by[BENCH_N];
+static volatile int32_t sink;
+
+//same int16 inputs for every function, from a fixed LCG
+static void Bench_inputs(void)
+{
+	uint32_t seed = 12345;
+	int i;
+
+	for(i = 0; i < BENCH_N; i++)
+	{
+		seed = (seed * 1664525) + 1013904223;
+		bx[i] = (int16_t)(seed >> 16);
+		seed = (seed * 1664525) + 1013904223;
+		by[i] = (int16_t)(seed >> 16);
+	}
+}
+
+static int32_t Libm_atan2(int32_t y, int32_t x, uint32_t *mag)
+{
+	*mag = (uint32_t)sqrtf(((float)x * x) + ((float)y * y));
+	return((int32_t)lrintf(atan2f(y, x) * (float)(180.0 * ANGLE_SCALE / M_PI)));
+}
+
+static void Bench_atan2(const char *name, int32_t (*f)(int32_t, int32_t, uint32_t *))
+{
+	double t;
+	int32_t acc = 0;
+	uint32_t mag;
+	int p, i;
+
+	t = Test_now();
+	for(p = 0; p < BENCH_PASSES; p++)
+	{
+		for(i = 0; i < BENCH_N; i++)
+		{
+			acc += f(by[i], bx[i], &mag) + mag;
+		}
+	}
+	t = Test_now() - t;
+	sink = acc;
+	printf("%-18s %6.1f ns/call\n", name, t * 1e9 / ((double)BENCH_N * BENCH_PASSES));
+}
+
+static void Bench_asin(void)
+{
+	double t;
+	int32_t acc = 0;
+	int p, i;
+
+	t = Test_now();
+	for(p = 0; p < BENCH_PASSES; p++)
+	{
+		for(i = 0; i < BENCH_N; i++)
+		{
+			acc += Lut_asin(bx[i]);
+		}
+	}
+	t = Test_now() - t;
+	sink = acc;
+	printf("%-18s %6.1f ns/call\n", "Lut_asin", t * 1e9 / ((double)BENCH_N * BENCH_PASSES));
+
+	t = Test_now();
+	for(p = 0; p < BENCH_PASSES; p++)
+	{
+		for(i = 0; i < BENCH_N; i++)
+		{
+			acc += (int32_t)lrintf(asinf(bx[i] * (1.0f / 32768)) * (float)(180.0 * ANGLE_SCALE / M_PI));
+		}
+	}
+	t = Test_now() - t;
+	sink = acc;
+	printf("%-18s %6.1f ns/call\n", "asinf", t * 1e9 / ((double)BENCH_N * BENCH_PASSES));
+}
+
+static void Bench_isqrt(void)
+{
+	double t;
+	uint32_t acc = 0;
+	int p, i;
+
+	t = Test_now();
+	for(p = 0; p < BENCH_PASSES; p++)
+	{
+		for(i = 0; i < BENCH_N; i++)
+		{
+			acc += Isqrt(((uint32_t)(uint16_t)bx[i] << 16) | (uint16_t)by[i]);
+		}
+	}
+	t = Test_now() - t;
+	sink = acc;
+	printf("%-18s %6.1f ns/call\n", "Isqrt", t * 1e9 / ((double)BENCH_N * BENCH_PASSES));
+
+	t = Test_now();
+	for(p = 0; p < BENCH_PASSES; p++)
+	{
+		for(i = 0; i < BENCH_N; i++)
+		{
+			acc += (uint32_t)sqrtf((float)(((uint32_t)(uint16_t)bx[i] << 16) | (uint16_t)by[i]));
+		}
+	}
+	t = Test_now() - t;
+	sink = acc;
+	printf("%-18s %6.1f ns/call\n", "sqrtf", t * 1e9 / ((double)BENCH_N * BENCH_PASSES));
+}
+
+//Calc_angles() one sample at a time vs Calc_angles_block() over blocks of
+//every size from 1 to a full FIFO, same samples, ns per sample
+#define BLOCK_PASSES	8
+
+static void Bench_block(void)
+{
+	static int16_t pitch[MMA8451Q_FIFO_SIZE], roll[MMA8451Q_FIFO_SIZE];
+	static uint8_t dynamic[MMA8451Q_FIFO_SIZE];
+	MMA8451Q_DATA acc;
+	ANGLE_DATA ang;
+	double t, t_one, t_block;
+	int32_t acc_sum = 0;
+	int n, p, i, j, blocks;
+
+	printf("%-18s %9s %9s\n", "block size", "scalar", "block");
+	for(n = 1; n <= MMA8451Q_FIFO_SIZE; n++)
+	{
+		blocks = (BENCH_N - 2) / n;
+
+		t = Test_now();
+		for(p = 0; p < BLOCK_PASSES; p++)
+		{
+			for(i = 0; i < blocks * n; i++)
+			{
+				acc.x_data = bx[i];
+				acc.y_data = by[i];
+				acc.z_data = bx[i + 2];
+				Calc_angles(&acc, &ang, 4096);
+				acc_sum += ang.pitch + ang.roll + ang.dynamic;
+			}
+		}
+		t_one = Test_now() - t;
+
+		t = Test_now();
+		for(p = 0; p < BLOCK_PASSES; p++)
+		{
+			for(i = 0; i < blocks * n; i += n)
+			{
+				Calc_angles_block(&bx[i], &by[i], &bx[i + 2], pitch, roll, dynamic, 4096, n);
+				for(j = 0; j < n; j++)
+				{
+					acc_sum += pitch[j] + roll[j] + dynamic[j];
+				}
+			}
+		}
+		t_block = Test_now() - t;
+		sink = acc_sum;
+
+		printf("%-18d %9.1f %9.1f ns/sample\n", n, t_one * 1e9 / ((double)blocks * n * BLOCK_PASSES),
+			   t_block * 1e9 / ((double)blocks * n * BLOCK_PASSES));
+	}
+}
+
+int main(void)
+{
+	Bench_inputs();
+
+	Bench_atan2("Cordic_atan2", Cordic_atan2);
+	Bench_atan2("Lut_atan2", Lut_atan2);
+	Bench_atan2("atan2f/sqrtf", Libm_atan2);
+	Bench_asin();
+	Bench_isqrt();
+	Bench_block();
+
+	return(0);
+}
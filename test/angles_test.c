@@ -0,0 +1,378 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file angles_test.c
+* @brief Host test of the angle math
+*
+* Sweeps the int16 input plane against double precision math and checks
+* the error bounds documented in angles.h.  "make check" takes every
+* SWEEP_STEP'th point plus everything near the origin, where the errors
+* are largest; "make sweep" builds it with SWEEP_STEP=1 for the whole
+* plane.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include "angles.h"
+#include "test.h"
+
+#ifndef SWEEP_STEP
+#define SWEEP_STEP		13
+#endif
+#define SWEEP_NEAR		256				//|x|, |y| below this are always swept
+
+//Lut_atan2 bounds from angles.h, in LSB and counts
+#if ATAN_LUT_BITS == 4
+#define LUT_ATAN_ERR	2.7
+#elif ATAN_LUT_BITS == 5
+#define LUT_ATAN_ERR	1.4
+#elif ATAN_LUT_BITS == 6
+#define LUT_ATAN_ERR	1.1
+#else
+#define LUT_ATAN_ERR	1.0
+#endif
+#if ATAN_LUT_BITS >= 6
+#define LUT_MAG_ERR		2.5
+#else
+#define LUT_MAG_ERR		1e9				//no bound given
+#endif
+
+#define DEG(r)			((r) * (180.0 * ANGLE_SCALE / M_PI))
+
+typedef struct
+{
+	double err;							//worst angle error, ANGLE_SCALE units
+	double err_short;					//same for vectors under 16 counts
+	double mag_err;						//worst magnitude error, counts
+	int32_t wx, wy;						//where err was seen
+} SWEEP_RESULT;
+
+//error of one atan2 implementation at (x, y)
+static void Test_atan2_point(int32_t (*f)(int32_t, int32_t, uint32_t *), int32_t x, int32_t y, SWEEP_RESULT *r)
+{
+	uint32_t mag;
+	double ref, m, e;
+
+	if((x == 0) && (y == 0))
+	{
+		return;
+	}
+
+	ref = DEG(atan2(y, x));
+	e = fabs(f(y, x, &mag) - ref);
+	// +/-180 are the same angle
+	if(e > 180 * ANGLE_SCALE)
+	{
+		e = fabs(e - (360 * ANGLE_SCALE));
+	}
+
+	m = sqrt(((double)x * x) + ((double)y * y));
+	if(m < 16)
+	{
+		if(e > r->err_short)
+		{
+			r->err_short = e;
+		}
+	}
+	else if(e > r->err)
+	{
+		r->err = e;
+		r->wx = x;
+		r->wy = y;
+	}
+
+	e = fabs(mag - m);
+	if(e > r->mag_err)
+	{
+		r->mag_err = e;
+	}
+}
+
+static void Test_atan2_sweep(int32_t (*f)(int32_t, int32_t, uint32_t *), SWEEP_RESULT *r)
+{
+	int32_t x, y;
+
+	r->err = r->err_short = r->mag_err = 0;
+	r->wx = r->wy = 0;
+
+	for(x = -32768; x <= 32767; x += SWEEP_STEP)
+	{
+		for(y = -32768; y <= 32767; y += SWEEP_STEP)
+		{
+			Test_atan2_point(f, x, y, r);
+		}
+	}
+	for(x = -SWEEP_NEAR; x <= SWEEP_NEAR; x++)
+	{
+		for(y = -SWEEP_NEAR; y <= SWEEP_NEAR; y++)
+		{
+			Test_atan2_point(f, x, y, r);
+		}
+	}
+	// the edges of the plane
+	for(x = -32768; x <= 32767; x++)
+	{
+		Test_atan2_point(f, x, 32767, r);
+		Test_atan2_point(f, x, -32768, r);
+		Test_atan2_point(f, 32767, x, r);
+		Test_atan2_point(f, -32768, x, r);
+	}
+}
+
+static void Test_cordic(void)
+{
+	SWEEP_RESULT r;
+
+	Test_atan2_sweep(Cordic_atan2, &r);
+	printf("Cordic_atan2: %.3f LSB (%.3f under 16 counts), magnitude %.3f counts\n", r.err, r.err_short, r.mag_err);
+
+	// angles.h: under 1 LSB from 16 counts up, at most 2 below, magnitude under 2 counts
+	CHECK(r.err < 1.0, "Cordic_atan2 error %.3f at (%d, %d)", r.err, r.wx, r.wy);
+	CHECK(r.err_short <= 2.0, "Cordic_atan2 short vector error %.3f", r.err_short);
+	CHECK(r.mag_err < 2.0, "Cordic_atan2 magnitude error %.3f", r.mag_err);
+
+	// exact on the axes
+	CHECK(Cordic_atan2(0, 1000, 0) == 0, "atan2(0, 1000) %d", Cordic_atan2(0, 1000, 0));
+	CHECK(Cordic_atan2(1000, 0, 0) == 9000, "atan2(1000, 0) %d", Cordic_atan2(1000, 0, 0));
+	CHECK(Cordic_atan2(-1000, 0, 0) == -9000, "atan2(-1000, 0) %d", Cordic_atan2(-1000, 0, 0));
+	CHECK(abs(Cordic_atan2(0, -1000, 0)) == 18000, "atan2(0, -1000) %d", Cordic_atan2(0, -1000, 0));
+}
+
+static void Test_lut(void)
+{
+	SWEEP_RESULT r;
+
+	Test_atan2_sweep(Lut_atan2, &r);
+	printf("Lut_atan2 %d bits: %.3f LSB (%.3f under 16 counts), magnitude %.3f counts\n", ATAN_LUT_BITS, r.err, r.err_short, r.mag_err);
+
+	CHECK(r.err <= LUT_ATAN_ERR, "Lut_atan2 error %.3f at (%d, %d)", r.err, r.wx, r.wy);
+	CHECK(r.err_short <= LUT_ATAN_ERR, "Lut_atan2 short vector error %.3f", r.err_short);
+	CHECK(r.mag_err <= LUT_MAG_ERR, "Lut_atan2 magnitude error %.3f", r.mag_err);
+
+	CHECK(Lut_atan2(0, 1000, 0) == 0, "atan2(0, 1000) %d", Lut_atan2(0, 1000, 0));
+	CHECK(Lut_atan2(1000, 0, 0) == 9000, "atan2(1000, 0) %d", Lut_atan2(1000, 0, 0));
+	CHECK(Lut_atan2(1000, 1000, 0) == 4500, "atan2(1000, 1000) %d", Lut_atan2(1000, 1000, 0));
+	CHECK(abs(Lut_atan2(0, -1000, 0)) == 18000, "atan2(0, -1000) %d", Lut_atan2(0, -1000, 0));
+}
+
+static void Test_asin(void)
+{
+	double err = 0, err_end = 0, e;
+	int32_t s;
+
+	// every Q15 input
+	for(s = -32768; s <= 32768; s++)
+	{
+		e = fabs(Lut_asin(s) - DEG(asin(s / 32768.0)));
+		if(abs(s) < (int32_t)(0.9 * 32768))
+		{
+			if(e > err)
+			{
+				err = e;
+			}
+		}
+		else if(e > err_end)
+		{
+			err_end = e;
+		}
+	}
+	printf("Lut_asin %d bits: %.3f LSB below 0.9, %.3f LSB above\n", ATAN_LUT_BITS, err, err_end);
+
+#if ATAN_LUT_BITS == 6
+	// angles.h: 0.024 degree below 0.9, 2.6 degrees close to 1
+	CHECK(err <= 2.4, "Lut_asin error %.3f LSB below 0.9", err);
+	CHECK(err_end <= 260, "Lut_asin error %.3f LSB above 0.9", err_end);
+#endif
+	CHECK((Lut_asin(0) == 0) && (Lut_asin(32768) == 9000) && (Lut_asin(-32768) == -9000),
+		  "asin 0, 1, -1: %d %d %d", Lut_asin(0), Lut_asin(32768), Lut_asin(-32768));
+}
+
+//floor(sqrt(v)) is r exactly when r^2 <= v < (r + 1)^2
+static int Test_isqrt_ok(uint32_t v)
+{
+	uint64_t r = Isqrt(v);
+
+	return(((r * r) <= v) && (((r + 1) * (r + 1)) > v));
+}
+
+static void Test_isqrt(void)
+{
+	uint32_t v, r, bad = 0, where = 0;
+	int32_t d;
+
+	// every input below 2^24, all of them in a sweep build
+#if SWEEP_STEP == 1
+	v = 0;
+	do
+	{
+		if(!Test_isqrt_ok(v) && (bad++ == 0))
+		{
+			where = v;
+		}
+	} while(++v != 0);
+#else
+	for(v = 0; v < (1UL << 24); v++)
+	{
+		if(!Test_isqrt_ok(v) && (bad++ == 0))
+		{
+			where = v;
+		}
+	}
+#endif
+	CHECK(bad == 0, "Isqrt wrong for %u inputs, first %u -> %u", bad, where, Isqrt(where));
+
+	// every perfect square and its neighbours, up to the top of the range
+	bad = 0;
+	for(r = 1; r <= 65535; r++)
+	{
+		for(d = -1; d <= 1; d++)
+		{
+			v = (r * r) + d;
+			if(!Test_isqrt_ok(v) && (bad++ == 0))
+			{
+				where = v;
+			}
+		}
+	}
+	CHECK(bad == 0, "Isqrt wrong next to %u squares, first %u -> %u", bad, where, Isqrt(where));
+	CHECK(Isqrt(0xFFFFFFFFUL) == 65535, "Isqrt(2^32 - 1) %u", Isqrt(0xFFFFFFFFUL));
+}
+
+//Vec_mag() is floor(|a|), the dynamic flag 1g +/- 1g >> ANGLE_DYN_SHIFT
+static void Test_mag(void)
+{
+	static const uint16_t one_g[] = {16384, 8192, 4096};
+	MMA8451Q_DATA acc;
+	ANGLE_DATA ang;
+	uint32_t seed = 7, bad = 0;
+	int16_t x, y, z;
+	double m;
+	unsigned g;
+	int i;
+	int32_t d, tol;
+
+	for(i = 0; i < 1000000; i++)
+	{
+		seed = (seed * 1664525) + 1013904223;
+		x = (int16_t)(seed >> 16);
+		seed = (seed * 1664525) + 1013904223;
+		y = (int16_t)(seed >> 16);
+		seed = (seed * 1664525) + 1013904223;
+		z = (int16_t)(seed >> 16);
+		m = sqrt(((double)x * x) + ((double)y * y) + ((double)z * z));
+		if(Vec_mag(x, y, z) != (uint32_t)floor(m))
+		{
+			bad++;
+		}
+	}
+	CHECK(bad == 0, "Vec_mag off floor(|a|) for %u of 1000000 vectors", bad);
+	CHECK(Vec_mag(-32768, -32768, -32768) == 56755, "Vec_mag full scale %u", Vec_mag(-32768, -32768, -32768));
+
+	// straight down one axis, so the backends' magnitude is exact
+	for(g = 0; g < sizeof(one_g) / sizeof(one_g[0]); g++)
+	{
+		tol = one_g[g] >> ANGLE_DYN_SHIFT;
+		acc.x_data = acc.y_data = 0;
+		for(d = -tol - 2; d <= tol + 2; d++)
+		{
+			acc.z_data = one_g[g] + d;
+			Calc_angles(&acc, &ang, one_g[g]);
+			CHECK(ang.dynamic == (abs(d) > tol), "1g %u, |a| %d: dynamic %d", one_g[g], acc.z_data, ang.dynamic);
+		}
+		acc.z_data = 0;
+		acc.x_data = one_g[g];
+		Calc_angles(&acc, &ang, one_g[g]);
+		CHECK(!ang.dynamic && (ang.mag == one_g[g]), "1g %u on x: mag %u, dynamic %d", one_g[g], ang.mag, ang.dynamic);
+	}
+}
+
+//Calc_angles_block() against Calc_angles() one sample at a time
+static void Test_block(void)
+{
+	static const uint16_t sizes[] = {0, 1, 2, 3, 4, 5, 6, 7, 32, 33};
+	static const uint16_t one_g[] = {16384, 8192, 4096};
+	int16_t x[33], y[33], z[33], pitch[34], roll[34];
+	uint8_t dynamic[34];
+	MMA8451Q_DATA acc;
+	ANGLE_DATA ang;
+	uint32_t seed = 1;
+	unsigned g, k, i, bad;
+
+	for(g = 0; g < sizeof(one_g) / sizeof(one_g[0]); g++)
+	{
+		for(k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++)
+		{
+			// half the samples near 1g so both dynamic states show up
+			for(i = 0; i < sizes[k]; i++)
+			{
+				seed = (seed * 1664525) + 1013904223;
+				x[i] = (int16_t)(seed >> 16);
+				seed = (seed * 1664525) + 1013904223;
+				y[i] = (int16_t)(seed >> 16);
+				seed = (seed * 1664525) + 1013904223;
+				z[i] = (int16_t)(seed >> 16);
+				if(i & 1)
+				{
+					x[i] >>= 5;
+					y[i] >>= 5;
+					z[i] = one_g[g] + (z[i] >> 7);
+				}
+			}
+			// one past the end must not be written
+			pitch[sizes[k]] = roll[sizes[k]] = 0x5555;
+			dynamic[sizes[k]] = 0x55;
+
+			Calc_angles_block(x, y, z, pitch, roll, dynamic, one_g[g], sizes[k]);
+
+			bad = 0;
+			for(i = 0; i < sizes[k]; i++)
+			{
+				acc.x_data = x[i];
+				acc.y_data = y[i];
+				acc.z_data = z[i];
+				Calc_angles(&acc, &ang, one_g[g]);
+				if((pitch[i] != ang.pitch) || (roll[i] != ang.roll) || (dynamic[i] != ang.dynamic))
+				{
+					bad++;
+				}
+			}
+			CHECK(bad == 0, "Calc_angles_block 1g %u, n %u: %u samples differ", one_g[g], sizes[k], bad);
+			CHECK((pitch[sizes[k]] == 0x5555) && (roll[sizes[k]] == 0x5555) && (dynamic[sizes[k]] == 0x55),
+				  "Calc_angles_block 1g %u, n %u wrote past the end", one_g[g], sizes[k]);
+
+			// the flags are optional, 0x5555 is out of range for an angle
+			if(sizes[k] != 0)
+			{
+				i = sizes[k] - 1;
+				roll[i] = 0x5555;
+				Calc_angles_block(x, y, z, pitch, roll, 0, one_g[g], sizes[k]);
+				CHECK(roll[i] == ang.roll, "Calc_angles_block 1g %u, n %u without flags: roll %d, %d", one_g[g], sizes[k], roll[i], ang.roll);
+			}
+		}
+	}
+}
+
+int main(void)
+{
+	Test_cordic();
+	Test_lut();
+	Test_asin();
+	Test_isqrt();
+	Test_mag();
+	Test_block();
+
+	return(TEST_DONE());
+}
@@ -0,0 +1,177 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file calib_test.c
+* @brief Host test of the calibration
+*
+* A synthetic sensor with a few percent of gain and cross axis error and
+* an offset is captured in the six orientations, solved, and the
+* corrected samples are checked against the truth.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calib.h"
+#include "test.h"
+
+#define ONE_G		4096
+#define SAMPLES		100000
+
+//sensitivity: 3% gain error on x, -2% on z, 2% and smaller cross terms
+static const double sens[3][3] =
+{
+	{ 1.03, 0.02, -0.01 },
+	{ -0.015, 1.00, 0.02 },
+	{ 0.01, -0.005, 0.98 }
+};
+static const double offset[3] = { 57, -120, 33 };
+
+static uint32_t seed = 1;
+
+static int32_t Test_rand(int32_t range)
+{
+	seed = (seed * 1664525) + 1013904223;
+	return((int32_t)((seed >> 8) % (2 * range + 1)) - range);
+}
+
+//what the synthetic sensor reads for true acceleration a
+static void Test_sensor(const double s[3][3], const double a[3], MMA8451Q_DATA *m)
+{
+	m->x_data = lrint((s[0][0] * a[0]) + (s[0][1] * a[1]) + (s[0][2] * a[2]) + offset[0]);
+	m->y_data = lrint((s[1][0] * a[0]) + (s[1][1] * a[1]) + (s[1][2] * a[2]) + offset[1]);
+	m->z_data = lrint((s[2][0] * a[0]) + (s[2][1] * a[1]) + (s[2][2] * a[2]) + offset[2]);
+}
+
+//six captures, axis j up then down
+static void Test_capture(const double s[3][3], MMA8451Q_DATA cap[CALIB_ORIENTATIONS])
+{
+	double a[3];
+	int j;
+
+	for(j = 0; j < 6; j++)
+	{
+		a[0] = a[1] = a[2] = 0;
+		a[j / 2] = (j & 1) ? -ONE_G : ONE_G;
+		Test_sensor(s, a, &cap[j]);
+	}
+}
+
+static void Test_solve(void)
+{
+	MMA8451Q_DATA cap[CALIB_ORIENTATIONS];
+	MMA8451Q_DATA m, b;
+	CALIB_PARAM p;
+	double a[3], e, err = 0;
+	int16_t x[1], y[1], z[1];
+	int i;
+
+	Test_capture(sens, cap);
+	CHECK(Calib_solve(&p, cap, ONE_G) == 0, "Calib_solve failed");
+
+	// anywhere within +/-2g
+	for(i = 0; i < SAMPLES; i++)
+	{
+		a[0] = Test_rand(2 * ONE_G);
+		a[1] = Test_rand(2 * ONE_G);
+		a[2] = Test_rand(2 * ONE_G);
+		Test_sensor(sens, a, &m);
+		b = m;
+		Calib_sample(&p, &m);
+
+		e = fmax(fmax(fabs(m.x_data - a[0]), fabs(m.y_data - a[1])), fabs(m.z_data - a[2]));
+		if(e > err)
+		{
+			err = e;
+		}
+
+		// the block path does the same
+		x[0] = b.x_data;
+		y[0] = b.y_data;
+		z[0] = b.z_data;
+		Calib_block(&p, x, y, z, 1);
+		CHECK((x[0] == m.x_data) && (y[0] == m.y_data) && (z[0] == m.z_data), "Calib_block differs from Calib_sample");
+	}
+	printf("Calib: worst error %.0f counts over +/-2g\n", err);
+
+	// a count of rounding in the capture, the correction and the sensor model
+	CHECK(err <= 2, "calibrated error %.0f counts", err);
+}
+
+static void Test_identity(void)
+{
+	CALIB_PARAM p = CALIB_IDENTITY;
+	MMA8451Q_DATA m, b;
+	int i;
+
+	for(i = 0; i < SAMPLES; i++)
+	{
+		m.x_data = Test_rand(32767);
+		m.y_data = Test_rand(32767);
+		m.z_data = Test_rand(32767);
+		b = m;
+		Calib_sample(&p, &m);
+		CHECK(memcmp(&b, &m, sizeof(m)) == 0, "identity changed a sample");
+	}
+
+	// offsets saturate rather than wrap
+	p.off[0] = -100;
+	p.off[1] = 100;
+	m.x_data = 32700;
+	m.y_data = -32700;
+	m.z_data = 0;
+	Calib_sample(&p, &m);
+	CHECK((m.x_data == INT16_MAX) && (m.y_data == INT16_MIN), "saturation %d %d", m.x_data, m.y_data);
+}
+
+static void Test_reject(void)
+{
+	MMA8451Q_DATA cap[CALIB_ORIENTATIONS];
+	double s[3][3];
+	CALIB_PARAM p;
+
+	// dead z axis
+	memcpy(s, sens, sizeof(s));
+	s[2][2] = 0;
+	Test_capture(s, cap);
+	CHECK(Calib_solve(&p, cap, ONE_G) != 0, "dead axis accepted");
+
+	// x and y captures swapped
+	memcpy(s, sens, sizeof(s));
+	s[0][0] = sens[0][1];
+	s[0][1] = sens[0][0];
+	s[1][0] = sens[1][1];
+	s[1][1] = sens[1][0];
+	Test_capture(s, cap);
+	CHECK(Calib_solve(&p, cap, ONE_G) != 0, "swapped axes accepted");
+
+	// a 50% gain error is more than a correction term can hold
+	memcpy(s, sens, sizeof(s));
+	s[1][1] = 1.5;
+	Test_capture(s, cap);
+	CHECK(Calib_solve(&p, cap, ONE_G) != 0, "50%% gain error accepted");
+
+	CHECK(Calib_solve(&p, cap, 0) != 0, "1g of 0 accepted");
+}
+
+int main(void)
+{
+	Test_solve();
+	Test_identity();
+	Test_reject();
+
+	return(TEST_DONE());
+}
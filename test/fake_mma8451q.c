@@ -0,0 +1,749 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file fake_mma8451q.c
+* @brief Register level fake of I2C0 and an MMA8451Q on the bus
+*
+* The driver only ever touches the registers, so the fake looks at them
+* between driver calls and does what the hardware would have done in the
+* meantime.  The interrupt flags are write one to clear on the part; here
+* they are set when the driver is due to look at them and wiped once it
+* has.  Each bus event also adds its bit times to fake.ns, so a test can
+* tell how long a transfer held the bus and how long the bus sat idle.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <string.h>
+#include "fake_mma8451q.h"
+#include "timer.h"
+
+NVIC_Type fake_nvic;
+SIM_Type fake_sim;
+PORT_Type fake_porta;
+PORT_Type fake_porte;
+I2C_Type fake_i2c0;
+GPIO_Type fake_gpioa;
+GPIO_Type fake_gpioe;
+
+FAKE fake;
+
+#define FAKE_SCL		(1UL << 24)
+#define FAKE_SDA		(1UL << 25)
+#define FAKE_INT_PINS	((1UL << MMA8451Q_INT1_PIN) | (1UL << MMA8451Q_INT2_PIN))
+
+#define FAKE_IRQ_BYTE	0x01
+#define FAKE_IRQ_STOP	0x02
+#define FAKE_IRQ_ARBL	0x04
+
+#define STATUS_ZYXOW		0x80
+#define F_SETUP_F_MODE_MASK	0xC0
+
+enum
+{
+	PH_IDLE = 0,
+	PH_ADDR,
+	PH_REG,
+	PH_WRITE,
+	PH_READ,
+	PH_NACK
+};
+
+static uint8_t Fake_fifo_mode(void)
+{
+	return(fake.reg[F_SETUP] & F_SETUP_F_MODE_MASK);
+}
+
+static uint8_t Fake_status(void)
+{
+	uint8_t wmrk = fake.reg[F_SETUP] & F_SETUP_F_WMRK_MASK;
+	uint8_t s;
+
+	if(!Fake_fifo_mode())
+	{
+		return(fake.reg[STATUS]);
+	}
+
+	// STATUS reads as F_STATUS in FIFO mode
+	s = fake.f_cnt;
+	if(fake.f_ovf)
+	{
+		s |= F_STATUS_F_OVF;
+	}
+	if((wmrk != 0) && (fake.f_cnt >= wmrk))
+	{
+		s |= F_STATUS_F_WMRK_FLAG;
+	}
+
+	return(s);
+}
+
+static uint8_t Fake_out_byte(const int16_t *v, uint8_t r)
+{
+	uint8_t i = r - OUT_X_MSB;
+
+	// 14 bit left justified, MSB first
+	if(i & 1)
+	{
+		return((uint8_t)(v[i / 2] & 0xFC));
+	}
+
+	return((uint8_t)((uint16_t)v[i / 2] >> 8));
+}
+
+static uint8_t Fake_mma_read(void)
+{
+	uint8_t r = fake.ptr;
+	uint8_t b;
+
+	if(r == STATUS)
+	{
+		b = Fake_status();
+		fake.f_ovf = 0;
+		fake.ptr = OUT_X_MSB;
+		return(b);
+	}
+
+	if(r > OUT_Z_LSB)
+	{
+		b = (r <= OFF_Z) ? fake.reg[r] : 0;
+		fake.ptr++;
+		return(b);
+	}
+
+	if(Fake_fifo_mode())
+	{
+		if(fake.f_cnt == 0)
+		{
+			fake.underruns++;
+			b = 0;
+		}
+		else
+		{
+			b = Fake_out_byte(fake.fifo[fake.f_head], r);
+		}
+
+		// reading OUT_Z_LSB pops the sample and wraps back to OUT_X_MSB
+		if(r == OUT_Z_LSB)
+		{
+			if(fake.f_cnt != 0)
+			{
+				fake.f_head = (fake.f_head + 1) % MMA8451Q_FIFO_SIZE;
+				fake.f_cnt--;
+			}
+			fake.ptr = OUT_X_MSB;
+		}
+		else
+		{
+			fake.ptr++;
+		}
+		return(b);
+	}
+
+	b = Fake_out_byte(fake.out, r);
+
+	// reading the last MSB clears the data ready flags
+	if(r == OUT_Z_MSB)
+	{
+		fake.reg[STATUS] = 0;
+	}
+
+	if(fake.reg[CTRL_REG1] & CTRL_REG1_F_READ)
+	{
+		fake.ptr = (r >= OUT_Z_MSB) ? STATUS : (r + 2);
+	}
+	else
+	{
+		fake.ptr = (r >= OUT_Z_LSB) ? STATUS : (r + 1);
+	}
+
+	return(b);
+}
+
+static void Fake_mma_write(uint8_t b)
+{
+	uint8_t r = fake.ptr++;
+
+	if((r <= OUT_Z_LSB) || (r > OFF_Z))
+	{
+		// read only or not modelled
+		return;
+	}
+
+	if(r == CTRL_REG1)
+	{
+		fake.reg[r] = b;
+		return;
+	}
+
+	// everything else only takes a write in STANDBY
+	if(fake.reg[CTRL_REG1] & CTRL_REG1_ACTIVE)
+	{
+		fake.violations++;
+		return;
+	}
+
+	if(r == F_SETUP)
+	{
+		// F_MODE has to go through 00 to change mode
+		if(Fake_fifo_mode() && (b & F_SETUP_F_MODE_MASK) &&
+		   ((b & F_SETUP_F_MODE_MASK) != Fake_fifo_mode()))
+		{
+			fake.violations++;
+			return;
+		}
+		if((b & F_SETUP_F_MODE_MASK) == 0)
+		{
+			fake.f_head = 0;
+			fake.f_cnt = 0;
+			fake.f_ovf = 0;
+		}
+	}
+
+	fake.reg[r] = b;
+}
+
+void Fake_sample(int16_t x, int16_t y, int16_t z)
+{
+	int32_t one_g = MMA8451Q_ONE_G >> (fake.reg[XYZ_DATA_CFG] & XYZ_DATA_CFG_FS_MASK);
+	int16_t in[3];
+	int16_t v[3];
+	int32_t a;
+	uint8_t i;
+
+	if(!(fake.reg[CTRL_REG1] & CTRL_REG1_ACTIVE))
+	{
+		return;
+	}
+
+	in[0] = x;
+	in[1] = y;
+	in[2] = z;
+	for(i = 0; i < 3; i++)
+	{
+		// OFF_X/Y/Z are 2mg per LSB at every range
+		a = in[i] + fake.bias[i] +
+			(((int32_t)(int8_t)fake.reg[OFF_X + i] * one_g * MMA8451Q_OFF_MG_PER_LSB) / 1000);
+		if(a > INT16_MAX)
+		{
+			a = INT16_MAX;
+		}
+		else if(a < INT16_MIN)
+		{
+			a = INT16_MIN;
+		}
+		v[i] = (int16_t)(a & ~3);
+	}
+	fake.samples++;
+
+	if(Fake_fifo_mode())
+	{
+		// circular mode, a full FIFO drops its oldest sample
+		if(fake.f_cnt == MMA8451Q_FIFO_SIZE)
+		{
+			fake.f_head = (fake.f_head + 1) % MMA8451Q_FIFO_SIZE;
+			fake.f_cnt--;
+			fake.f_ovf = 1;
+		}
+		memcpy(fake.fifo[(fake.f_head + fake.f_cnt) % MMA8451Q_FIFO_SIZE], v, sizeof(v));
+		fake.f_cnt++;
+	}
+	else
+	{
+		memcpy(fake.out, v, sizeof(v));
+		if(fake.reg[STATUS] & STATUS_ZYXDR)
+		{
+			fake.reg[STATUS] |= STATUS_ZYXOW;
+		}
+		fake.reg[STATUS] |= STATUS_ZYXDR | 0x07;
+	}
+}
+
+static FAKE_XFER *Fake_xfer(void)
+{
+	return(&fake.log[(fake.log_n - 1) % FAKE_LOG_SIZE]);
+}
+
+static void Fake_address(uint8_t b)
+{
+	FAKE_XFER *x;
+
+	// a read straight after the register address is the same transfer
+	if((b & 1) && fake.reg_set && (fake.log_n != 0))
+	{
+		x = Fake_xfer();
+		x->rw = 1;
+	}
+	else
+	{
+		x = &fake.log[fake.log_n++ % FAKE_LOG_SIZE];
+		memset(x, 0, sizeof(FAKE_XFER));
+		x->addr = b >> 1;
+		x->rw = b & 1;
+		x->reg = fake.ptr;
+	}
+	fake.reg_set = 0;
+
+	if(fake.absent || ((b >> 1) != MMA8451Q_ADDR))
+	{
+		x->nack = 1;
+		I2C0->S |= I2C_S_RXAK_MASK;
+		fake.phase = PH_NACK;
+		return;
+	}
+
+	I2C0->S &= ~I2C_S_RXAK_MASK;
+	fake.phase = (b & 1) ? PH_READ : PH_REG;
+}
+
+static void Fake_byte(uint8_t b)
+{
+	FAKE_XFER *x;
+
+	switch(fake.phase)
+	{
+	case PH_ADDR:
+		Fake_address(b);
+		break;
+	case PH_REG:
+		fake.ptr = b;
+		Fake_xfer()->reg = b;
+		fake.reg_set = 1;
+		fake.phase = PH_WRITE;
+		break;
+	case PH_WRITE:
+		x = Fake_xfer();
+		if((x->reg == fake.nack_reg) && (x->len == 0) && fake.nack_skip)
+		{
+			fake.nack_skip--;
+		}
+		else if((x->reg == fake.nack_reg) && (x->len == 0) && fake.nack_writes)
+		{
+			// the data byte isn't acknowledged and the register keeps its value
+			fake.nack_writes--;
+			I2C0->S |= I2C_S_RXAK_MASK;
+			fake.phase = PH_NACK;
+			break;
+		}
+		if(x->len < sizeof(x->data))
+		{
+			x->data[x->len] = b;
+		}
+		x->len++;
+		Fake_mma_write(b);
+		break;
+	default:
+		// nobody is listening
+		I2C0->S |= I2C_S_RXAK_MASK;
+		break;
+	}
+}
+
+static void Fake_deliver(void)
+{
+	FAKE_XFER *x = Fake_xfer();
+	uint8_t b = Fake_mma_read();
+
+	if(x->len < sizeof(x->data))
+	{
+		x->data[x->len] = b;
+	}
+	x->len++;
+
+	// TXAK applies to the byte being received
+	fake.rx_ack = !(I2C0->C1 & I2C_C1_TXAK_MASK);
+
+	// outside the 0..0xFF the driver writes, so it isn't sent back out
+	I2C0->D = 0x200 | b;
+}
+
+static uint8_t Fake_stall(void)
+{
+	if(fake.stalled)
+	{
+		return 1;
+	}
+
+	// the slave stops answering part way through the transfer
+	if((fake.stall_after != 0) && (--fake.stall_after == 0))
+	{
+		fake.stalled = 1;
+		return 1;
+	}
+
+	return 0;
+}
+
+static void Fake_time(uint32_t bits)
+{
+	fake.ns += (uint64_t)bits * FAKE_BIT_NS;
+	fake.bus_ns += (uint64_t)bits * FAKE_BIT_NS;
+}
+
+static void Fake_bus(void)
+{
+	uint8_t c1 = I2C0->C1;
+	uint8_t serviced = fake.serviced;
+	uint64_t gap;
+	uint8_t b;
+
+	// nothing moves until the driver has answered the last flags, and
+	// whatever it wrote to clear them reads back as set here.  TCF is
+	// left alone, every byte is done by the time the driver looks.
+	if(fake.pending)
+	{
+		return;
+	}
+	fake.serviced = 0;
+	I2C0->S &= ~(I2C_S_IICIF_MASK | I2C_S_ARBL_MASK);
+	I2C0->FLT &= ~I2C_FLT_STOPF_MASK;
+
+	if(fake.gpio || !(c1 & I2C_C1_IICEN_MASK))
+	{
+		fake.last_c1 = c1;
+		return;
+	}
+
+	// START
+	if((c1 & I2C_C1_MST_MASK) && !(fake.last_c1 & I2C_C1_MST_MASK))
+	{
+		if(fake.busy || fake.hold_clocks)
+		{
+			// somebody else has the bus, the hardware drops MST
+			c1 &= ~I2C_C1_MST_MASK;
+			I2C0->C1 = c1;
+			I2C0->D = FAKE_D_NONE;
+			fake.arbl++;
+			fake.irq |= FAKE_IRQ_ARBL;
+		}
+		else
+		{
+			fake.busy = 1;
+			fake.phase = PH_ADDR;
+			fake.reg_set = 0;
+			if(fake.t_stop != 0)
+			{
+				gap = fake.ns - fake.t_stop;
+				fake.gap_ns += gap;
+				if(gap > fake.gap_max_ns)
+				{
+					fake.gap_max_ns = gap;
+				}
+				fake.gaps++;
+			}
+			Fake_time(1);
+		}
+	}
+
+	// repeated START
+	if((c1 & I2C_C1_MST_MASK) && (c1 & I2C_C1_RSTA_MASK))
+	{
+		c1 &= ~I2C_C1_RSTA_MASK;
+		I2C0->C1 = c1;
+		fake.phase = PH_ADDR;
+		Fake_time(1);
+	}
+
+	if(c1 & I2C_C1_MST_MASK)
+	{
+		if((c1 & I2C_C1_TX_MASK) && (I2C0->D < FAKE_D_NONE))
+		{
+			// a byte to send
+			if(!Fake_stall())
+			{
+				b = (uint8_t)I2C0->D;
+				I2C0->D = FAKE_D_NONE;
+				Fake_byte(b);
+				Fake_time(9);
+				fake.irq |= FAKE_IRQ_BYTE;
+			}
+		}
+		else if(!(c1 & I2C_C1_TX_MASK) && serviced && (fake.phase == PH_READ))
+		{
+			// the driver read D in receive mode, which clocks in the next byte
+			if(!Fake_stall())
+			{
+				Fake_deliver();
+				Fake_time(9);
+				fake.irq |= FAKE_IRQ_BYTE;
+			}
+		}
+	}
+
+	// STOP, unless the slave is stretching SCL
+	if(!(c1 & I2C_C1_MST_MASK) && (fake.last_c1 & I2C_C1_MST_MASK) && !fake.stalled)
+	{
+		if((fake.phase == PH_READ) && fake.rx_ack)
+		{
+			fake.acked_last++;
+		}
+		fake.busy = 0;
+		fake.phase = PH_IDLE;
+		fake.reg_set = 0;
+		fake.rx_ack = 0;
+		Fake_time(1);
+		fake.t_stop = fake.ns;
+		// STOPF only interrupts with STOPIE set
+		if(fake.drop_stop)
+		{
+			fake.drop_stop = 0;
+		}
+		else if(I2C0->FLT & I2C_FLT_STOPIE(1))
+		{
+			fake.irq |= FAKE_IRQ_STOP;
+		}
+	}
+
+	fake.last_c1 = c1;
+
+	if(fake.busy || fake.hold_clocks)
+	{
+		I2C0->S |= I2C_S_BUSY_MASK;
+	}
+	else
+	{
+		I2C0->S &= ~I2C_S_BUSY_MASK;
+	}
+}
+
+static void Fake_nvic(void)
+{
+	// ISER and ICER are write one to set and write one to clear
+	fake.irq_en &= ~NVIC->ICER[0];
+	fake.irq_en |= NVIC->ISER[0];
+	NVIC->ICER[0] = 0;
+	NVIC->ISER[0] = 0;
+}
+
+static void Fake_irq(void)
+{
+	if(!fake.irq)
+	{
+		return;
+	}
+
+	I2C0->S |= I2C_S_IICIF_MASK | I2C_S_TCF_MASK;
+	if(fake.irq & FAKE_IRQ_ARBL)
+	{
+		I2C0->S |= I2C_S_ARBL_MASK;
+	}
+	if(fake.irq & FAKE_IRQ_STOP)
+	{
+		I2C0->FLT |= I2C_FLT_STOPF_MASK;
+	}
+	fake.irq = 0;
+	fake.pending = 1;
+}
+
+static void Fake_serviced(void)
+{
+	fake.pending = 0;
+	fake.serviced = 1;
+}
+
+void Fake_run(I2C_Queue *q)
+{
+	uint16_t i;
+
+	Fake_nvic();
+	for(i = 0; i < 4096; i++)
+	{
+		Fake_bus();
+		Fake_irq();
+		if(!fake.pending || !(fake.irq_en & (1UL << I2C0_IRQn)))
+		{
+			break;
+		}
+
+		// I2C0_DriverIRQHandler()
+		Run_I2C_Master(q);
+		Fake_serviced();
+	}
+}
+
+void Fake_poll(I2C_Queue *q)
+{
+	Fake_nvic();
+	Fake_bus();
+	Fake_irq();
+	if(fake.pending)
+	{
+		Fake_serviced();
+	}
+	I2C_POLL(q);
+}
+
+static void Fake_pins_e(void)
+{
+	uint8_t scl;
+	uint8_t sda;
+
+	if((PORTE->PCR[24] & PORT_PCR_MUX_MASK) != PORT_PCR_MUX(1))
+	{
+		fake.gpio = 0;
+		return;
+	}
+
+	if(!fake.gpio)
+	{
+		// the pins were taken away from I2C0 part way through whatever it
+		// was doing, and a stretching slave gives up once SCL is clocked
+		fake.gpio = 1;
+		fake.phase = PH_IDLE;
+		fake.reg_set = 0;
+		fake.irq = 0;
+		fake.pending = 0;
+		I2C0->S &= ~(I2C_S_IICIF_MASK | I2C_S_ARBL_MASK);
+		I2C0->FLT &= ~I2C_FLT_STOPF_MASK;
+		fake.stalled = 0;
+		fake.stall_after = 0;
+		fake.last_c1 = 0;
+		fake.clocks = 0;
+		fake.scl = 1;
+		fake.sda = (fake.hold_clocks == 0);
+	}
+
+	// open drain, an output drives the latch which is left low
+	scl = !(GPIOE->PDDR & FAKE_SCL);
+	if(scl && !fake.scl)
+	{
+		fake.clocks++;
+		if(fake.hold_clocks && (fake.clocks >= fake.hold_clocks))
+		{
+			fake.hold_clocks = 0;
+		}
+	}
+	sda = !(GPIOE->PDDR & FAKE_SDA) && (fake.hold_clocks == 0);
+
+	// SDA going high while SCL is high is a STOP
+	if(scl && fake.scl && sda && !fake.sda)
+	{
+		fake.stops++;
+		fake.busy = 0;
+	}
+
+	fake.scl = scl;
+	fake.sda = sda;
+	GPIOE->PDIR = (scl ? FAKE_SCL : 0) | (sda ? FAKE_SDA : 0);
+}
+
+static void Fake_pins_a(void)
+{
+	uint8_t src = 0;
+	uint8_t wmrk = fake.reg[F_SETUP] & F_SETUP_F_WMRK_MASK;
+	uint32_t low = 0;
+	uint8_t pin;
+
+	if(!Fake_fifo_mode() && (fake.reg[STATUS] & STATUS_ZYXDR))
+	{
+		src |= CTRL_REG4_INT_EN_DRDY;
+	}
+	if(Fake_fifo_mode() && (wmrk != 0) && (fake.f_cnt >= wmrk))
+	{
+		src |= CTRL_REG4_INT_EN_FIFO;
+	}
+	src &= fake.reg[CTRL_REG4];
+
+	// active low, CTRL_REG5 routes a source to INT1, otherwise INT2
+	if(src & fake.reg[CTRL_REG5])
+	{
+		low |= 1UL << MMA8451Q_INT1_PIN;
+	}
+	if(src & ~fake.reg[CTRL_REG5])
+	{
+		low |= 1UL << MMA8451Q_INT2_PIN;
+	}
+	GPIOA->PDIR = FAKE_INT_PINS & ~low;
+
+	for(pin = MMA8451Q_INT1_PIN; pin <= MMA8451Q_INT2_PIN; pin++)
+	{
+		// ISF is write one to clear
+		if(PORTA->PCR[pin] & PORT_PCR_ISF_MASK)
+		{
+			PORTA->PCR[pin] &= ~PORT_PCR_ISF_MASK;
+			PORTA->ISFR &= ~(1UL << pin);
+		}
+		// IRQC = 1000 - flag while the pin is low
+		if(((PORTA->PCR[pin] & PORT_PCR_IRQC_MASK) == PORT_PCR_IRQC(8)) && (low & (1UL << pin)))
+		{
+			PORTA->ISFR |= 1UL << pin;
+		}
+	}
+}
+
+void Fake_int(MMA8451Q *m, I2C_Queue *q)
+{
+	uint8_t i;
+
+	Fake_nvic();
+	for(i = 0; i < 8; i++)
+	{
+		Fake_pins_a();
+		if(!(PORTA->ISFR & FAKE_INT_PINS) || !(fake.irq_en & (1UL << PORTA_IRQn)))
+		{
+			break;
+		}
+
+		// PORTA_DriverIRQHandler(), the read it queues takes a while, so
+		// a pin that stays armed fires again straight away
+		MMA8451Q_INT_ISR(m, q);
+	}
+}
+
+void Fake_loop(MMA8451Q *m, I2C_Queue *q)
+{
+	Update_MMA8451Q(m, q);
+	Fake_run(q);
+	Fake_int(m, q);
+	I2C_Service(q);
+	Fake_run(q);
+	Check_I2C_Callback(q);
+	Fake_int(m, q);
+}
+
+void Fake_reset(void)
+{
+	memset(&fake, 0, sizeof(fake));
+	memset(&fake_nvic, 0, sizeof(fake_nvic));
+	memset(&fake_sim, 0, sizeof(fake_sim));
+	memset(&fake_porta, 0, sizeof(fake_porta));
+	memset(&fake_porte, 0, sizeof(fake_porte));
+	memset(&fake_gpioa, 0, sizeof(fake_gpioa));
+	memset(&fake_gpioe, 0, sizeof(fake_gpioe));
+	memset(&fake_i2c0, 0, sizeof(fake_i2c0));
+
+	fake.reg[WHO_AM_I] = 0x1A;
+	fake.scl = 1;
+	fake.sda = 1;
+	I2C0->S = I2C_S_TCF_MASK;
+	I2C0->D = FAKE_D_NONE;
+	GPIOA->PDIR = FAKE_INT_PINS;
+	GPIOE->PDIR = FAKE_SCL | FAKE_SDA;
+}
+
+void Timer_init()
+{
+}
+
+uint32_t Timer_us()
+{
+	// the recovery delays spin on this, so it is where the pins get watched
+	Fake_pins_e();
+	return(fake.us++);
+}
+
+uint32_t Timer_ms()
+{
+	return(fake.us / 1000);
+}
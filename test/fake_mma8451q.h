@@ -0,0 +1,182 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file fake_mma8451q.h
+* @brief Register level fake of I2C0 and an MMA8451Q on the bus
+*
+* Stands in for the peripherals behind i2c.c and MMA8451Q.c on the host.
+* The I2C0 registers are watched the way the hardware would see them:
+* MST going high is a START, a byte written to D goes out on the bus,
+* reading D in receive mode clocks in the next byte.  The slave at
+* MMA8451Q_ADDR answers with a model of the sensor registers, FIFO and
+* INT pins.  Timer_us() is faked too and watches PTE24/25 while they are
+* GPIO, so I2C_Bus_Recover() can be checked clock by clock.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#ifndef FAKE_MMA8451Q_H_
+#define FAKE_MMA8451Q_H_
+
+#include <stdint.h>
+#include "MKL25Z4.h"
+#include "i2c.h"
+#include "MMA8451Q.h"
+
+#define FAKE_LOG_SIZE		1024
+#define FAKE_D_NONE			0x100		//nothing written to D since the last byte
+
+//SCL from I2C_init(): 24MHz bus clock / 64 (ICR 0x12), in ns per bit.  A
+//byte and its ACK take 9 bits, START, repeated START and STOP one each.
+#define FAKE_BIT_NS			2667
+
+/**
+* define one transaction as the slave saw it.  A register read (write
+* the register address, repeated START, read) is one entry.
+*/
+typedef struct _FAKE_XFER_
+{
+	uint8_t addr;				//7-bit slave address
+	uint8_t rw;					//1 - read
+	uint8_t nack;				//1 - the address was not acknowledged
+	uint8_t reg;				//register the transfer started at
+	uint16_t len;				//data bytes after the register address
+	uint8_t data[8];			//the first data bytes, either way
+} FAKE_XFER;
+
+/**
+* define the state of the fake.  The fault fields are set by the test,
+* the counters are there to be checked.
+*/
+typedef struct _FAKE_
+{
+	uint32_t irq_en;			//NVIC interrupt enables, from ISER/ICER
+
+	//bus faults
+	uint8_t absent;				//1 - nobody answers at MMA8451Q_ADDR
+	uint8_t hold_clocks;		//the slave holds SDA low until this many SCL clocks, 0 - released
+	uint16_t stall_after;		//bytes until the slave stretches SCL for good, 0 - never
+	uint8_t drop_stop;			//1 - the next STOP does not set STOPF
+	uint8_t nack_reg;			//register whose writes fail, see nack_writes
+	uint8_t nack_skip;			//writes to nack_reg that go through first, counted down
+	uint8_t nack_writes;		//then writes to nack_reg the sensor NACKs and ignores, counted down
+
+	//bus model
+	uint8_t busy;
+	uint8_t phase;
+	uint8_t last_c1;
+	uint8_t irq;				//an I2C0 interrupt is pending
+	uint8_t reg_set;			//the register address was written in this transfer
+	uint8_t rx_ack;				//the master ACKed the last byte it read
+	uint8_t stalled;
+	uint32_t arbl;				//STARTs refused because the bus was held
+	uint32_t acked_last;		//reads that ACKed their last byte, the slave would keep going
+	uint8_t pending;			//the flags are set and the driver hasn't looked yet
+	uint8_t serviced;			//the driver has looked since the last bus event
+	FAKE_XFER log[FAKE_LOG_SIZE];
+	uint32_t log_n;
+	uint8_t gpio;				//PTE24/25 are GPIO
+	uint8_t scl;
+	uint8_t sda;
+	uint32_t clocks;			//SCL clocks while the pins were GPIO
+	uint32_t stops;				//STOPs seen while the pins were GPIO
+	uint32_t us;				//Timer_us(), +1 per call
+
+	//bus time, in ns.  The bus adds its bit times, the test adds the time
+	//the rest of the loop would take.
+	uint64_t ns;
+	uint64_t bus_ns;			//time spent on START, bytes and STOP
+	uint64_t t_stop;			//when the last STOP went out
+	uint64_t gap_ns;			//idle time from each STOP to the next START, summed
+	uint64_t gap_max_ns;
+	uint32_t gaps;				//STARTs that followed a STOP
+
+	//sensor model
+	uint8_t reg[OFF_Z + 1];
+	uint8_t ptr;
+	int16_t out[3];
+	int16_t bias[3];			//added to every sample, in counts
+	int16_t fifo[MMA8451Q_FIFO_SIZE][3];
+	uint8_t f_head;
+	uint8_t f_cnt;
+	uint8_t f_ovf;
+	uint32_t samples;			//conversions made while ACTIVE
+	uint32_t violations;		//writes the sensor would have ignored
+	uint32_t underruns;			//FIFO reads with nothing in the FIFO
+} FAKE;
+
+extern FAKE fake;
+
+/**
+* @brief Power on reset of the bus, the sensor and the time base
+*
+* @return void.
+*/
+void Fake_reset(void);
+
+/**
+* @brief Make one conversion
+*
+* Ignored in STANDBY.  The value is in counts at the configured range,
+* fake.bias and the offset registers are added and the result is cut to
+* 14 bits like the sensor's output.
+*
+* @return void.
+*/
+void Fake_sample(int16_t x, int16_t y, int16_t z);
+
+/**
+* @brief Run the bus
+*
+* Act on whatever the driver did to the I2C0 registers and run the I2C0
+* ISR (Run_I2C_Master()) for as long as there is an interrupt pending
+* and the I2C0 IRQ is enabled.  With the IRQ disabled the flags are left
+* set until the driver looks at them.
+*
+* @return void.
+*/
+void Fake_run(I2C_Queue *q);
+
+/**
+* @brief Run the polled master
+*
+* Act on the I2C0 registers like Fake_run() but leave the flags for
+* I2C_POLL(), which is called once, as the I2C_POLLED background loop
+* does.  The I2C0 IRQ has to be disabled.
+*
+* @return void.
+*/
+void Fake_poll(I2C_Queue *q);
+
+/**
+* @brief Run the PORTA ISR
+*
+* Update the INT pins from the sensor and call MMA8451Q_INT_ISR() while
+* an armed pin has its flag set.
+*
+* @return void.
+*/
+void Fake_int(MMA8451Q *m, I2C_Queue *q);
+
+/**
+* @brief One pass of the background loop
+*
+* Update_MMA8451Q(), I2C_Service() and Check_I2C_Callback() as in main(),
+* with the ISRs run in between.
+*
+* @return void.
+*/
+void Fake_loop(MMA8451Q *m, I2C_Queue *q);
+
+#endif /* FAKE_MMA8451Q_H_ */
@@ -0,0 +1,52 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file fft_bench.c
+* @brief Host benchmark of Fft_run
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include "fft.h"
+#include "test.h"
+
+#define BENCH_RUNS		20000
+
+static FFT_CPX x[FFT_N];
+static volatile int32_t sink;
+
+int main(void)
+{
+	double t;
+	int32_t acc = 0;
+	int r, i;
+
+	t = Test_now();
+	for(r = 0; r < BENCH_RUNS; r++)
+	{
+		// fresh input every run, the output of the last one is mostly 0
+		for(i = 0; i < FFT_N; i++)
+		{
+			x[i].re = (int16_t)((i * 7919) + r);
+			x[i].im = 0;
+		}
+		Fft_run(x);
+		acc += x[r & (FFT_N - 1)].re;
+	}
+	t = Test_now() - t;
+	sink = acc;
+	printf("Fft_run %d points: %.2f us per transform, input fill included\n", FFT_N, t * 1e6 / BENCH_RUNS);
+
+	return(0);
+}
@@ -0,0 +1,274 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file fft_test.c
+* @brief Host test of the FFT and the spectrum mode
+*
+* Fft_run against a double precision DFT / N, tone placement and
+* amplitude, and the Hann windowed spectrum from Spectrum_task.  Built
+* once per FFT_LOG2N.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fft.h"
+#include "spectrum.h"
+#include "test.h"
+
+#define FFT_WINDOWS		200					//random and tonal windows against the DFT
+#define SPEC_FS_CHZ		80000				//800Hz
+#define SPEC_ONE_G		4096				//+/-8g range
+
+static FFT_CPX x[FFT_N];
+static double ref_re[FFT_N], ref_im[FFT_N];
+static SPECTRUM spec;
+RING_DEFINE(obuf, 64);
+
+static uint32_t seed = 1;
+
+static int32_t Test_rand(int32_t range)
+{
+	seed = (seed * 1664525) + 1013904223;
+	return((int32_t)((seed >> 8) % (2 * range + 1)) - range);
+}
+
+//DFT / N of x in double precision
+static void Test_dft(void)
+{
+	double w;
+	int k, n;
+
+	for(k = 0; k < FFT_N; k++)
+	{
+		ref_re[k] = ref_im[k] = 0;
+		for(n = 0; n < FFT_N; n++)
+		{
+			w = -2 * M_PI * (double)((k * n) % FFT_N) / FFT_N;
+			ref_re[k] += (x[n].re * cos(w)) - (x[n].im * sin(w));
+			ref_im[k] += (x[n].re * sin(w)) + (x[n].im * cos(w));
+		}
+		ref_re[k] /= FFT_N;
+		ref_im[k] /= FFT_N;
+	}
+}
+
+static void Test_against_dft(void)
+{
+	double e, err = 0, sq = 0;
+	int w, i, a1, a2, k1, k2;
+
+	for(w = 0; w < FFT_WINDOWS; w++)
+	{
+		// odd windows are two tones plus noise, even ones full scale noise
+		a1 = abs(Test_rand(20000));
+		a2 = abs(Test_rand(10000));
+		k1 = abs(Test_rand(FFT_N / 2));
+		k2 = abs(Test_rand(FFT_N / 2));
+		for(i = 0; i < FFT_N; i++)
+		{
+			if(w & 1)
+			{
+				x[i].re = lrint((a1 * cos(2 * M_PI * k1 * i / FFT_N)) + (a2 * sin(2 * M_PI * k2 * i / FFT_N))) + Test_rand(2000);
+				x[i].im = Test_rand(2000);
+			}
+			else
+			{
+				x[i].re = Test_rand(32767);
+				x[i].im = Test_rand(32767);
+			}
+		}
+
+		Test_dft();
+		Fft_run(x);
+
+		for(i = 0; i < FFT_N; i++)
+		{
+			e = hypot(x[i].re - ref_re[i], x[i].im - ref_im[i]);
+			sq += e * e;
+			if(e > err)
+			{
+				err = e;
+			}
+		}
+	}
+	sq = sqrt(sq / ((double)FFT_WINDOWS * FFT_N));
+	printf("Fft_run %d points: max error %.2f LSB, rms %.2f LSB\n", FFT_N, err, sq);
+
+	CHECK(err < 2.0, "Fft_run max error %.2f LSB", err);
+	CHECK(sq < 0.75, "Fft_run rms error %.2f LSB", sq);
+}
+
+//a cosine of amplitude a at bin k is a / 2 in bins k and N - k and 0 elsewhere
+static void Test_tone(int k, int a)
+{
+	int i, peak = 0;
+	double m, m_peak = 0, m_other = 0;
+
+	for(i = 0; i < FFT_N; i++)
+	{
+		x[i].re = lrint(a * cos(2 * M_PI * k * i / FFT_N));
+		x[i].im = 0;
+	}
+	Fft_run(x);
+
+	for(i = 1; i <= FFT_N / 2; i++)
+	{
+		m = hypot(x[i].re, x[i].im);
+		if(m > m_peak)
+		{
+			m_peak = m;
+			peak = i;
+		}
+	}
+	for(i = 1; i <= FFT_N / 2; i++)
+	{
+		m = hypot(x[i].re, x[i].im);
+		if((i != peak) && (m > m_other))
+		{
+			m_other = m;
+		}
+	}
+
+	CHECK(peak == k, "tone at bin %d found at bin %d", k, peak);
+	CHECK(fabs(m_peak - (a / 2.0)) < 2.0, "tone at bin %d: %.1f, want %.1f", k, m_peak, a / 2.0);
+	CHECK(m_other < 2.0, "tone at bin %d leaks %.1f", k, m_other);
+	CHECK((abs(x[FFT_N - k].re - x[k].re) <= 1) && (abs(x[FFT_N - k].im + x[k].im) <= 1), "tone at bin %d isn't mirrored", k);
+}
+
+static void Tx_none(void)
+{
+}
+
+//run Spectrum_task to the end of the report, lines go to out
+static void Test_spectrum_run(char *out, int len)
+{
+	int n = 0;
+
+	do
+	{
+		Spectrum_task(&spec, &obuf, Tx_none);
+		n += extract_block(&obuf, &out[n], len - 1 - n);
+	} while(spec.state == SPEC_SEND);
+	out[n] = 0;
+}
+
+//1g DC plus 100mg at 50Hz and 30mg at 125Hz, both on a bin at 800Hz
+static void Test_spectrum_input(void)
+{
+	int i;
+	int16_t v;
+
+	for(i = 0; i < FFT_N; i++)
+	{
+		v = lrint(SPEC_ONE_G + (0.100 * SPEC_ONE_G * sin(2 * M_PI * 50 * i / 800.0)) +
+				  (0.030 * SPEC_ONE_G * sin(2 * M_PI * 125 * i / 800.0)));
+		Spectrum_add(&spec, v);
+	}
+}
+
+static void Test_spectrum(void)
+{
+	static char out[FFT_N * 16];
+	double ref[SPEC_BINS + 1], e, err = 0;
+	int16_t in[FFT_N];
+	double mean = 0;
+	char *p;
+	int i, k, n, f, amp, lines;
+
+	// peaks
+	Spectrum_init(&spec, SPEC_FS_CHZ, SPEC_ONE_G, SPEC_REPORT_PEAKS);
+	Test_spectrum_input();
+	Test_spectrum_run(out, sizeof(out));
+
+	CHECK(strncmp(out, "50.00 Hz ", 9) == 0, "first peak: %s", out);
+	p = strstr(out, "\r\n");
+	amp = atoi(out + 9);
+	CHECK(abs(amp - 100) <= 1, "50Hz peak %d mg", amp);
+	CHECK((p != 0) && (strncmp(p + 2, "125.00 Hz ", 10) == 0), "second peak: %s", (p != 0) ? p + 2 : "none");
+	if(p != 0)
+	{
+		amp = atoi(p + 12);
+		CHECK(abs(amp - 30) <= 1, "125Hz peak %d mg", amp);
+	}
+
+	// full Hann spectrum against the same window in double precision.  The
+	// bins are A / 8 of a sine of amplitude A, reported as mg.
+	for(i = 0; i < FFT_N; i++)
+	{
+		in[i] = lrint(SPEC_ONE_G + (0.100 * SPEC_ONE_G * sin(2 * M_PI * 50 * i / 800.0)) +
+					  (0.030 * SPEC_ONE_G * sin(2 * M_PI * 125 * i / 800.0)) + Test_rand(20));
+		mean += in[i];
+	}
+	mean /= FFT_N;
+	for(k = 0; k <= SPEC_BINS; k++)
+	{
+		double re = 0, im = 0, w;
+
+		for(i = 0; i < FFT_N; i++)
+		{
+			w = (in[i] - mean) * 0.5 * (1 - cos(2 * M_PI * i / FFT_N));
+			re += w * cos(2 * M_PI * (double)((k * i) % FFT_N) / FFT_N);
+			im -= w * sin(2 * M_PI * (double)((k * i) % FFT_N) / FFT_N);
+		}
+		// 4 = 2 for the one sided spectrum times 2 for the Hann gain
+		ref[k] = hypot(re, im) * 4 / FFT_N * 1000 / SPEC_ONE_G;
+	}
+
+	Spectrum_init(&spec, SPEC_FS_CHZ, SPEC_ONE_G, SPEC_REPORT_FULL);
+	Spectrum_add_block(&spec, in, FFT_N);
+	Test_spectrum_run(out, sizeof(out));
+
+	lines = 0;
+	for(p = out; *p != 0; p = strstr(p, "\r\n") + 2)
+	{
+		if(sscanf(p, "%d.%*d %d", &f, &amp) != 2)
+		{
+			break;
+		}
+		n = lines;
+		e = fabs(amp - ref[n]);
+		if(e > err)
+		{
+			err = e;
+		}
+		CHECK(f == (int)((n * (SPEC_FS_CHZ / 100.0)) / FFT_N), "bin %d at %d Hz", n, f);
+		lines++;
+	}
+	printf("Spectrum %d points: %d bins, max error %.2f mg against the double Hann spectrum\n", FFT_N, lines, err);
+
+	// DC .. Nyquist inclusive
+	CHECK(lines == SPEC_BINS + 1, "%d lines, want %d", lines, SPEC_BINS + 1);
+	// one 8 count step of the output is 2mg at 4096 counts/g
+	CHECK(err < 4.0, "spectrum error %.2f mg", err);
+	// Hann: an on bin tone is half height in the next bins out and 0 past them
+	k = (50 * FFT_N) / 800;
+	CHECK(fabs(ref[k] - 100) < 1, "reference 50Hz %.2f", ref[k]);
+	CHECK((fabs(ref[k - 1] - 50) < 1) && (fabs(ref[k + 1] - 50) < 1), "50Hz side bins %.2f %.2f", ref[k - 1], ref[k + 1]);
+	CHECK((ref[k - 2] < 1) && (ref[k + 2] < 1), "50Hz leaks %.2f %.2f", ref[k - 2], ref[k + 2]);
+}
+
+int main(void)
+{
+	Test_against_dft();
+	Test_tone(1, 20000);
+	Test_tone(FFT_N / 8, 32767);
+	Test_tone(FFT_N / 2 - 1, 10000);
+	Test_tone(37, 16384);
+	Test_spectrum();
+
+	return(TEST_DONE());
+}
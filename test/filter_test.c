@@ -0,0 +1,379 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file filter_test.c
+* @brief Host test of the biquad low pass
+*
+* Checks the compile time designs against the tables they replaced,
+* unity DC gain, the response at the cutoff, the passband and Nyquist
+* against a double precision model, and that the error feedback DF-I
+* settles to exactly zero with no limit cycle.  The CIC decimator is
+* checked against an exact FIR model, including long runs that wrap the
+* integrators, and for the ratio/order limit.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "filter.h"
+#include "test.h"
+
+#define DECIM_TAPS		1024			//longest CIC model, ratio 256 order 2 is 511
+
+static const BIQUAD_COEF lp_10hz_400hz[2] = BIQUAD_BW4_LP(10, 400);
+static const BIQUAD_COEF lp_50hz_800hz[2] = BIQUAD_BW4_LP(50, 800);
+
+//|H| of the quantized cascade at f
+static double Test_gain(const BIQUAD_COEF *c, double f, double fs)
+{
+	double w = 2.0 * M_PI * f / fs;
+	double g = 1.0;
+	double nr, ni, dr, di;
+	int i;
+
+	for(i = 0; i < 2; i++)
+	{
+		nr = (c[i].b0 + (c[i].b1 * cos(w)) + (c[i].b2 * cos(2 * w))) / 16384.0;
+		ni = -((c[i].b1 * sin(w)) + (c[i].b2 * sin(2 * w))) / 16384.0;
+		dr = 1.0 + ((c[i].a1 * cos(w)) + (c[i].a2 * cos(2 * w))) / 16384.0;
+		di = -((c[i].a1 * sin(w)) + (c[i].a2 * sin(2 * w))) / 16384.0;
+		g *= sqrt(((nr * nr) + (ni * ni)) / ((dr * dr) + (di * di)));
+	}
+
+	return(g);
+}
+
+//amplitude of the filter output for a sine of amplitude a at f, once settled
+static double Test_sine(const BIQUAD_COEF *c, double f, double fs, double a)
+{
+	BIQUAD bq;
+	double re = 0, im = 0;
+	int n, settle = (int)(40 * fs / f) + 4000, len = (int)(200 * fs / f);
+	int16_t y;
+
+	Biquad_init(&bq, c, 2, 0);
+	for(n = 0; n < settle + len; n++)
+	{
+		y = Biquad_run(&bq, (int16_t)lround(a * sin(2.0 * M_PI * f * n / fs)));
+		if(n >= settle)
+		{
+			re += y * cos(2.0 * M_PI * f * n / fs);
+			im += y * sin(2.0 * M_PI * f * n / fs);
+		}
+	}
+
+	return(2.0 * sqrt((re * re) + (im * im)) / len);
+}
+
+static void Test_design(const char *name, const BIQUAD_COEF *c, double fc, double fs)
+{
+	static const int16_t dc[] = { 0, 1, -1, 16384, -16384, 32767, -32768, 1234 };
+	BIQUAD bq;
+	double g, db, ref;
+	int16_t y = 0;
+	unsigned i;
+	int n;
+
+	// every section sums to exactly unity at DC
+	for(i = 0; i < 2; i++)
+	{
+		CHECK((c[i].b0 + c[i].b1 + c[i].b2) == (16384 + c[i].a1 + c[i].a2), "%s section %u DC gain", name, i);
+	}
+
+	// a step from 0 ends exactly on the input
+	for(i = 0; i < sizeof(dc) / sizeof(dc[0]); i++)
+	{
+		Biquad_init(&bq, c, 2, 0);
+		for(n = 0; n < 20000; n++)
+		{
+			y = Biquad_run(&bq, dc[i]);
+		}
+		CHECK(y == dc[i], "%s step to %d settles at %d", name, dc[i], y);
+	}
+
+	// Butterworth is -3.01dB at the cutoff
+	g = Test_sine(c, fc, fs, 16000) / 16000;
+	db = 20 * log10(g);
+	CHECK(fabs(db + 3.01) < 0.1, "%s at fc %.2f dB", name, db);
+
+	// the passband and stopband follow the quantized design
+	for(i = 1; i < 8; i++)
+	{
+		ref = Test_gain(c, fc * i / 4, fs);
+		g = Test_sine(c, fc * i / 4, fs, 16000) / 16000;
+		CHECK(fabs(g - ref) < 2.0 / 16000, "%s at %.1f Hz %.5f vs %.5f", name, fc * i / 4, g, ref);
+	}
+
+	// the bilinear transform puts a zero at Nyquist
+	Biquad_init(&bq, c, 2, 0);
+	for(n = 0; n < 20000; n++)
+	{
+		y = Biquad_run(&bq, (n & 1) ? -16000 : 16000);
+		if(n > 10000)
+		{
+			CHECK(abs(y) <= 1, "%s Nyquist output %d", name, y);
+			if(abs(y) > 1)
+			{
+				break;
+			}
+		}
+	}
+
+	// no limit cycle: after a full scale kick and silence the output is 0
+	Biquad_init(&bq, c, 2, 0);
+	for(n = 0; n < 50; n++)
+	{
+		Biquad_run(&bq, (n & 4) ? 32767 : -32768);
+	}
+	for(n = 0; n < 40000; n++)
+	{
+		y = Biquad_run(&bq, 0);
+		if(n > 20000)
+		{
+			CHECK(y == 0, "%s limit cycle, %d after %d zeros", name, y, n);
+			if(y != 0)
+			{
+				break;
+			}
+		}
+	}
+
+	printf("%s: fc %.2f dB, 2fc %.1f dB, 0.99 Nyquist %.1f dB\n", name,
+		   20 * log10(Test_gain(c, fc, fs)), 20 * log10(Test_gain(c, 2 * fc, fs)),
+		   20 * log10(Test_gain(c, (fs / 2) * 0.99, fs)));
+}
+
+//CIC of order stages with a ratio long boxcar each, as one FIR over the
+//newest taps inputs (h[0] is the newest), exact in 64 bits
+static int32_t Decim_taps(uint16_t ratio, uint8_t order, int64_t *h)
+{
+	int64_t t[DECIM_TAPS];
+	int32_t n = 1, i, j, k;
+
+	h[0] = 1;
+	for(k = 0; k < order; k++)
+	{
+		for(i = 0; i < n + ratio - 1; i++)
+		{
+			t[i] = 0;
+			for(j = 0; j < ratio; j++)
+			{
+				if((i - j >= 0) && (i - j < n))
+				{
+					t[i] += h[i - j];
+				}
+			}
+		}
+		n += ratio - 1;
+		memcpy(h, t, n * sizeof(h[0]));
+	}
+
+	return(n);
+}
+
+//Decim_run() against the FIR model for len samples from next(), returns
+//the number of outputs that differ
+static uint32_t Test_decim_run(uint16_t ratio, uint8_t order, uint32_t len, int16_t (*next)(uint32_t), uint32_t *outputs)
+{
+	static int16_t hist[DECIM_TAPS];
+	int64_t h[DECIM_TAPS];
+	int64_t acc, gain = 1;
+	DECIM d;
+	uint32_t i, bad = 0;
+	int32_t taps, k;
+	int16_t x, out;
+	uint8_t o;
+
+	taps = Decim_taps(ratio, order, h);
+	for(k = 0; k < order; k++)
+	{
+		gain *= ratio;
+	}
+	memset(hist, 0, sizeof(hist));
+	CHECK(Decim_init(&d, ratio, order) == 0, "ratio %u order %u refused", ratio, order);
+	CHECK(d.gain == gain, "ratio %u order %u: gain %d", ratio, order, d.gain);
+
+	*outputs = 0;
+	for(i = 0; i < len; i++)
+	{
+		x = next(i);
+		memmove(&hist[1], &hist[0], (taps - 1) * sizeof(hist[0]));
+		hist[0] = x;
+		o = Decim_run(&d, x, &out);
+		if(o != (((i + 1) % ratio) == 0))
+		{
+			bad++;
+			continue;
+		}
+		if(o)
+		{
+			acc = 0;
+			for(k = 0; k < taps; k++)
+			{
+				acc += h[k] * hist[k];
+			}
+			// C division, toward 0 like Decim_run
+			if(out != (int16_t)(acc / gain))
+			{
+				bad++;
+			}
+			(*outputs)++;
+		}
+	}
+
+	return(bad);
+}
+
+static uint32_t decim_seed = 1;
+
+static int16_t Decim_random(uint32_t i)
+{
+	(void)i;
+	decim_seed = (decim_seed * 1664525) + 1013904223;
+	return((int16_t)(decim_seed >> 16));
+}
+
+static int16_t decim_dc;
+
+static int16_t Decim_dc(uint32_t i)
+{
+	(void)i;
+	return(decim_dc);
+}
+
+//full scale that spends most of its time near +32767
+static int16_t Decim_high(uint32_t i)
+{
+	return((i % 7) ? 32767 : -32768);
+}
+
+static void Test_decim(void)
+{
+	static const int16_t dc[] = { 0, 1, -1, 1000, -4096, 32767, -32768 };
+	uint32_t bad, n, k;
+	uint16_t ratio;
+	uint8_t order;
+	DECIM d;
+	int16_t out;
+
+	// order 1 is a boxcar average of the last ratio samples
+	for(ratio = 1; ratio <= 64; ratio++)
+	{
+		bad = Test_decim_run(ratio, 1, 4096, Decim_random, &n);
+		CHECK((bad == 0) && (n == 4096 / ratio), "boxcar of %u: %u of %u outputs wrong", ratio, bad, n);
+	}
+
+	// orders 2 and 3 against the FIR model, and DC comes back out exactly
+	// once the combs have seen order outputs, i.e. the ratio^order gain is
+	// divided back out
+	for(order = 2; order <= DECIM_MAX_ORDER; order++)
+	{
+		for(ratio = 1; ratio <= 40; ratio += 3)
+		{
+			bad = Test_decim_run(ratio, order, 2048, Decim_random, &n);
+			CHECK(bad == 0, "CIC ratio %u order %u: %u of %u outputs wrong", ratio, order, bad, n);
+			for(k = 0; k < sizeof(dc) / sizeof(dc[0]); k++)
+			{
+				Decim_init(&d, ratio, order);
+				for(n = 0; n < (uint32_t)ratio * (order + 3); n++)
+				{
+					if(Decim_run(&d, dc[k], &out) && (n >= (uint32_t)ratio * order))
+					{
+						CHECK(out == dc[k], "CIC ratio %u order %u: DC %d reads %d", ratio, order, dc[k], out);
+					}
+				}
+			}
+		}
+	}
+
+	// long enough at full scale for every integrator to wrap many times
+	decim_dc = 32767;
+	bad = Test_decim_run(40, 3, 200000, Decim_dc, &n);
+	CHECK(bad == 0, "DC 32767 through the wrap: %u of %u outputs wrong", bad, n);
+	bad = Test_decim_run(256, 2, 400000, Decim_high, &n);
+	CHECK(bad == 0, "ratio 256 order 2 through the wrap: %u of %u outputs wrong", bad, n);
+	bad = Test_decim_run(16, 1, 1000000, Decim_high, &n);
+	CHECK(bad == 0, "ratio 16 order 1 through the wrap: %u of %u outputs wrong", bad, n);
+	// 200000 * 32767 is well past 2^32 in the first integrator alone
+	CHECK((200000ULL * 32767) > (1ULL << 32), "the run is too short to wrap");
+
+	// ratio^order must leave |x| * ratio^order inside an int32, and
+	// DECIM_GAIN() agrees with Decim_init() for the compile time checks
+	for(order = 1; order <= DECIM_MAX_ORDER; order++)
+	{
+		bad = 0;
+		for(k = 1; k <= 65535; k++)
+		{
+			if((Decim_init(&d, k, order) == 0) != (DECIM_GAIN(k, order) <= 0x10000))
+			{
+				bad++;
+			}
+		}
+		CHECK(bad == 0, "order %u: %u ratios accepted or refused wrongly", order, bad);
+	}
+	CHECK((Decim_init(&d, 0, 1) != 0) && (Decim_init(&d, 4, 0) != 0) && (Decim_init(&d, 2, DECIM_MAX_ORDER + 1) != 0),
+		  "ratio 0, order 0 or order %d accepted", DECIM_MAX_ORDER + 1);
+	// the largest gains hold full scale either way
+	for(k = 0; k < 2; k++)
+	{
+		decim_dc = (k) ? -32768 : 32767;
+		bad = Test_decim_run(256, 2, 256 * 6, Decim_dc, &n);
+		CHECK(bad == 0, "ratio 256 order 2 at %d: %u wrong", decim_dc, bad);
+		bad = Test_decim_run(40, 3, 40 * 8, Decim_dc, &n);
+		CHECK(bad == 0, "ratio 40 order 3 at %d: %u wrong", decim_dc, bad);
+	}
+
+	// a block gives the newest output, the same as one sample at a time
+	{
+		int16_t x[100], ref = 0, blk = 0;
+		DECIM a, b;
+		uint8_t r = 0;
+
+		for(k = 0; k < 100; k++)
+		{
+			x[k] = Decim_random(k);
+		}
+		Decim_init(&a, 8, 2);
+		Decim_init(&b, 8, 2);
+		for(k = 0; k < 100; k++)
+		{
+			r |= Decim_run(&a, x[k], &ref);
+		}
+		CHECK((Decim_block(&b, x, 100, &blk) == r) && (blk == ref) && (a.phase == b.phase) &&
+			  (memcmp(a.integ, b.integ, sizeof(a.integ)) == 0) && (memcmp(a.comb, b.comb, sizeof(a.comb)) == 0),
+			  "Decim_block %d, one at a time %d", blk, ref);
+		CHECK(Decim_block(&b, x, 3, &blk) == 0, "Decim_block output with no complete output");
+	}
+}
+
+int main(void)
+{
+	static const BIQUAD_COEF old_20hz_800hz[2] = { { 88, 176, 88, -28278, 12246 }, { 95, 190, 95, -30537, 14533 } };
+	static const BIQUAD_COEF old_5hz_100hz[2] = { { 312, 624, 312, -24243, 9107 }, { 358, 718, 358, -27869, 12919 } };
+
+	// the compile time design reproduces the tables designed offline
+	CHECK(memcmp(lp_20hz_800hz, old_20hz_800hz, sizeof(old_20hz_800hz)) == 0, "lp_20hz_800hz changed");
+	CHECK(memcmp(lp_5hz_100hz, old_5hz_100hz, sizeof(old_5hz_100hz)) == 0, "lp_5hz_100hz changed");
+
+	Test_design("lp_20hz_800hz", lp_20hz_800hz, 20, 800);
+	Test_design("lp_5hz_100hz", lp_5hz_100hz, 5, 100);
+	Test_design("lp_10hz_400hz", lp_10hz_400hz, 10, 400);
+	Test_design("lp_50hz_800hz", lp_50hz_800hz, 50, 800);
+
+	Test_decim();
+
+	return(TEST_DONE());
+}
@@ -0,0 +1,106 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file fmt_bench.c
+* @brief Host benchmark of the formatter against sprintf
+*
+* Builds the Display_task and Stats_task lines both ways.  sprintf leans
+* on the host's hardware divide, which the M0+ doesn't have, so these
+* numbers favour sprintf.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <stdint.h>
+#include "fmt.h"
+#include "test.h"
+
+#define BENCH_N		2000000
+
+static char line[64];
+static volatile uint32_t sink;
+
+static void Bench_display(void)
+{
+	double t_fmt, t_spr;
+	uint32_t acc = 0;
+	int32_t i;
+	char *p;
+
+	t_fmt = Test_now();
+	for(i = 0; i < BENCH_N; i++)
+	{
+		p = line;
+		p += Fmt_str(p, "\033[2J\033[HAngle - ");
+		p += Fmt_int(p, (i & 0x7FFF) - 18000, 0);
+		p += Fmt_str(p, "\r\n");
+		acc += p - line;
+	}
+	t_fmt = Test_now() - t_fmt;
+
+	t_spr = Test_now();
+	for(i = 0; i < BENCH_N; i++)
+	{
+		acc += sprintf(line, "\033[2J\033[HAngle - %ld\r\n", (long)((i & 0x7FFF) - 18000));
+	}
+	t_spr = Test_now() - t_spr;
+
+	sink = acc;
+	printf("display line: Fmt %.1f ns, sprintf %.1f ns\n", t_fmt * 1e9 / BENCH_N, t_spr * 1e9 / BENCH_N);
+}
+
+static void Bench_stats(void)
+{
+	double t_fmt, t_spr;
+	uint32_t acc = 0;
+	int32_t i;
+	char *p;
+
+	t_fmt = Test_now();
+	for(i = 0; i < BENCH_N; i++)
+	{
+		p = line;
+		p += Fmt_str(p, "x mean ");
+		p += Fmt_int(p, i - 4096, 0);
+		p += Fmt_str(p, " sd ");
+		p += Fmt_uint(p, i & 0xFFF, 0);
+		p += Fmt_str(p, " pk ");
+		p += Fmt_uint(p, i & 0x1FFF, 0);
+		p += Fmt_str(p, " cf ");
+		p += Fmt_fixed(p, 100 + (i & 0x1FF), 2, 0);
+		p += Fmt_str(p, "\r\n");
+		acc += p - line;
+	}
+	t_fmt = Test_now() - t_fmt;
+
+	t_spr = Test_now();
+	for(i = 0; i < BENCH_N; i++)
+	{
+		acc += sprintf(line, "x mean %ld sd %lu pk %lu cf %lu.%02lu\r\n", (long)(i - 4096),
+					   (unsigned long)(i & 0xFFF), (unsigned long)(i & 0x1FFF),
+					   (unsigned long)((100 + (i & 0x1FF)) / 100), (unsigned long)((100 + (i & 0x1FF)) % 100));
+	}
+	t_spr = Test_now() - t_spr;
+
+	sink = acc;
+	printf("stats line:   Fmt %.1f ns, sprintf %.1f ns\n", t_fmt * 1e9 / BENCH_N, t_spr * 1e9 / BENCH_N);
+}
+
+int main(void)
+{
+	Bench_display();
+	Bench_stats();
+
+	return(0);
+}
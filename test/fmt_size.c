@@ -0,0 +1,70 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file fmt_size.c
+* @brief The formatter and sprintf linked on their own, for the map file
+*
+* The Display_task, Stats_task and Goertzel_task lines made with fmt.c,
+* or with sprintf when built with -DFMT_SIZE_SPRINTF.  Nothing else is
+* linked in, so the difference in .text between the two images is what
+* the formatter saves.  See make fmtsize.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <stdint.h>
+#ifdef FMT_SIZE_SPRINTF
+#include <stdio.h>
+#else
+#include "fmt.h"
+#endif
+
+static char line[64];
+static volatile int32_t in[4] = {-18000, 4095, 8191, 16384};
+static volatile uint32_t sink;
+
+int main(void)
+{
+	int32_t a = in[0], b = in[1], c = in[2], q = in[3];
+	uint32_t n = 0;
+#ifndef FMT_SIZE_SPRINTF
+	char *p;
+
+	p = line;
+	p += Fmt_str(p, "Angle - ");
+	p += Fmt_int(p, a, 0);
+	n += p - line;
+
+	p = line;
+	p += Fmt_str(p, "x mean ");
+	p += Fmt_int(p, a, 6);
+	p += Fmt_str(p, " sd ");
+	p += Fmt_uint(p, b, 5);
+	p += Fmt_str(p, " cf ");
+	p += Fmt_fixed(p, c, 2, 0);
+	n += p - line;
+
+	p = line;
+	p += Fmt_q(p, q, 15, 3, 0);
+	p += Fmt_hex(p, b, 4);
+	n += p - line;
+#else
+	n += sprintf(line, "Angle - %ld", (long)a);
+	n += sprintf(line, "x mean %6ld sd %5lu cf %ld.%02ld", (long)a, (unsigned long)b, (long)(c / 100), (long)(c % 100));
+	n += sprintf(line, "%.3f%04lX", q / 32768.0, (unsigned long)b);
+#endif
+	sink = n;
+
+	return(0);
+}
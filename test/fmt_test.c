@@ -0,0 +1,216 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file fmt_test.c
+* @brief Host test of the formatter against sprintf
+*
+* Every function against the same conversion through sprintf, at the
+* int32 edges for every width and digit count and at random values, plus
+* Fmt_fixed negatives under 1 and Fmt_q rounding at half a step.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fmt.h"
+#include "test.h"
+
+#define FMT_RANDOM		200000
+
+static const int32_t edge[] =
+{
+	0, 1, -1, 9, -9, 10, -10, 99, 100, -100, 999, 1000, 65535, 65536,
+	999999999, 1000000000, -999999999, -1000000000,
+	INT32_MAX, INT32_MAX - 1, INT32_MIN, INT32_MIN + 1
+};
+#define EDGES	(sizeof(edge) / sizeof(edge[0]))
+
+static uint32_t seed = 1;
+
+static uint32_t Test_rand(void)
+{
+	seed = (seed * 1664525) + 1013904223;
+	return(seed);
+}
+
+//random value with a random number of significant bits
+static int32_t Test_value(void)
+{
+	uint32_t v = Test_rand();
+
+	return((int32_t)v >> (Test_rand() % 32));
+}
+
+//buf holds n chars from a Fmt_ call, compare with the NUL terminated ref
+static void Test_same(const char *what, const char *buf, uint8_t n, const char *ref)
+{
+	CHECK((n == strlen(ref)) && (memcmp(buf, ref, n) == 0),
+		  "%s: \"%.*s\" (%u chars), sprintf \"%s\"", what, n, buf, n, ref);
+}
+
+static void Test_int(int32_t v, uint8_t width)
+{
+	char buf[32], ref[32];
+	uint8_t n;
+
+	n = Fmt_int(buf, v, width);
+	sprintf(ref, "%*ld", width, (long)v);
+	Test_same("Fmt_int", buf, n, ref);
+
+	n = Fmt_uint(buf, (uint32_t)v, width);
+	sprintf(ref, "%*lu", width, (unsigned long)(uint32_t)v);
+	Test_same("Fmt_uint", buf, n, ref);
+}
+
+static void Test_hex(uint32_t v, uint8_t digits)
+{
+	char buf[32], ref[32];
+	uint8_t n;
+
+	n = Fmt_hex(buf, v, digits);
+	sprintf(ref, "%0*lX", digits, (unsigned long)((digits < 8) ? (v & ((1UL << (4 * digits)) - 1)) : v));
+	Test_same("Fmt_hex", buf, n, ref);
+}
+
+//sign, whole part, point and the fraction digits of m / 10^decimals
+static void Test_ref_fixed(char *ref, int neg, uint32_t m, uint8_t decimals, uint8_t width)
+{
+	char tmp[32], frac[16];
+	uint32_t p = 1;
+	uint8_t i;
+
+	for(i = 0; i < decimals; i++)
+	{
+		p *= 10;
+	}
+	// p + fraction is a 1 followed by the zero padded fraction
+	sprintf(frac, "%lu", (unsigned long)(p + (m % p)));
+	frac[0] = '.';
+	sprintf(tmp, "%s%lu%s", neg ? "-" : "", (unsigned long)(m / p), (decimals != 0) ? frac : "");
+	sprintf(ref, "%*s", width, tmp);
+}
+
+static void Test_fixed(int32_t v, uint8_t decimals, uint8_t width)
+{
+	char buf[32], ref[32];
+	uint8_t n;
+
+	n = Fmt_fixed(buf, v, decimals, width);
+	Test_ref_fixed(ref, v < 0, (v < 0) ? (0 - (uint32_t)v) : (uint32_t)v, decimals, width);
+	Test_same("Fmt_fixed", buf, n, ref);
+}
+
+static void Test_q(int32_t v, uint8_t q, uint8_t decimals, uint8_t width)
+{
+	char buf[32], ref[32];
+	long double x;
+	uint8_t n;
+
+	// |v| * 10^decimals / 2^q, half away from zero.  The product is under
+	// 2^62 so a long double holds it exactly.
+	x = floorl((fabsl((long double)v) * powl(10, decimals) / ldexpl(1, q)) + 0.5L);
+	if(x > UINT32_MAX)
+	{
+		return;
+	}
+
+	n = Fmt_q(buf, v, q, decimals, width);
+	// no sign on a value that rounds to 0
+	Test_ref_fixed(ref, (v < 0) && (x != 0), (uint32_t)x, decimals, width);
+	Test_same("Fmt_q", buf, n, ref);
+}
+
+static void Test_edges(void)
+{
+	char buf[32];
+	uint8_t n;
+	uint8_t i, w, d;
+
+	for(i = 0; i < EDGES; i++)
+	{
+		for(w = 0; w <= 12; w++)
+		{
+			Test_int(edge[i], w);
+		}
+		for(d = 1; d <= 8; d++)
+		{
+			Test_hex(edge[i], d);
+		}
+		for(d = 0; d <= 9; d++)
+		{
+			Test_fixed(edge[i], d, 0);
+			Test_fixed(edge[i], d, 14);
+			Test_q(edge[i], 15, d, 0);
+			Test_q(edge[i], 31, d, 0);
+		}
+	}
+
+	// negatives under 1
+	n = Fmt_fixed(buf, -5, 2, 0);
+	Test_same("Fmt_fixed", buf, n, "-0.05");
+	n = Fmt_fixed(buf, -99, 3, 7);
+	Test_same("Fmt_fixed", buf, n, " -0.099");
+	n = Fmt_fixed(buf, -1, 9, 0);
+	Test_same("Fmt_fixed", buf, n, "-0.000000001");
+
+	// Fmt_q rounding: half a step rounds away from 0, just under it doesn't,
+	// and anything that rounds to 0 has no sign
+	n = Fmt_q(buf, 0x4000, 15, 3, 0);
+	Test_same("Fmt_q", buf, n, "0.500");
+	n = Fmt_q(buf, 1, 1, 0, 0);
+	Test_same("Fmt_q", buf, n, "1");
+	n = Fmt_q(buf, -1, 1, 0, 0);
+	Test_same("Fmt_q", buf, n, "-1");
+	n = Fmt_q(buf, 0x7FFF, 15, 3, 0);
+	Test_same("Fmt_q", buf, n, "1.000");
+	n = Fmt_q(buf, 16, 15, 3, 0);
+	Test_same("Fmt_q", buf, n, "0.000");
+	n = Fmt_q(buf, -16, 15, 3, 0);
+	Test_same("Fmt_q", buf, n, "0.000");
+	n = Fmt_q(buf, -17, 15, 3, 0);
+	Test_same("Fmt_q", buf, n, "-0.001");
+	n = Fmt_q(buf, -0x4000, 15, 1, 6);
+	Test_same("Fmt_q", buf, n, "  -0.5");
+
+	n = Fmt_str(buf, "Angle - ");
+	Test_same("Fmt_str", buf, n, "Angle - ");
+	n = Fmt_str(buf, "");
+	Test_same("Fmt_str", buf, n, "");
+}
+
+static void Test_random(void)
+{
+	int32_t v;
+	uint32_t i;
+
+	for(i = 0; i < FMT_RANDOM; i++)
+	{
+		v = Test_value();
+		Test_int(v, Test_rand() % 13);
+		Test_hex(v, 1 + (Test_rand() % 8));
+		Test_fixed(v, Test_rand() % 10, Test_rand() % 14);
+		Test_q(v, Test_rand() % 32, Test_rand() % 10, Test_rand() % 14);
+	}
+}
+
+int main(void)
+{
+	Test_edges();
+	Test_random();
+
+	return(TEST_DONE());
+}
@@ -0,0 +1,172 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file goertzel_test.c
+* @brief Host test of the Goertzel tone bank
+*
+* The 50/100/120Hz bank from TONE_MODE at 800Hz against known tones and a
+* double precision Goertzel, the 2^29 state limit with a full scale 2Hz
+* tone, the block path, dropped blocks and the report lines.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "goertzel.h"
+#include "test.h"
+
+#define FS				800
+#define TONE_LEN		400
+#define ONE_G			4096
+
+static const uint16_t freq[] = { 50, 100, 120 };
+static const int16_t coef[] = { GOERTZEL_COEF(50, FS), GOERTZEL_COEF(100, FS), GOERTZEL_COEF(120, FS) };
+#define BINS	(sizeof(coef) / sizeof(coef[0]))
+
+static GOERTZEL g;
+static int16_t in[TONE_LEN];
+RING_DEFINE(obuf, 64);
+
+static uint32_t seed = 1;
+
+static int32_t Test_rand(int32_t range)
+{
+	seed = (seed * 1664525) + 1013904223;
+	return((int32_t)((seed >> 8) % (2 * range + 1)) - range);
+}
+
+//1g DC, amplitude a1 at 50Hz and a2 at 120Hz, +/-noise
+static void Test_input(int a1, int a2, int noise)
+{
+	int i;
+
+	for(i = 0; i < TONE_LEN; i++)
+	{
+		in[i] = lrint(ONE_G + (a1 * sin(2 * M_PI * 50 * i / FS)) + (a2 * cos(2 * M_PI * 120 * i / FS))) + Test_rand(noise);
+	}
+}
+
+//amplitude of the tone at f in in[], double precision Goertzel with the
+//exact coefficient or, if c isn't 0, with c in Q14
+static double Test_ref(double f, int16_t q)
+{
+	double c = (q != 0) ? (q / 16384.0) : (2 * cos(2 * M_PI * f / FS));
+	double s, s1 = 0, s2 = 0;
+	int i;
+
+	for(i = 0; i < TONE_LEN; i++)
+	{
+		s = in[i] + (c * s1) - s2;
+		s2 = s1;
+		s1 = s;
+	}
+
+	return(sqrt((s1 * s1) + (s2 * s2) - (c * s1 * s2)) * 2 / TONE_LEN);
+}
+
+static void Test_tones(void)
+{
+	uint8_t i;
+
+	Goertzel_init(&g, coef, BINS, TONE_LEN);
+	Test_input(3000, 500, 20);
+	CHECK(!Goertzel_block(&g, in, TONE_LEN - 1), "block ended early");
+	CHECK(Goertzel_block(&g, &in[TONE_LEN - 1], 1) && g.ready, "block didn't end");
+
+	for(i = 0; i < BINS; i++)
+	{
+		CHECK(fabs(g.amp[i] - Test_ref(freq[i], 0)) <= 1.5, "%u Hz: %u, double %.1f", freq[i], g.amp[i], Test_ref(freq[i], 0));
+	}
+	CHECK(abs(g.amp[0] - 3000) <= 2, "50 Hz %u", g.amp[0]);
+	CHECK(g.amp[1] <= 5, "100 Hz %u", g.amp[1]);
+	CHECK(abs(g.amp[2] - 500) <= 2, "120 Hz %u", g.amp[2]);
+}
+
+//slowest tone the header allows, full scale, sample by sample
+static void Test_low_tone(int16_t dc, int16_t a)
+{
+	static const int16_t low_coef[] = { GOERTZEL_COEF(2, FS) };
+	int32_t peak = 0;
+	double ref, ref_q;
+	int i;
+
+	Goertzel_init(&g, low_coef, 1, TONE_LEN);
+	for(i = 0; i < TONE_LEN; i++)
+	{
+		in[i] = lrint(dc + (a * cos(2 * M_PI * 2 * i / FS)));
+		Goertzel_run(&g, in[i]);
+		if(labs(g.s1[0]) > peak)
+		{
+			peak = labs(g.s1[0]);
+		}
+	}
+	ref = Test_ref(2, 0);
+	ref_q = Test_ref(2, low_coef[0]);
+	printf("Goertzel 2Hz, DC %d, amplitude %d: state peak %ld, result %u, double %.1f, double with the Q14 coefficient %.1f\n",
+		   dc, a, (long)peak, g.amp[0], ref, ref_q);
+
+	CHECK(peak < (1L << 29), "state %ld over 2^29", (long)peak);
+	// the fixed point math adds little to the coefficient quantization
+	CHECK(fabs(g.amp[0] - ref_q) < 2, "2 Hz %u, double with the Q14 coefficient %.1f", g.amp[0], ref_q);
+}
+
+static void Tx_none(void)
+{
+}
+
+static void Test_report(void)
+{
+	char out[128], ref[128];
+	uint16_t amp[BINS];
+	uint8_t i;
+	int n = 0;
+
+	// a second block while the first is still unsent is dropped
+	Goertzel_init(&g, coef, BINS, TONE_LEN);
+	Test_input(3000, 500, 0);
+	Goertzel_block(&g, in, TONE_LEN);
+	memcpy(amp, g.amp, sizeof(amp));
+
+	// part of the report goes out, then the next block ends
+	Goertzel_task(&g, freq, ONE_G, &obuf, Tx_none);
+	n += extract_block(&obuf, &out[n], sizeof(out) - 1 - n);
+	Test_input(0, 0, 0);
+	CHECK(Goertzel_block(&g, in, TONE_LEN), "second block didn't end");
+	CHECK(memcmp(amp, g.amp, sizeof(amp)) == 0, "second block overwrote the results being sent");
+
+	for(i = 0; i < 10; i++)
+	{
+		Goertzel_task(&g, freq, ONE_G, &obuf, Tx_none);
+		n += extract_block(&obuf, &out[n], sizeof(out) - 1 - n);
+	}
+	out[n] = 0;
+
+	// 3000 / 4096 g and 500 / 4096 g
+	CHECK((amp[0] == 3000) && (amp[1] == 0) && (amp[2] == 499), "amplitudes %u %u %u", amp[0], amp[1], amp[2]);
+	sprintf(ref, "50 Hz %u mg\r\n100 Hz %u mg\r\n120 Hz %u mg\r\n", (amp[0] * 1000) / ONE_G, (amp[1] * 1000) / ONE_G, (amp[2] * 1000) / ONE_G);
+	CHECK(strcmp(out, ref) == 0, "report \"%s\"", out);
+	CHECK(!g.ready, "still ready after the report");
+}
+
+int main(void)
+{
+	Test_tones();
+	Test_low_tone(0, 32767);
+	Test_low_tone(16383, 16383);
+	Test_report();
+
+	return(TEST_DONE());
+}
@@ -0,0 +1,410 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file i2c_test.c
+* @brief Host test of the I2C0 job queue against the register level fake
+*
+* Drives i2c.c the way main() does, with Run_I2C_Master() only ever
+* called as the I2C0 ISR from the fake.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <string.h>
+#include "fake_mma8451q.h"
+#include "test.h"
+
+#define DONE_MAX		32
+
+typedef struct
+{
+	uintptr_t tag;
+	uint8_t count;
+	uint8_t data[I2C_DATA_SIZE];
+} DONE;
+
+static I2C_Queue q;
+static DONE done[DONE_MAX];
+static uint8_t done_n;
+
+static uint8_t Test_cb(uint8_t *data, uint8_t count, void *context)
+{
+	if(done_n < DONE_MAX)
+	{
+		done[done_n].tag = (uintptr_t)context;
+		done[done_n].count = count;
+		memcpy(done[done_n].data, data, (count < I2C_DATA_SIZE) ? count : I2C_DATA_SIZE);
+		done_n++;
+	}
+
+	return 0;
+}
+
+static void Test_reset(void)
+{
+	Fake_reset();
+	I2C_init(&q);
+	memset(done, 0, sizeof(done));
+	done_n = 0;
+}
+
+static uint8_t Test_read(uint8_t reg, uint8_t count, I2C_PRIORITY pri, uintptr_t tag)
+{
+	I2C_Packet p = {0};
+
+	p.slaveAddress = MMA8451Q_ADDR;
+	p.command = reg;
+	p.byteCount = count;
+	p.priority = pri;
+	p.i2c_callback = Test_cb;
+	p.context = (void *)tag;
+
+	return(I2C_Read(&q, &p));
+}
+
+static uint8_t Test_write(uint8_t reg, uint8_t value, I2C_PRIORITY pri, uintptr_t tag)
+{
+	I2C_Packet p = {0};
+
+	p.slaveAddress = MMA8451Q_ADDR;
+	p.command = reg;
+	p.byteCount = 1;
+	p.data[0] = value;
+	p.priority = pri;
+	p.i2c_callback = Test_cb;
+	p.context = (void *)tag;
+
+	return(I2C_Write(&q, &p));
+}
+
+//one pass of the background loop, us microseconds after the last one
+static void Test_pass(uint32_t us)
+{
+	Fake_run(&q);
+	fake.us += us;
+	I2C_Service(&q);
+	Fake_run(&q);
+	Check_I2C_Callback(&q);
+}
+
+//run the loop until n callbacks have come back
+static void Test_until(uint8_t n, uint32_t us)
+{
+	uint16_t i;
+
+	for(i = 0; (i < 2000) && (done_n < n); i++)
+	{
+		Test_pass(us);
+	}
+}
+
+static void Test_isr(void)
+{
+	uint32_t prio;
+
+	Test_reset();
+	Fake_run(&q);
+	CHECK(fake.irq_en & (1UL << I2C0_IRQn), "I2C0 IRQ not enabled");
+	prio = (NVIC->IP[_IP_IDX(I2C0_IRQn)] >> _BIT_SHIFT(I2C0_IRQn)) & 0xFF;
+	CHECK(prio == (1 << (8 - __NVIC_PRIO_BITS)), "I2C0 priority 0x%02x", prio);
+	CHECK(I2C0->FLT & I2C_FLT_STOPIE(1), "STOP interrupt not enabled");
+
+	// the submit starts the job, the ISR alone takes it to the end
+	CHECK(Test_read(WHO_AM_I, 1, I2C_PRI_LOW, 1) == 0, "read not queued");
+	Fake_run(&q);
+	CHECK((q.active == 0) && (q.stopping == 0), "bus not idle after the ISR");
+	CHECK(q.job[0].status == JOB_DONE, "job status %d", q.job[0].status);
+	CHECK(done_n == 0, "callback ran from the ISR");
+	Check_I2C_Callback(&q);
+	CHECK((done_n == 1) && (done[0].count == 1) && (done[0].data[0] == 0x1A),
+		  "WHO_AM_I callback %u count %u data 0x%02x", done_n, done[0].count, done[0].data[0]);
+	CHECK((fake.log_n == 1) && fake.log[0].rw && (fake.log[0].reg == WHO_AM_I) && (fake.log[0].len == 1),
+		  "WHO_AM_I transfer");
+	CHECK(fake.acked_last == 0, "single byte read ACKed its byte");
+
+	// queued jobs are chained from the STOP interrupt, no foreground needed
+	Test_reset();
+	Test_write(CTRL_REG2, 0x02, I2C_PRI_LOW, 1);
+	Test_write(XYZ_DATA_CFG, 0x01, I2C_PRI_LOW, 2);
+	Test_read(CTRL_REG2, 1, I2C_PRI_LOW, 3);
+	Test_read(STATUS, 7, I2C_PRI_LOW, 4);
+	Fake_run(&q);
+	CHECK(fake.log_n == 4, "%u transfers after one run of the ISR", fake.log_n);
+	CHECK((fake.reg[CTRL_REG2] == 0x02) && (fake.reg[XYZ_DATA_CFG] == 0x01), "writes did not land");
+	Check_I2C_Callback(&q);
+	CHECK(done_n == 4, "%u callbacks", done_n);
+	CHECK((done[2].count == 1) && (done[2].data[0] == 0x02), "read back 0x%02x", done[2].data[0]);
+	CHECK(done[3].count == 7, "7 byte read count %u", done[3].count);
+	CHECK((q.depth == 0) && (q.completed == 4) && (q.errors == 0),
+		  "depth %u completed %u errors %u", q.depth, q.completed, q.errors);
+	CHECK(fake.acked_last == 0, "%u reads ACKed their last byte", fake.acked_last);
+}
+
+static void Test_priority(void)
+{
+	static const uint8_t order[5] = {WHO_AM_I, OUT_X_MSB, STATUS, CTRL_REG1, CTRL_REG2};
+	I2C_Packet p = {0};
+	uint8_t i;
+
+	// the first job goes straight onto the idle bus, the rest queue behind
+	// it.  Start the sequence numbers just short of the wrap.
+	Test_reset();
+	q.seq = 0xFFFFFFFE;
+	Test_read(WHO_AM_I, 1, I2C_PRI_LOW, 1);
+	Test_read(CTRL_REG1, 1, I2C_PRI_LOW, 2);
+	Test_read(OUT_X_MSB, 6, I2C_PRI_HIGH, 3);
+	Test_read(CTRL_REG2, 1, I2C_PRI_LOW, 4);
+	Test_read(STATUS, 7, I2C_PRI_HIGH, 5);
+	Fake_run(&q);
+
+	// high priority first, submission order within a priority
+	CHECK(fake.log_n == 5, "%u transfers", fake.log_n);
+	for(i = 0; i < 5; i++)
+	{
+		CHECK(fake.log[i].reg == order[i], "transfer %u read register 0x%02x, expected 0x%02x",
+			  i, fake.log[i].reg, order[i]);
+	}
+	Check_I2C_Callback(&q);
+	CHECK(done_n == 5, "%u callbacks", done_n);
+
+	// eight slots, the active job holds one of them until it is reaped
+	Test_reset();
+	for(i = 0; i < I2C_QUEUE_SIZE; i++)
+	{
+		CHECK(Test_read(WHO_AM_I, 1, I2C_PRI_LOW, i) == 0, "job %u not queued", i);
+	}
+	CHECK(Test_read(WHO_AM_I, 1, I2C_PRI_HIGH, 99) == 3, "full queue took a job");
+	CHECK((q.depth == I2C_QUEUE_SIZE) && (q.max_depth == I2C_QUEUE_SIZE), "depth %u max %u", q.depth, q.max_depth);
+	Fake_run(&q);
+	CHECK(Test_read(WHO_AM_I, 1, I2C_PRI_HIGH, 99) == 3, "done but unreaped jobs were reused");
+	Check_I2C_Callback(&q);
+	CHECK((done_n == I2C_QUEUE_SIZE) && (q.depth == 0), "%u callbacks, depth %u", done_n, q.depth);
+	CHECK(Test_read(WHO_AM_I, 1, I2C_PRI_HIGH, 99) == 0, "queue did not free up");
+
+	// a transfer has to fit the packet, or bring its own buffer
+	p.slaveAddress = MMA8451Q_ADDR;
+	p.byteCount = 0;
+	CHECK(I2C_Read(&q, &p) == 1, "empty read accepted");
+	p.byteCount = I2C_DATA_SIZE + 1;
+	CHECK(I2C_Read(&q, &p) == 1, "read longer than data[] accepted");
+}
+
+static void Test_recover(void)
+{
+	uint32_t t;
+
+	// A slave holding SDA low keeps BUSY set.  The job waits without
+	// blocking, then the bus is clocked free and the job goes out.
+	Test_reset();
+	fake.hold_clocks = 3;
+	Fake_run(&q);
+	CHECK(Test_read(WHO_AM_I, 1, I2C_PRI_LOW, 1) == 0, "read not queued");
+	CHECK(q.job[0].state == WAIT_BUS, "job state %d with the bus held", q.job[0].state);
+	t = fake.us;
+	Test_pass(100);
+	CHECK((fake.us - t) < 110, "I2C_Service() waited %u us", fake.us - t);
+	CHECK((done_n == 0) && (q.recoveries == 0), "gave up on a busy bus after 100 us");
+	Test_until(1, 100);
+	CHECK(q.recoveries == 1, "%u recoveries", q.recoveries);
+	// three clocks to free SDA and the one in the STOP
+	CHECK(fake.clocks == 3 + 1, "%u SCL clocks", fake.clocks);
+	CHECK(fake.stops == 1, "%u STOPs", fake.stops);
+	CHECK(q.recover_us < (I2C_RECOVER_CLOCKS + 2) * 2 * I2C_RECOVER_HALF_US + 20, "recovery took %u us", q.recover_us);
+	CHECK((PORTE->PCR[24] == PORT_PCR_MUX(5)) && (PORTE->PCR[25] == PORT_PCR_MUX(5)), "pins not back on I2C0");
+	CHECK((done_n == 1) && (done[0].count == 1) && (done[0].data[0] == 0x1A),
+		  "read after recovery: %u callbacks count %u data 0x%02x", done_n, done[0].count, done[0].data[0]);
+	CHECK(fake.arbl == 0, "%u STARTs on a busy bus", fake.arbl);
+
+	// The slave stops answering part way through a read.  That job fails
+	// with a byteCount of 0 and the one behind it completes.
+	Test_reset();
+	fake.stall_after = 4;
+	Test_read(STATUS, 7, I2C_PRI_HIGH, 1);
+	Test_read(WHO_AM_I, 1, I2C_PRI_LOW, 2);
+	Test_pass(100);
+	CHECK(done_n == 0, "stalled job finished");
+	Test_until(2, 100);
+	CHECK((done_n == 2) && (done[0].tag == 1) && (done[0].count == 0), "stalled job callback %u count %u",
+		  (unsigned)done[0].tag, done[0].count);
+	CHECK((done[1].tag == 2) && (done[1].count == 1) && (done[1].data[0] == 0x1A), "next job count %u data 0x%02x",
+		  done[1].count, done[1].data[0]);
+	CHECK((q.recoveries == 1) && (q.errors == 1), "%u recoveries, %u errors", q.recoveries, q.errors);
+
+	// A STOP that never shows up as STOPF.  The job before it is good,
+	// the next one starts after the recovery.
+	Test_reset();
+	fake.drop_stop = 1;
+	Test_read(WHO_AM_I, 1, I2C_PRI_LOW, 1);
+	Test_read(CTRL_REG1, 1, I2C_PRI_LOW, 2);
+	Test_pass(100);
+	CHECK((done_n == 1) && (done[0].count == 1), "job before the lost STOP: %u callbacks", done_n);
+	CHECK(q.stopping == 1, "not waiting for STOPF");
+	Test_until(2, 100);
+	CHECK((done_n == 2) && (done[1].count == 1), "job after the lost STOP: %u callbacks", done_n);
+	CHECK((q.recoveries == 1) && (q.errors == 0), "%u recoveries, %u errors", q.recoveries, q.errors);
+
+	// Nobody at the address: the job fails on the NACK without a recovery
+	Test_reset();
+	fake.absent = 1;
+	Test_read(WHO_AM_I, 1, I2C_PRI_LOW, 1);
+	Test_until(1, 100);
+	CHECK((done_n == 1) && (done[0].count == 0), "NACKed job count %u", done[0].count);
+	CHECK((q.recoveries == 0) && (fake.log[0].nack), "%u recoveries", q.recoveries);
+	fake.absent = 0;
+	Test_read(WHO_AM_I, 1, I2C_PRI_LOW, 2);
+	Test_until(2, 100);
+	CHECK((done_n == 2) && (done[1].count == 1), "job after the NACK count %u", done[1].count);
+}
+
+//Eight 6 byte reads, run the polled way or from the ISR, with the rest of
+//the loop taking pass_us each time round.  Returns the time the bus sat
+//idle part way through a transfer, per transfer.
+static uint64_t Test_idle_run(uint8_t polled, uint32_t pass_us)
+{
+	uint64_t idle = 0;
+	uint64_t t, bus;
+	uint16_t i;
+	uint8_t j;
+
+	Test_reset();
+	if(polled)
+	{
+		// what I2C_init() leaves with I2C_POLLED
+		NVIC->ICER[0] = 1UL << I2C0_IRQn;
+	}
+	for(j = 0; j < 8; j++)
+	{
+		t = fake.ns;
+		bus = fake.bus_ns;
+		Test_read(OUT_X_MSB, 6, I2C_PRI_HIGH, j);
+		for(i = 0; (i < 100) && (q.active != 0); i++)
+		{
+			if(polled)
+			{
+				Fake_poll(&q);
+			}
+			else
+			{
+				Fake_run(&q);
+			}
+			fake.ns += (uint64_t)pass_us * 1000;
+		}
+		// the STOP
+		for(i = 0; (i < 100) && q.stopping; i++)
+		{
+			if(polled)
+			{
+				Fake_poll(&q);
+			}
+			else
+			{
+				Fake_run(&q);
+			}
+		}
+		idle += (fake.t_stop - t) - (fake.bus_ns - bus);
+		Check_I2C_Callback(&q);
+	}
+	CHECK(done_n == 8, "%s: %u of 8 transfers", (polled) ? "polled" : "ISR", done_n);
+
+	return(idle / 8);
+}
+
+static void Test_idle(void)
+{
+	uint64_t polled_ns, isr_ns;
+	const uint32_t pass_us = 50;
+
+	// the polled master moves one byte a loop pass, the ISR moves each
+	// byte as soon as the last one is done
+	polled_ns = Test_idle_run(1, pass_us);
+	isr_ns = Test_idle_run(0, pass_us);
+
+	printf("Idle bus in a 6 byte read, %u us loop: polled %llu ns, from the ISR %llu ns\n", pass_us,
+		   (unsigned long long)polled_ns, (unsigned long long)isr_ns);
+	// a loop pass for each of the nine bytes, addresses included
+	CHECK(polled_ns >= 9ULL * pass_us * 1000, "polled idle %llu ns, under a loop pass a byte",
+		  (unsigned long long)polled_ns);
+	CHECK(isr_ns == 0, "idle %llu ns with the ISR", (unsigned long long)isr_ns);
+}
+
+//queue a burst of reads and run them to the end, the polled way or from
+//the ISR, with the rest of the loop taking pass_us each time round
+static void Test_gap_run(uint8_t polled, uint32_t pass_us)
+{
+	uint16_t i;
+	uint8_t j;
+
+	Test_reset();
+	if(polled)
+	{
+		// what I2C_init() leaves with I2C_POLLED
+		NVIC->ICER[0] = 1UL << I2C0_IRQn;
+	}
+	for(j = 0; j < I2C_QUEUE_SIZE; j++)
+	{
+		Test_read(OUT_X_MSB, 6, I2C_PRI_HIGH, j);
+	}
+	for(i = 0; (i < 2000) && (done_n < I2C_QUEUE_SIZE); i++)
+	{
+		if(polled)
+		{
+			Fake_poll(&q);
+		}
+		else
+		{
+			Fake_run(&q);
+		}
+		fake.ns += (uint64_t)pass_us * 1000;
+		Check_I2C_Callback(&q);
+	}
+	CHECK((done_n == I2C_QUEUE_SIZE) && (q.errors == 0), "%s: %u of %u jobs, %u errors", (polled) ? "polled" : "ISR",
+		  done_n, I2C_QUEUE_SIZE, q.errors);
+	CHECK(fake.gaps == I2C_QUEUE_SIZE - 1, "%s: %u STOP to START gaps", (polled) ? "polled" : "ISR", fake.gaps);
+}
+
+static void Test_gap(void)
+{
+	uint64_t polled_ns, polled_max, isr_ns, isr_max, bus_ns;
+	const uint32_t pass_us = 50;
+
+	// The polled master only sees STOPF on its next pass, so the bus sits
+	// idle for a loop pass between jobs.  The ISR starts the next job off
+	// the STOPF interrupt.
+	Test_gap_run(1, pass_us);
+	polled_ns = fake.gap_ns / fake.gaps;
+	polled_max = fake.gap_max_ns;
+	Test_gap_run(0, pass_us);
+	isr_ns = fake.gap_ns / fake.gaps;
+	isr_max = fake.gap_max_ns;
+	bus_ns = fake.bus_ns / I2C_QUEUE_SIZE;
+
+	printf("STOP to START, %u us loop: polled %llu ns (max %llu), STOPF chained %llu ns (max %llu), "
+		   "%llu ns of bus per 6 byte read\n", pass_us, (unsigned long long)polled_ns,
+		   (unsigned long long)polled_max, (unsigned long long)isr_ns, (unsigned long long)isr_max,
+		   (unsigned long long)bus_ns);
+	CHECK(isr_max < polled_ns, "chained gap %llu ns not under the polled %llu ns", (unsigned long long)isr_max,
+		  (unsigned long long)polled_ns);
+	CHECK(isr_max < FAKE_BIT_NS, "chained gap %llu ns, over a bit time", (unsigned long long)isr_max);
+}
+
+int main(void)
+{
+	Test_isr();
+	Test_priority();
+	Test_recover();
+	Test_idle();
+	Test_gap();
+
+	return(TEST_DONE());
+}
@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# Fail if the heap is linked into the image.  Run by hand on a map from
+# the IDE build:
+#
+#   make -C test mapcheck MAP=../Debug/Gabe_challenge.map
+#
+# Only symbols the linker placed are matched ("<address> <symbol>" lines
+# in the memory map), so sections --gc-sections discarded don't count.
+# The project links Redlib (semihost_nf).  The list is the standard
+# allocator entry points plus the newlib _r and _sbrk names.  It has only
+# been tried on hand written map excerpts, not a real Redlib map, so it
+# isn't a post-build step yet.
+#
+
+map="$1"
+syms='malloc|_malloc_r|calloc|_calloc_r|realloc|_realloc_r|free|_free_r|_sbrk|_sbrk_r'
+
+if [ ! -f "$map" ]; then
+	echo "mapcheck: no map file $map" >&2
+	exit 2
+fi
+
+if grep -E "^ +0x[0-9a-fA-F]+ +($syms)\$" "$map"; then
+	echo "mapcheck: $map links the heap" >&2
+	exit 1
+fi
+
+echo "mapcheck: $map has no heap"
+exit 0
@@ -0,0 +1,45 @@
+#!/bin/sh
+#
+# Print the size of .text from each linker map, the part of it that came
+# from fmt.o, and the difference in .text between the first map and the
+# rest:
+#
+#   sh mapsize.sh fmt_size.map fmt_size_sprintf.map
+#
+# The total is the one on the .text output section line, which is what
+# the image holds after --gc-sections.  The fmt.o part adds up its .text
+# input sections, whose line is split in two when the name is long.
+#
+
+first=""
+
+for map in "$@"; do
+	if [ ! -f "$map" ]; then
+		echo "mapsize: no map file $map" >&2
+		exit 2
+	fi
+
+	size=$(awk '/^\.text[ \t]+0x/ { print $3; exit }
+				/^\.text$/ { getline; print $2; exit }' "$map")
+	if [ -z "$size" ]; then
+		echo "mapsize: no .text in $map" >&2
+		exit 2
+	fi
+	size=$((size))
+
+	fmt=0
+	for s in $(awk '/^ \.text[^ \t]*$/ { name = 1; next }
+					name && (NF == 3) && ($3 ~ /(^|\/)fmt\.o$/) { print $2 }
+					/^ \.text/ && (NF == 4) && ($4 ~ /(^|\/)fmt\.o$/) { print $3 }
+					{ name = 0 }' "$map"); do
+		fmt=$((fmt + s))
+	done
+
+	if [ -z "$first" ]; then
+		first=$size
+		echo "$map: .text $size bytes, $fmt from fmt.o"
+	else
+		echo "$map: .text $size bytes, $fmt from fmt.o, $((size - first)) more than $1"
+	fi
+done
+exit 0
@@ -0,0 +1,662 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file mma8451q_test.c
+* @brief Host test of the MMA8451Q driver against the register level fake
+*
+* Runs the driver with i2c.c over fake_mma8451q.c and checks what went
+* over the bus as well as what came out of the driver.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fake_mma8451q.h"
+#include "test.h"
+
+static MMA8451Q m;
+static I2C_Queue q;
+
+//power up with the given setup and run the init sequence
+static void Test_start(uint8_t fifo_wmrk, uint8_t int_pin, const MMA8451Q_CONFIG *cfg)
+{
+	uint16_t i;
+
+	Fake_reset();
+	memset(&m, 0, sizeof(m));
+	m.fifo_wmrk = fifo_wmrk;
+	m.int_pin = int_pin;
+	MMA8451Q_Configure(&m, (MMA8451Q_CONFIG *)cfg);
+	I2C_init(&q);
+
+	for(i = 0; (i < 1000) && (m.state != MMA8451Q_RUN); i++)
+	{
+		Fake_loop(&m, &q);
+	}
+	CHECK(m.state == MMA8451Q_RUN, "init did not finish");
+	CHECK(fake.reg[CTRL_REG1] & CTRL_REG1_ACTIVE, "not ACTIVE after init");
+	CHECK(fake.violations == 0, "%u writes the sensor would ignore", fake.violations);
+}
+
+//nothing the bus or the sensor would have objected to
+static void Test_clean(void)
+{
+	CHECK(fake.violations == 0, "%u writes the sensor would ignore", fake.violations);
+	CHECK(fake.acked_last == 0, "%u reads ACKed their last byte", fake.acked_last);
+	CHECK(fake.arbl == 0, "%u STARTs on a busy bus", fake.arbl);
+	CHECK(q.errors == 0, "%u I2C jobs failed", q.errors);
+}
+
+//transfers logged since mark that read the sample registers
+static uint32_t Test_reads(uint32_t mark, uint8_t reg, uint16_t len)
+{
+	uint32_t n = 0;
+	uint32_t i;
+
+	for(i = mark; i < fake.log_n; i++)
+	{
+		if(fake.log[i % FAKE_LOG_SIZE].rw && (fake.log[i % FAKE_LOG_SIZE].reg == reg) &&
+		   (fake.log[i % FAKE_LOG_SIZE].len == len))
+		{
+			n++;
+		}
+	}
+
+	return(n);
+}
+
+static void Test_burst(void)
+{
+	MMA8451Q_CONFIG cfg = {0};
+	MMA8451Q_DATA d;
+	uint32_t seq = 0;
+	uint32_t mark;
+	uint8_t i;
+
+	// 14 bit: one transaction from STATUS for the flag and all six bytes
+	Test_start(0, 0, &cfg);
+	CHECK(fake.reg[CTRL_REG1] == CTRL_REG1_ACTIVE, "CTRL_REG1 0x%02x", fake.reg[CTRL_REG1]);
+	Fake_sample(1234 * 4, -2345 * 4, 4095 * 4);
+	mark = fake.log_n;
+	Fake_loop(&m, &q);
+	Fake_loop(&m, &q);
+	CHECK(MMA8451Q_Read_Sample(&m, &d, &seq), "no sample");
+	CHECK((d.x_data == 1234 * 4) && (d.y_data == -2345 * 4) && (d.z_data == 4095 * 4),
+		  "sample %d %d %d", d.x_data, d.y_data, d.z_data);
+	CHECK(Test_reads(mark, STATUS, 7) == (fake.log_n - mark), "%u of %u transfers were 7 byte bursts",
+		  Test_reads(mark, STATUS, 7), fake.log_n - mark);
+	CHECK(m.reads_done == m.reads_queued, "reads %u queued %u", m.reads_done, m.reads_queued);
+
+	// every burst returns the sample that was there when it started
+	for(i = 0; i < 50; i++)
+	{
+		Fake_sample(i * 4, -i * 4, 16384 - (i * 4));
+		Fake_loop(&m, &q);
+		Fake_loop(&m, &q);
+		MMA8451Q_Read_Sample(&m, &d, &seq);
+		CHECK((d.x_data == i * 4) && (d.y_data == -i * 4) && (d.z_data == 16384 - (i * 4)),
+			  "sample %u: %d %d %d", i, d.x_data, d.y_data, d.z_data);
+	}
+
+	// polls with no new conversion publish nothing
+	Fake_loop(&m, &q);
+	Fake_loop(&m, &q);
+	CHECK(!MMA8451Q_Read_Sample(&m, &d, &seq), "sample published without ZYXDR");
+	Test_clean();
+
+	// F_READ: the auto-increment skips the LSBs, STATUS and three bytes
+	cfg.f_read = 1;
+	cfg.odr = MMA8451Q_ODR_100HZ;
+	Test_start(0, 0, &cfg);
+	CHECK(fake.reg[CTRL_REG1] == (CTRL_REG1_ACTIVE | CTRL_REG1_F_READ | (MMA8451Q_ODR_100HZ << CTRL_REG1_DR_SHIFT)),
+		  "CTRL_REG1 0x%02x", fake.reg[CTRL_REG1]);
+	Fake_sample(0x1234, -0x2344, 0x4000);
+	mark = fake.log_n;
+	Fake_loop(&m, &q);
+	Fake_loop(&m, &q);
+	CHECK(MMA8451Q_Read_Sample(&m, &d, &seq), "no sample");
+	CHECK((d.x_data == 0x1200) && (d.y_data == -0x2400) && (d.z_data == 0x4000),
+		  "F_READ sample %d %d %d", d.x_data, d.y_data, d.z_data);
+	CHECK(Test_reads(mark, STATUS, 4) == (fake.log_n - mark), "%u of %u transfers were 4 byte bursts",
+		  Test_reads(mark, STATUS, 4), fake.log_n - mark);
+	Test_clean();
+}
+
+static uint8_t got[6];
+static uint8_t got_n;
+
+static uint8_t Test_got_cb(uint8_t *data, uint8_t count, void *context)
+{
+	memcpy(&got[(uintptr_t)context], data, count);
+	got_n += count;
+
+	return 0;
+}
+
+//Read 32 samples as reads of len bytes from OUT_X_MSB on, with a packet
+//of the test's own.  Returns the bus time per sample in ns.
+static uint64_t Test_bus_reads(uint8_t len)
+{
+	I2C_Packet p = {0};
+	uint64_t t = fake.bus_ns;
+	int16_t v[3];
+	uint8_t i, k;
+
+	p.slaveAddress = MMA8451Q_ADDR;
+	p.byteCount = len;
+	p.priority = I2C_PRI_HIGH;
+	p.i2c_callback = Test_got_cb;
+	for(i = 0; i < 32; i++)
+	{
+		Fake_sample(i * 4, -i * 4, 16384 - (i * 4));
+		got_n = 0;
+		for(k = 0; k < 6; k += len)
+		{
+			p.command = OUT_X_MSB + k;
+			p.context = (void *)(uintptr_t)k;
+			I2C_Read(&q, &p);
+			Fake_run(&q);
+		}
+		Check_I2C_Callback(&q);
+		for(k = 0; k < 3; k++)
+		{
+			v[k] = (int16_t)((got[2 * k] << 8) | got[(2 * k) + 1]);
+		}
+		CHECK((got_n == 6) && (v[0] == i * 4) && (v[1] == -i * 4) && (v[2] == 16384 - (i * 4)),
+			  "%u byte reads, sample %u: %u bytes, %d %d %d", len, i, got_n, v[0], v[1], v[2]);
+	}
+
+	return((fake.bus_ns - t) / 32);
+}
+
+//Bus time per sample: the six single register reads the driver used to
+//make, each a transfer of its own, against the one auto-increment burst.
+static void Test_bus_time(void)
+{
+	MMA8451Q_CONFIG cfg = {0};
+	uint64_t single_ns, burst_ns;
+
+	Test_start(0, 0, &cfg);
+	single_ns = Test_bus_reads(1);
+	burst_ns = Test_bus_reads(6);
+	Test_clean();
+
+	printf("Bus per sample at %u kHz: 6 single reads %u bits %.1f us (%.0f samples/s), "
+		   "one burst %u bits %.1f us (%.0f samples/s)\n", 1000000 / FAKE_BIT_NS,
+		   (unsigned)(single_ns / FAKE_BIT_NS), single_ns / 1000.0, 1e9 / single_ns,
+		   (unsigned)(burst_ns / FAKE_BIT_NS), burst_ns / 1000.0, 1e9 / burst_ns);
+	CHECK(burst_ns * 2 < single_ns, "burst %llu ns a sample, six single reads %llu ns",
+		  (unsigned long long)burst_ns, (unsigned long long)single_ns);
+}
+
+//Feed a known sequence, one conversion every other pass, and check the
+//blocks that come out of the FIFO are in order with nothing repeated.
+//Returns the number of gaps, where samples were lost.
+static uint16_t Test_stream(uint16_t samples, uint16_t hold)
+{
+	uint16_t sent = 0;
+	uint16_t next = 0;
+	uint16_t gaps = 0;
+	uint16_t i, j;
+
+	for(i = 0; (i < 4 * samples) || m.block.ready; i++)
+	{
+		if(((i & 1) == 0) && (sent < samples))
+		{
+			Fake_sample(sent * 4, -sent * 4, 16384 - (sent * 4));
+			sent++;
+		}
+		Fake_loop(&m, &q);
+
+		// the consumer sits on the block for a while
+		if(m.block.ready && ((i % hold) == 0))
+		{
+			CHECK(m.block.count >= m.fifo_wmrk, "block of %u samples", m.block.count);
+			for(j = 0; j < m.block.count; j++, next++)
+			{
+				if(m.block.x[j] > next * 4)
+				{
+					// lost to an overflow, skip ahead
+					next = m.block.x[j] / 4;
+					gaps++;
+				}
+				CHECK((m.block.x[j] == next * 4) && (m.block.y[j] == -next * 4) && (m.block.z[j] == 16384 - (next * 4)),
+					  "sample %u: %d %d %d", next, m.block.x[j], m.block.y[j], m.block.z[j]);
+			}
+			m.block.ready = 0;
+		}
+	}
+
+	// what is left is below the watermark
+	CHECK((next + fake.f_cnt) == sent, "up to sample %u out, %u still in the FIFO, %u sent", next, fake.f_cnt, sent);
+
+	return(gaps);
+}
+
+static void Test_fifo(void)
+{
+	MMA8451Q_CONFIG cfg = {0};
+	FAKE_XFER *x;
+	uint16_t gaps;
+	uint32_t i;
+
+	Test_start(16, 0, &cfg);
+	CHECK(fake.reg[F_SETUP] == (F_SETUP_F_MODE_CIRC | 16), "F_SETUP 0x%02x", fake.reg[F_SETUP]);
+	gaps = Test_stream(600, 1);
+	CHECK(gaps == 0, "%u gaps in the samples", gaps);
+	CHECK((fake.underruns == 0) && (m.fifo_ovf == 0), "%u FIFO underruns, %u overflows", fake.underruns, m.fifo_ovf);
+
+	// every drain is one burst from OUT_X_MSB of whole samples
+	for(i = (fake.log_n > FAKE_LOG_SIZE) ? (fake.log_n - FAKE_LOG_SIZE) : 0; i < fake.log_n; i++)
+	{
+		x = &fake.log[i % FAKE_LOG_SIZE];
+		if(x->rw && (x->reg == OUT_X_MSB))
+		{
+			CHECK(((x->len % 6) == 0) && (x->len >= 16 * 6), "FIFO read of %u bytes", x->len);
+		}
+	}
+	Test_clean();
+
+	// a consumer that falls behind loses samples to the circular FIFO,
+	// and the driver counts the overflow
+	Test_start(16, 0, &cfg);
+	gaps = Test_stream(600, 80);
+	CHECK((gaps != 0) && (m.fifo_ovf == gaps), "%u gaps, %u FIFO overflows counted", gaps, m.fifo_ovf);
+	CHECK(fake.underruns == 0, "%u FIFO underruns", fake.underruns);
+	Test_clean();
+
+	// a watermark past the FIFO is cut to a full FIFO, not masked into
+	// F_SETUP and a burst longer than the block
+	Test_start(MMA8451Q_FIFO_SIZE + 8, 1, &cfg);
+	CHECK(m.fifo_wmrk == MMA8451Q_FIFO_SIZE, "fifo_wmrk %u", m.fifo_wmrk);
+	CHECK(fake.reg[F_SETUP] == (F_SETUP_F_MODE_CIRC | MMA8451Q_FIFO_SIZE), "F_SETUP 0x%02x", fake.reg[F_SETUP]);
+	gaps = Test_stream(600, 1);
+	CHECK(gaps == 0, "%u gaps in the samples", gaps);
+	CHECK((fake.underruns == 0) && (m.fifo_ovf == 0), "%u FIFO underruns, %u overflows", fake.underruns, m.fifo_ovf);
+	Test_clean();
+}
+
+//the register writes logged from mark on, in order
+static uint8_t Test_writes(uint32_t mark, uint8_t *reg, uint8_t *val, uint8_t max)
+{
+	FAKE_XFER *x;
+	uint8_t n = 0;
+	uint32_t i;
+
+	for(i = mark; (i < fake.log_n) && (n < max); i++)
+	{
+		x = &fake.log[i % FAKE_LOG_SIZE];
+		if(!x->rw && (x->len == 1))
+		{
+			reg[n] = x->reg;
+			val[n] = x->data[0];
+			n++;
+		}
+	}
+
+	return(n);
+}
+
+//Reconfigure part way through a FIFO stream, with an F_STATUS read on the
+//bus and samples waiting in the FIFO.  The sensor has to see STANDBY first
+//and ACTIVE last, and every sample made before or after comes out once, in
+//order, while m.cfg still has the range it was made at.
+static void Test_reconfig(uint8_t int_pin)
+{
+	static uint8_t range[1000];
+	MMA8451Q_CONFIG cfg = {0};
+	const MMA8451Q_CONFIG next_cfg = {MMA8451Q_ODR_100HZ, MMA8451Q_MODS_HIRES, MMA8451Q_RANGE_8G, 1};
+	const uint8_t order[] = {CTRL_REG1, CTRL_REG2, F_SETUP, F_SETUP, XYZ_DATA_CFG, CTRL_REG4, CTRL_REG5, CTRL_REG1};
+	const uint8_t ctrl_reg1 = (MMA8451Q_ODR_100HZ << CTRL_REG1_DR_SHIFT);
+	const uint8_t value[] =
+	{
+		0, MMA8451Q_MODS_HIRES, 0, F_SETUP_F_MODE_CIRC | 16, MMA8451Q_RANGE_8G,
+		(int_pin) ? CTRL_REG4_INT_EN_FIFO : 0, (int_pin == 1) ? CTRL_REG5_INT_CFG_FIFO : 0, ctrl_reg1 | CTRL_REG1_ACTIVE
+	};
+	uint8_t reg[16], val[16];
+	uint32_t mark = 0;
+	uint16_t next = 0;
+	uint16_t n, i, j;
+	uint8_t w;
+
+	Test_start(16, int_pin, &cfg);
+	for(i = 0; (i < 1200) || m.block.ready || (m.state != MMA8451Q_RUN); i++)
+	{
+		n = fake.samples;
+		if(((i & 1) == 0) && (i < 1200) && (n < sizeof(range)))
+		{
+			range[n] = fake.reg[XYZ_DATA_CFG] & XYZ_DATA_CFG_FS_MASK;
+			Fake_sample(n * 4, -n * 4, 8192 - (n * 4));
+		}
+
+		if((mark == 0) && (i >= 300) && (fake.f_cnt >= 16) && !m.block.ready && (m.pending == 0) &&
+		   (m.reads_queued == m.reads_done))
+		{
+			// a watermark waiting, and the F_STATUS read that will see it
+			// or the FIFO read the INT pin starts is on the queue
+			Update_MMA8451Q(&m, &q);
+			Fake_int(&m, &q);
+			CHECK((int_pin != 0) ? (m.reads_queued != m.reads_done) : (m.pending == 1), "INT%u: no read queued",
+				  int_pin);
+			mark = fake.log_n;
+			MMA8451Q_Configure(&m, (MMA8451Q_CONFIG *)&next_cfg);
+			Fake_run(&q);
+			Check_I2C_Callback(&q);
+		}
+		Fake_loop(&m, &q);
+
+		if(m.block.ready && (i & 4))
+		{
+			for(j = 0; j < m.block.count; j++, next++)
+			{
+				CHECK((m.block.x[j] == next * 4) && (m.block.y[j] == -next * 4) && (m.block.z[j] == 8192 - (next * 4)),
+					  "INT%u sample %u: %d %d %d", int_pin, next, m.block.x[j], m.block.y[j], m.block.z[j]);
+				CHECK(MMA8451Q_One_G(&m) == (MMA8451Q_ONE_G >> range[next]), "INT%u sample %u at range %u read at %u",
+					  int_pin, next, range[next], m.cfg.range);
+			}
+			m.block.ready = 0;
+		}
+		if(i >= 2000)
+		{
+			break;
+		}
+	}
+	CHECK((mark != 0) && (m.state == MMA8451Q_RUN), "INT%u: not reconfigured", int_pin);
+	CHECK((next + fake.f_cnt) == fake.samples, "INT%u: up to sample %u out, %u still in the FIFO, %u made",
+		  int_pin, next, fake.f_cnt, fake.samples);
+	CHECK((m.fifo_ovf == 0) && (fake.underruns == 0), "INT%u: %u overflows, %u underruns", int_pin, m.fifo_ovf,
+		  fake.underruns);
+
+	// STANDBY at the old rate, the new configuration, then ACTIVE and
+	// nothing else
+	w = Test_writes(mark, reg, val, sizeof(reg));
+	CHECK(w == sizeof(order), "INT%u: %u register writes", int_pin, w);
+	for(j = 0; j < sizeof(order); j++)
+	{
+		CHECK((reg[j] == order[j]) && (val[j] == value[j]), "INT%u write %u: 0x%02x to 0x%02x, want 0x%02x to 0x%02x",
+			  int_pin, j, val[j], reg[j], value[j], order[j]);
+	}
+	Test_clean();
+}
+
+//The CTRL_REG1 ACTIVE write at the end of the init sequence is NACKed.
+//The driver has to notice, go through the sequence again from STANDBY and
+//end up with the sensor ACTIVE and samples coming in.
+static void Test_write_fail(uint8_t fifo_wmrk, uint8_t int_pin)
+{
+	MMA8451Q_CONFIG cfg = {0};
+	MMA8451Q_DATA d;
+	uint32_t seq = 0;
+	uint16_t i;
+
+	Fake_reset();
+	memset(&m, 0, sizeof(m));
+	m.fifo_wmrk = fifo_wmrk;
+	m.int_pin = int_pin;
+	fake.nack_reg = CTRL_REG1;
+	fake.nack_skip = 1;
+	fake.nack_writes = 1;
+	MMA8451Q_Configure(&m, &cfg);
+	I2C_init(&q);
+
+	for(i = 0; (i < 1000) && ((m.state != MMA8451Q_RUN) || (m.pending != 0)); i++)
+	{
+		Fake_loop(&m, &q);
+	}
+	CHECK(fake.nack_writes == 0, "FIFO %u INT%u: the ACTIVE write was never sent", fifo_wmrk, int_pin);
+	CHECK((m.write_fails == 1) && (q.errors == 1), "FIFO %u INT%u: %u write fails, %u I2C errors", fifo_wmrk, int_pin,
+		  m.write_fails, q.errors);
+	CHECK((m.state == MMA8451Q_RUN) && (fake.reg[CTRL_REG1] & CTRL_REG1_ACTIVE), "FIFO %u INT%u: state %u, CTRL_REG1 0x%02x",
+		  fifo_wmrk, int_pin, m.state, fake.reg[CTRL_REG1]);
+	CHECK(fake.violations == 0, "FIFO %u INT%u: %u writes the sensor would ignore", fifo_wmrk, int_pin, fake.violations);
+
+	// and the samples come in
+	for(i = 0; (i < 200) && (m.block.ready == 0) && (seq == 0); i++)
+	{
+		Fake_sample(100, -100, 16384);
+		Fake_loop(&m, &q);
+		if(fifo_wmrk == 0)
+		{
+			MMA8451Q_Read_Sample(&m, &d, &seq);
+		}
+	}
+	CHECK(m.block.ready || (seq != 0), "FIFO %u INT%u: no samples after the failed write", fifo_wmrk, int_pin);
+}
+
+//every new sample is read exactly once, and nothing is read in between
+static void Test_drdy(uint8_t pin)
+{
+	MMA8451Q_DATA d;
+	uint32_t seq = 0;
+	uint32_t mark;
+	uint16_t i;
+	uint8_t j;
+
+	for(i = 0; i < 200; i++)
+	{
+		mark = fake.log_n;
+		for(j = 0; j < 5; j++)
+		{
+			Fake_loop(&m, &q);
+		}
+		CHECK(fake.log_n == mark, "pin %u: %u transfers with no new sample", pin, fake.log_n - mark);
+		CHECK(!MMA8451Q_Read_Sample(&m, &d, &seq), "pin %u: sample %u published twice", pin, i);
+
+		Fake_sample(i * 4, 100, -i * 4);
+		for(j = 0; j < 5; j++)
+		{
+			Fake_loop(&m, &q);
+		}
+		CHECK((fake.log_n - mark) == 1, "pin %u sample %u: %u transfers", pin, i, fake.log_n - mark);
+		CHECK(Test_reads(mark, OUT_X_MSB, 6) == 1, "pin %u sample %u: not read from OUT_X_MSB", pin, i);
+		CHECK(MMA8451Q_Read_Sample(&m, &d, &seq) && (d.x_data == i * 4) && (d.z_data == -i * 4),
+			  "pin %u sample %u: %d %d %d", pin, i, d.x_data, d.y_data, d.z_data);
+	}
+}
+
+static void Test_int(void)
+{
+	MMA8451Q_CONFIG cfg = {0};
+	uint32_t mark;
+	uint16_t gaps;
+
+	// data ready on INT1 (PTA14)
+	Test_start(0, 1, &cfg);
+	CHECK((fake.reg[CTRL_REG4] == CTRL_REG4_INT_EN_DRDY) && (fake.reg[CTRL_REG5] == CTRL_REG5_INT_CFG_DRDY),
+		  "CTRL_REG4 0x%02x CTRL_REG5 0x%02x", fake.reg[CTRL_REG4], fake.reg[CTRL_REG5]);
+	Fake_loop(&m, &q);
+	CHECK(fake.irq_en & (1UL << PORTA_IRQn), "PORTA IRQ not enabled");
+	CHECK(PORTA->PCR[MMA8451Q_INT1_PIN] == (PORT_PCR_MUX(1) | PORT_PCR_IRQC(8)), "PTA14 PCR 0x%08x",
+		  PORTA->PCR[MMA8451Q_INT1_PIN]);
+	Test_drdy(1);
+	Test_clean();
+
+	// data ready on INT2 (PTA15)
+	Test_start(0, 2, &cfg);
+	CHECK((fake.reg[CTRL_REG4] == CTRL_REG4_INT_EN_DRDY) && (fake.reg[CTRL_REG5] == 0),
+		  "CTRL_REG4 0x%02x CTRL_REG5 0x%02x", fake.reg[CTRL_REG4], fake.reg[CTRL_REG5]);
+	Test_drdy(2);
+	Test_clean();
+
+	// FIFO watermark on INT1: one burst per watermark and no F_STATUS polling
+	Test_start(16, 1, &cfg);
+	CHECK((fake.reg[CTRL_REG4] == CTRL_REG4_INT_EN_FIFO) && (fake.reg[CTRL_REG5] == CTRL_REG5_INT_CFG_FIFO),
+		  "CTRL_REG4 0x%02x CTRL_REG5 0x%02x", fake.reg[CTRL_REG4], fake.reg[CTRL_REG5]);
+	mark = fake.log_n;
+	gaps = Test_stream(640, 1);
+	CHECK((gaps == 0) && (fake.underruns == 0), "%u gaps, %u FIFO underruns", gaps, fake.underruns);
+	CHECK((fake.log_n - mark) == (640 / 16), "%u transfers for %u watermarks", fake.log_n - mark, 640 / 16);
+	CHECK(Test_reads(mark, OUT_X_MSB, 16 * 6) == (640 / 16), "%u of %u transfers were 16 sample bursts",
+		  Test_reads(mark, OUT_X_MSB, 16 * 6), fake.log_n - mark);
+	Test_clean();
+}
+
+//the offsets for a known bias at each range, 2mg per LSB whatever the range
+static void Test_zero_offsets(void)
+{
+	static const int16_t bias_mg[3] = {37, -81, 55};
+	int32_t one_g, sum[3];
+	int8_t off[3];
+	uint8_t r, a;
+
+	for(r = 0; r < 3; r++)
+	{
+		one_g = MMA8451Q_ONE_G >> r;
+		for(a = 0; a < 3; a++)
+		{
+			sum[a] = 100 * ((bias_mg[a] * one_g) / 1000 + ((a == 2) ? one_g : 0));
+		}
+		MMA8451Q_Zero_Offsets(sum, 100, (MMA8451Q_RANGE)r, off);
+		for(a = 0; a < 3; a++)
+		{
+			CHECK(abs(bias_mg[a] + (off[a] * MMA8451Q_OFF_MG_PER_LSB)) <= 1, "range %u axis %u: %d mg left",
+				  r, a, bias_mg[a] + (off[a] * MMA8451Q_OFF_MG_PER_LSB));
+		}
+	}
+
+	// past what the registers hold, clamped instead of wrapped
+	sum[0] = 16384;
+	sum[1] = -16384;
+	sum[2] = 16384;
+	MMA8451Q_Zero_Offsets(sum, 1, MMA8451Q_RANGE_2G, off);
+	CHECK((off[0] == INT8_MIN) && (off[1] == INT8_MAX) && (off[2] == 0), "offsets %d %d %d", off[0], off[1], off[2]);
+}
+
+//flat board with the sensor's own bias, x alternates +/-64 around it so a
+//sample counted twice would show in the sums
+static void Test_zero_run(uint16_t n)
+{
+	uint32_t mark;
+	uint16_t k = 0;
+	uint16_t i;
+
+	for(i = 0; (i < 2000) && (m.state != MMA8451Q_RUN); i++)
+	{
+		// a conversion every third pass, the STATUS polls in between find nothing new
+		if((i % 3) == 0)
+		{
+			Fake_sample((k & 1) ? 64 : -64, 0, 16384);
+			k++;
+		}
+		mark = fake.log_n;
+		Fake_loop(&m, &q);
+
+		// sampling happens with the FIFO off, since FIFO reads pop samples
+		if(Test_reads(mark, STATUS, 7) != 0)
+		{
+			CHECK((fake.reg[F_SETUP] & 0xC0) == 0, "FIFO on while sampling, F_SETUP 0x%02x", fake.reg[F_SETUP]);
+			CHECK(fake.reg[OFF_X] == 0 && fake.reg[OFF_Y] == 0 && fake.reg[OFF_Z] == 0, "offsets not cleared");
+		}
+	}
+	CHECK(m.state == MMA8451Q_RUN, "auto zero did not finish");
+	CHECK((m.zero.sum[0] == (int32_t)n * fake.bias[0]) && (m.zero.sum[1] == (int32_t)n * fake.bias[1]) &&
+		  (m.zero.sum[2] == (int32_t)n * (16384 + fake.bias[2])),
+		  "sums %d %d %d", (int)m.zero.sum[0], (int)m.zero.sum[1], (int)m.zero.sum[2]);
+}
+
+//what the offset registers should hold for the bias, 2mg per LSB at 2g
+static void Test_zero_check(void)
+{
+	int16_t v;
+	uint16_t i, j;
+	uint8_t a;
+
+	for(a = 0; a < 3; a++)
+	{
+		v = (int16_t)-lround(fake.bias[a] * 1000.0 / (16384 * 2));
+		CHECK(((int8_t)fake.reg[OFF_X + a] == v) && (m.zero.off[a] == v), "axis %u: OFF %d, driver %d, expected %d",
+			  a, (int8_t)fake.reg[OFF_X + a], m.zero.off[a], v);
+	}
+	CHECK(fake.reg[F_SETUP] == (F_SETUP_F_MODE_CIRC | 16), "FIFO not back on, F_SETUP 0x%02x", fake.reg[F_SETUP]);
+
+	// the sensor now reads flat by itself, to within half an offset LSB
+	for(i = 0; (i < 200) && !m.block.ready; i++)
+	{
+		Fake_sample(0, 0, 16384);
+		Fake_loop(&m, &q);
+	}
+	CHECK(m.block.ready, "no samples after the auto zero");
+	for(j = 0; j < m.block.count; j++)
+	{
+		CHECK((abs(m.block.x[j]) <= 20) && (abs(m.block.y[j]) <= 20) && (abs(m.block.z[j] - 16384) <= 20),
+			  "zeroed sample %d %d %d", m.block.x[j], m.block.y[j], m.block.z[j]);
+	}
+	m.block.ready = 0;
+}
+
+static void Test_zero(void)
+{
+	MMA8451Q_CONFIG cfg = {0};
+	uint16_t i;
+
+	// asked for before the first Update_MMA8451Q(), as main() does
+	Fake_reset();
+	memset(&m, 0, sizeof(m));
+	m.fifo_wmrk = 16;
+	m.int_pin = 1;
+	MMA8451Q_Configure(&m, &cfg);
+	MMA8451Q_Auto_Zero(&m, 32);
+	I2C_init(&q);
+	fake.bias[0] = 400;
+	fake.bias[1] = -600;
+	fake.bias[2] = 1000;
+	Test_zero_run(32);
+	Test_zero_check();
+	Test_clean();
+
+	// and again while running, after the bias has drifted
+	fake.bias[0] = -1200;
+	fake.bias[2] = 200;
+	MMA8451Q_Auto_Zero(&m, 64);
+	Test_zero_run(64);
+	Test_zero_check();
+	Test_clean();
+
+	// a reconfigure part way through starts the sampling over, as the
+	// samples so far were made with the old configuration
+	MMA8451Q_Auto_Zero(&m, 64);
+	for(i = 0; (i < 2000) && ((m.state != MMA8451Q_ZERO) || (m.zero.cnt < 20)); i++)
+	{
+		Fake_sample(0, 0, 16384);
+		Fake_loop(&m, &q);
+	}
+	CHECK((m.state == MMA8451Q_ZERO) && (m.zero.sum[2] != 0), "auto zero not sampling");
+	MMA8451Q_Configure(&m, &cfg);
+	CHECK((m.zero.cnt == 0) && (m.zero.sum[0] == 0) && (m.zero.sum[1] == 0) && (m.zero.sum[2] == 0),
+		  "sampling not started over, %u samples kept", m.zero.cnt);
+	fake.bias[0] = 700;
+	fake.bias[1] = 300;
+	fake.bias[2] = -500;
+	Test_zero_run(64);
+	Test_zero_check();
+	Test_clean();
+}
+
+int main(void)
+{
+	Test_burst();
+	Test_bus_time();
+	Test_fifo();
+	Test_int();
+	Test_reconfig(0);
+	Test_reconfig(1);
+	Test_write_fail(0, 0);
+	Test_write_fail(16, 1);
+	Test_zero_offsets();
+	Test_zero();
+
+	return(TEST_DONE());
+}
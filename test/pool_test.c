@@ -0,0 +1,155 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file pool_test.c
+* @brief Host test of the block pool
+*
+* Built twice, pool_debug_test with DEBUG defined for the double free
+* check.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <stdalign.h>
+#include <stdint.h>
+#include <string.h>
+#include "pool.h"
+#include "test.h"
+
+#define OBJS	5
+
+typedef struct
+{
+	char c;
+	double d;
+} OBJ;
+
+typedef struct
+{
+	double d[3];
+} OBJ24;
+
+POOL_DEFINE(objs, OBJ, OBJS);
+POOL_DEFINE(bytes, char, 3);
+POOL_DEFINE(others, OBJ, 2);
+POOL_DEFINE(odd, OBJ24, 3);
+
+static void Test_exhaust(void)
+{
+	OBJ *o[OBJS + 1];
+	int i, j;
+
+	CHECK((objs.size % sizeof(void *)) == 0, "block size %u", objs.size);
+	CHECK(bytes.size >= sizeof(void *), "char block size %u", bytes.size);
+	// rounded up to a power of 2 for the mask in Pool_free()
+	CHECK(odd.size == 32, "24 byte type in %u byte blocks", odd.size);
+	CHECK(((objs.size & (objs.size - 1)) == 0) && ((bytes.size & (bytes.size - 1)) == 0), "block sizes %u %u",
+		  objs.size, bytes.size);
+
+	for(i = 0; i < OBJS; i++)
+	{
+		o[i] = Pool_alloc(&objs);
+		CHECK(o[i] != 0, "block %d of %d not handed out", i, OBJS);
+		CHECK(((uintptr_t)o[i] % alignof(OBJ)) == 0, "block %d misaligned", i);
+		// every block is whole and doesn't overlap the others
+		memset(o[i], i, sizeof(OBJ));
+	}
+	o[OBJS] = Pool_alloc(&objs);
+	CHECK(o[OBJS] == 0, "empty pool handed out a block");
+
+	for(i = 0; i < OBJS; i++)
+	{
+		for(j = 0; j < (int)sizeof(OBJ); j++)
+		{
+			CHECK(((char *)o[i])[j] == i, "block %d overwritten", i);
+		}
+	}
+
+	// freed blocks come back last in, first out, and nothing else does
+	CHECK(Pool_free(&objs, o[1]) == 0, "free block 1");
+	CHECK(Pool_free(&objs, o[3]) == 0, "free block 3");
+	CHECK(Pool_alloc(&objs) == o[3], "realloc didn't give block 3");
+	CHECK(Pool_alloc(&objs) == o[1], "realloc didn't give block 1");
+	CHECK(Pool_alloc(&objs) == 0, "pool not empty after realloc");
+
+	// all of them back, then all of them out again
+	for(i = 0; i < OBJS; i++)
+	{
+		CHECK(Pool_free(&objs, o[i]) == 0, "free block %d", i);
+	}
+	for(i = 0; i < OBJS; i++)
+	{
+		CHECK(Pool_alloc(&objs) != 0, "block %d not handed out again", i);
+	}
+	CHECK(Pool_alloc(&objs) == 0, "pool not empty the second time");
+}
+
+static void Test_reject(void)
+{
+	OBJ local;
+	OBJ *a, *b, *o;
+
+	a = Pool_alloc(&others);
+	o = Pool_alloc(&objs);
+
+	CHECK(Pool_free(&others, (char *)a + 1) == -1, "misaligned pointer accepted");
+	CHECK(Pool_free(&others, (char *)a + others.size - 1) == -1, "pointer into a block accepted");
+	CHECK(Pool_free(&others, &local) == -1, "stack pointer accepted");
+	CHECK(Pool_free(&others, 0) == -1, "null accepted");
+	CHECK(Pool_free(&others, o) == -1, "block of another pool accepted");
+	CHECK(Pool_free(&others, others.end) == -1, "end of the pool accepted");
+
+	// never handed out yet, so not this caller's to free
+	b = (OBJ *)(others.base + others.size);
+	CHECK(Pool_free(&others, b) == -1, "block never handed out accepted");
+
+	CHECK(Pool_free(&others, a) == 0, "good block refused");
+	CHECK(Pool_alloc(&others) == a, "freed block not reused");
+
+	// inside the handed out blocks but not at the start of one
+	a = Pool_alloc(&odd);
+	b = Pool_alloc(&odd);
+	CHECK(Pool_free(&odd, (char *)b - sizeof(OBJ24)) == -1, "pointer 24 bytes in accepted");
+	CHECK(Pool_free(&odd, (char *)b + 8) == -1, "pointer into the second block accepted");
+	CHECK(Pool_free(&odd, b) == 0, "second block refused");
+	CHECK(Pool_free(&odd, a) == 0, "first block refused");
+}
+
+//a double free is only caught in a DEBUG build, otherwise the block goes
+//on the free list twice
+static void Test_double_free(void)
+{
+	void *a, *b;
+
+	a = Pool_alloc(&bytes);
+	CHECK(Pool_free(&bytes, a) == 0, "free refused");
+#ifdef DEBUG
+	CHECK(Pool_free(&bytes, a) == -1, "double free accepted");
+	b = Pool_alloc(&bytes);
+	CHECK((b == a) && (Pool_alloc(&bytes) != a), "block handed out twice");
+#else
+	CHECK(Pool_free(&bytes, a) == 0, "double free refused without DEBUG");
+	b = Pool_alloc(&bytes);
+	CHECK((b == a) && (Pool_alloc(&bytes) == a), "double freed block not on the list twice");
+#endif
+}
+
+int main(void)
+{
+	Test_exhaust();
+	Test_reject();
+	Test_double_free();
+
+	return(TEST_DONE());
+}
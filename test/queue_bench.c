@@ -0,0 +1,99 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file queue_bench.c
+* @brief Host benchmark of QUEUE_DEFINE against ring_t
+*
+* A 12 byte sample record pushed then popped, values checked on every
+* pass.  Built with the stub's full fence and, as queue_fence_bench,
+* with STUB_COMPILER_FENCE.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include "queue.h"
+#include "ring.h"
+#include "test.h"
+
+#define BENCH_N		20000000
+
+typedef struct
+{
+	int16_t x, y, z, pad;
+	uint32_t seq;
+} SAMPLE;
+
+QUEUE_DEFINE(SAMPLE_QUEUE, Sample_queue, SAMPLE, 16)
+RING_DEFINE(rb, 256);
+
+static SAMPLE_QUEUE q;
+static volatile uint32_t sink;
+
+int main(void)
+{
+	SAMPLE s = { 1, 2, 3, 0, 0 };
+	SAMPLE o;
+	double t_q, t_c, t_b;
+	uint32_t acc = 0;
+	uint32_t errors = 0;
+	uint32_t k;
+	long i;
+
+	Sample_queue_init(&q);
+
+	t_q = Test_now();
+	for(i = 0; i < BENCH_N; i++)
+	{
+		s.seq = i;
+		Sample_queue_push(&q, &s);
+		Sample_queue_pop(&q, &o);
+		errors += (o.seq != (uint32_t)i);
+		acc += o.x;
+	}
+	t_q = Test_now() - t_q;
+
+	t_c = Test_now();
+	for(i = 0; i < BENCH_N; i++)
+	{
+		s.seq = i;
+		for(k = 0; k < sizeof(s); k++)
+		{
+			insert(&rb, ((const char *)&s)[k]);
+		}
+		for(k = 0; k < sizeof(o); k++)
+		{
+			extract(&rb, &((char *)&o)[k]);
+		}
+		errors += (o.seq != (uint32_t)i);
+		acc += o.x;
+	}
+	t_c = Test_now() - t_c;
+
+	t_b = Test_now();
+	for(i = 0; i < BENCH_N; i++)
+	{
+		s.seq = i;
+		insert_block(&rb, (const char *)&s, sizeof(s));
+		extract_block(&rb, (char *)&o, sizeof(o));
+		errors += (o.seq != (uint32_t)i);
+		acc += o.x;
+	}
+	t_b = Test_now() - t_b;
+
+	sink = acc;
+	printf("%u byte record push then pop: queue %.1f ns, ring_t char by char %.1f ns, insert/extract_block %.1f ns, %u errors\n",
+		   (unsigned)sizeof(SAMPLE), t_q * 1e9 / BENCH_N, t_c * 1e9 / BENCH_N, t_b * 1e9 / BENCH_N, errors);
+
+	return(errors != 0);
+}
@@ -0,0 +1,167 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file queue_test.c
+* @brief Host model test of QUEUE_DEFINE
+*
+* Random push/pop and slot/commit/peek/drop calls checked against a
+* record counter, with the indices started just under the 2^32 wrap.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include "queue.h"
+#include "test.h"
+
+#define QUEUE_LEN		8
+#define MODEL_OPS		1000000
+
+typedef struct
+{
+	int16_t x, y, z;
+	uint16_t check;
+	uint32_t seq;
+} SAMPLE;
+
+QUEUE_DEFINE(SAMPLE_QUEUE, Sample_queue, SAMPLE, QUEUE_LEN)
+
+static SAMPLE_QUEUE q;
+
+static uint32_t seed = 1;
+
+static uint32_t Test_rand(uint32_t n)
+{
+	seed = (seed * 1664525) + 1013904223;
+	return((seed >> 8) % n);
+}
+
+//record number n of the stream
+static void Sample_make(SAMPLE *s, uint32_t n)
+{
+	s->x = (int16_t)n;
+	s->y = (int16_t)(n * 3);
+	s->z = (int16_t)(n >> 16);
+	s->check = (uint16_t)(n * 2654435761u);
+	s->seq = n;
+}
+
+static int Sample_is(const SAMPLE *s, uint32_t n)
+{
+	SAMPLE r;
+
+	Sample_make(&r, n);
+	return((s->x == r.x) && (s->y == r.y) && (s->z == r.z) && (s->check == r.check) && (s->seq == r.seq));
+}
+
+static void Test_model(void)
+{
+	uint32_t m_in = 0, m_out = 0;		//records pushed and popped
+	uint32_t op;
+	SAMPLE s;
+	SAMPLE *p;
+	int32_t k;
+	int bad = 0;
+
+	Sample_queue_init(&q);
+	CHECK((Sample_queue_entries(&q) == 0) && (Sample_queue_peek(&q) == 0), "new queue not empty");
+
+	// start just before the wrap so it happens early
+	q.in = q.out = 0xFFFFFFF0;
+
+	for(op = 0; (op < MODEL_OPS) && (bad == 0); op++)
+	{
+		switch(Test_rand(4))
+		{
+			case 0:
+				Sample_make(&s, m_in);
+				k = Sample_queue_push(&q, &s);
+				bad |= (k != (((m_in - m_out) < QUEUE_LEN) ? 0 : -1));
+				m_in += (k == 0);
+				break;
+
+			case 1:
+				k = Sample_queue_pop(&q, &s);
+				bad |= (k != ((m_in != m_out) ? 0 : -1));
+				if(k == 0)
+				{
+					bad |= !Sample_is(&s, m_out);
+					m_out++;
+				}
+				break;
+
+			case 2:
+				// fill a slot in place; nothing is added until the commit
+				p = Sample_queue_slot(&q);
+				bad |= ((p == 0) != ((m_in - m_out) >= QUEUE_LEN));
+				if(p != 0)
+				{
+					Sample_make(p, m_in);
+					bad |= (Sample_queue_entries(&q) != (int32_t)(m_in - m_out));
+					Sample_queue_commit(&q);
+					m_in++;
+				}
+				break;
+
+			default:
+				// read the oldest in place; it stays until the drop
+				p = Sample_queue_peek(&q);
+				bad |= ((p == 0) != (m_in == m_out));
+				if(p != 0)
+				{
+					bad |= !Sample_is(p, m_out);
+					bad |= (Sample_queue_peek(&q) != p);
+					Sample_queue_drop(&q);
+					m_out++;
+				}
+				break;
+		}
+
+		bad |= (Sample_queue_entries(&q) != (int32_t)(m_in - m_out));
+	}
+
+	CHECK(bad == 0, "queue and model differ at op %u", op - 1);
+	CHECK(op == MODEL_OPS, "only %u of %u ops", op, MODEL_OPS);
+	CHECK(q.in < 0xFFFFFFF0, "indices didn't wrap");
+}
+
+static void Test_full(void)
+{
+	SAMPLE s;
+	uint32_t i;
+
+	Sample_queue_init(&q);
+	for(i = 0; i < QUEUE_LEN; i++)
+	{
+		Sample_make(&s, i);
+		CHECK(Sample_queue_push(&q, &s) == 0, "push %u of %u", i, QUEUE_LEN);
+	}
+	CHECK(Sample_queue_push(&q, &s) == -1, "full queue took a record");
+	CHECK(Sample_queue_slot(&q) == 0, "full queue gave a slot");
+	CHECK(Sample_queue_entries(&q) == QUEUE_LEN, "entries %d", Sample_queue_entries(&q));
+
+	for(i = 0; i < QUEUE_LEN; i++)
+	{
+		CHECK((Sample_queue_pop(&q, &s) == 0) && Sample_is(&s, i), "pop %u", i);
+	}
+	CHECK(Sample_queue_pop(&q, &s) == -1, "empty queue gave a record");
+	CHECK(Sample_queue_peek(&q) == 0, "empty queue peeked a record");
+}
+
+int main(void)
+{
+	Test_model();
+	Test_full();
+
+	return(TEST_DONE());
+}
@@ -0,0 +1,82 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file ring_bench.c
+* @brief Host benchmark of the ring_t block calls
+*
+* Bytes per second through a 64 byte ring, one line in then out, with
+* the byte-wise insert/extract against insert_block/extract_block.  Built
+* with the stub's full fence and, as ring_fence_bench, with
+* STUB_COMPILER_FENCE.  The full fence costs the byte-wise path the most.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <string.h>
+#include "ring.h"
+#include "test.h"
+
+#define BENCH_BYTES		(200 * 1000 * 1000)
+
+RING_DEFINE(rb, 64);
+
+static char line[64], out[64];
+static volatile char sink;
+
+static void Bench_line(int len)
+{
+	double t_byte, t_block;
+	long n = BENCH_BYTES / len;
+	long i;
+	int j;
+	char c, acc = 0;
+
+	t_byte = Test_now();
+	for(i = 0; i < n; i++)
+	{
+		for(j = 0; j < len; j++)
+		{
+			insert(&rb, line[j]);
+		}
+		for(j = 0; j < len; j++)
+		{
+			extract(&rb, &c);
+			acc += c;
+		}
+	}
+	t_byte = Test_now() - t_byte;
+
+	t_block = Test_now();
+	for(i = 0; i < n; i++)
+	{
+		insert_block(&rb, line, len);
+		extract_block(&rb, out, len);
+		acc += out[len - 1];
+	}
+	t_block = Test_now() - t_block;
+
+	sink = acc;
+	printf("%2d byte lines: insert/extract %6.0f MB/s, insert_block/extract_block %6.0f MB/s\n",
+		   len, (n * len) / t_byte / 1e6, (n * len) / t_block / 1e6);
+}
+
+int main(void)
+{
+	memset(line, 'x', sizeof(line));
+
+	Bench_line(8);
+	Bench_line(40);
+
+	return(0);
+}
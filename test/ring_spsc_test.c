@@ -0,0 +1,184 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file ring_spsc_test.c
+* @brief Host stress test of ring_t with a producer and a consumer thread
+*
+* The producer thread plays the main loop tasks and the consumer thread
+* plays the UART ISR, each mixing the single char, block and span calls
+* with no locking.  Every byte carries its position in the stream, so a
+* lost, repeated or torn byte shows up as a sequence error.  The indices
+* start at 0xFFFFFF00 so they wrap early on.  Set SPSC_BYTES higher for
+* a longer run.
+*
+* ThreadSanitizer reports the volatile index accesses as races, because
+* they are not C11 atomics; the stub __DMB is a full fence.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <pthread.h>
+#include <sched.h>
+#include "ring.h"
+#include "test.h"
+
+#ifndef SPSC_BYTES
+#define SPSC_BYTES		4000000u
+#endif
+#define SPSC_CHUNK		37				//largest block per call
+
+RING_DEFINE(rb, 64);
+
+static volatile uint32_t seq_errors;
+static volatile uint32_t fill_errors;
+
+//byte i of the stream
+static inline char Spsc_seq(uint32_t i)
+{
+	return((char)((i * 2654435761u) >> 13));
+}
+
+static void *Spsc_producer(void *arg)
+{
+	char buf[SPSC_CHUNK];
+	char *span;
+	uint32_t s = 1;
+	uint32_t i = 0;
+	int32_t n, k;
+
+	(void)arg;
+	while(i < SPSC_BYTES)
+	{
+		s = (s * 1103515245) + 12345;
+		switch((s >> 16) % 3)
+		{
+			case 0:
+				if(insert(&rb, Spsc_seq(i)) == 0)
+				{
+					i++;
+				}
+				break;
+
+			case 1:
+				n = (s >> 20) % SPSC_CHUNK;
+				if((uint32_t)n > (SPSC_BYTES - i))
+				{
+					n = SPSC_BYTES - i;
+				}
+				for(k = 0; k < n; k++)
+				{
+					buf[k] = Spsc_seq(i + k);
+				}
+				i += insert_block(&rb, buf, n);
+				break;
+
+			default:
+				n = write_span(&rb, &span);
+				if((uint32_t)n > (SPSC_BYTES - i))
+				{
+					n = SPSC_BYTES - i;
+				}
+				for(k = 0; k < n; k++)
+				{
+					span[k] = Spsc_seq(i + k);
+				}
+				commit_write(&rb, n);
+				i += n;
+				break;
+		}
+
+		// let the other side run on a single core machine
+		if(((s & 7) == 0) || (entries(&rb) == (int32_t)rb.Length))
+		{
+			sched_yield();
+		}
+	}
+
+	return(0);
+}
+
+static void *Spsc_consumer(void *arg)
+{
+	char buf[SPSC_CHUNK];
+	char *span;
+	char c;
+	uint32_t s = 7;
+	uint32_t i = 0;
+	int32_t n, k;
+
+	(void)arg;
+	while(i < SPSC_BYTES)
+	{
+		s = (s * 1103515245) + 12345;
+		switch((s >> 16) % 3)
+		{
+			case 0:
+				if(extract(&rb, &c) == 0)
+				{
+					seq_errors += (c != Spsc_seq(i));
+					i++;
+				}
+				break;
+
+			case 1:
+				n = extract_block(&rb, buf, (s >> 20) % SPSC_CHUNK);
+				for(k = 0; k < n; k++)
+				{
+					seq_errors += (buf[k] != Spsc_seq(i + k));
+				}
+				i += n;
+				break;
+
+			default:
+				n = peek_span(&rb, &span);
+				for(k = 0; k < n; k++)
+				{
+					seq_errors += (span[k] != Spsc_seq(i + k));
+				}
+				commit_read(&rb, n);
+				i += n;
+				break;
+		}
+
+		n = entries(&rb);
+		fill_errors += (n < 0) || (n > (int32_t)rb.Length);
+		if(n == 0)
+		{
+			sched_yield();
+		}
+	}
+
+	return(0);
+}
+
+int main(void)
+{
+	pthread_t prod, cons;
+
+	rb.Ini = rb.Outi = 0xFFFFFF00;
+
+	pthread_create(&prod, 0, Spsc_producer, 0);
+	pthread_create(&cons, 0, Spsc_consumer, 0);
+	pthread_join(prod, 0);
+	pthread_join(cons, 0);
+
+	printf("SPSC: %u bytes, %u sequence errors, %u fill errors, Ini %08X\n",
+		   SPSC_BYTES, seq_errors, fill_errors, rb.Ini);
+
+	CHECK(seq_errors == 0, "%u sequence errors", seq_errors);
+	CHECK(fill_errors == 0, "entries() out of range %u times", fill_errors);
+	CHECK((rb.Ini == rb.Outi) && (rb.Ini == (uint32_t)(0xFFFFFF00 + SPSC_BYTES)), "Ini %08X Outi %08X", rb.Ini, rb.Outi);
+
+	return(TEST_DONE());
+}
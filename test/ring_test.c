@@ -0,0 +1,184 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file ring_test.c
+* @brief Host model test of ring_t
+*
+* Random insert, extract, block and span calls checked against a plain
+* byte array model, with the indices started just under the 2^32 wrap.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "ring.h"
+#include "test.h"
+
+#define RING_LEN		64
+#define MODEL_OPS		1000000
+#define MODEL_LEN		4096			//power of 2, more than RING_LEN
+
+RING_DEFINE(rb, RING_LEN);
+
+static char model[MODEL_LEN];
+static uint32_t m_in, m_out;			//same meaning as Ini and Outi
+
+static uint32_t seed = 1;
+
+static uint32_t Test_rand(uint32_t n)
+{
+	seed = (seed * 1664525) + 1013904223;
+	return((seed >> 8) % n);
+}
+
+static void Model_put(char c)
+{
+	model[m_in++ & (MODEL_LEN - 1)] = c;
+}
+
+static int Model_get(char c)
+{
+	return(model[m_out++ & (MODEL_LEN - 1)] == c);
+}
+
+static void Test_model(void)
+{
+	char in[RING_LEN + 20], out[RING_LEN + 20];
+	char *span;
+	int32_t n, k, want, i;
+	uint32_t op;
+	int bad = 0;
+
+	// start just before the wrap so it happens early
+	rb.Ini = rb.Outi = m_in = m_out = 0xFFFFFF00;
+
+	for(op = 0; (op < MODEL_OPS) && (bad == 0); op++)
+	{
+		n = Test_rand(RING_LEN + 20);
+		switch(Test_rand(6))
+		{
+			case 0:
+				k = insert(&rb, (char)op);
+				want = ((m_in - m_out) < RING_LEN) ? 0 : -1;
+				bad |= (k != want);
+				if(k == 0)
+				{
+					Model_put((char)op);
+				}
+				break;
+
+			case 1:
+				k = extract(&rb, &out[0]);
+				want = (m_in != m_out) ? 0 : -1;
+				bad |= (k != want);
+				if(k == 0)
+				{
+					bad |= !Model_get(out[0]);
+				}
+				break;
+
+			case 2:
+				for(i = 0; i < n; i++)
+				{
+					in[i] = (char)Test_rand(256);
+				}
+				k = insert_block(&rb, in, n);
+				want = RING_LEN - (m_in - m_out);
+				want = (n < want) ? n : want;
+				bad |= (k != want);
+				for(i = 0; i < k; i++)
+				{
+					Model_put(in[i]);
+				}
+				break;
+
+			case 3:
+				k = extract_block(&rb, out, n);
+				want = m_in - m_out;
+				want = (n < want) ? n : want;
+				bad |= (k != want);
+				for(i = 0; (i < k) && (i < want); i++)
+				{
+					bad |= !Model_get(out[i]);
+				}
+				break;
+
+			case 4:
+				// read part of the span in place; more than is there fails
+				k = peek_span(&rb, &span);
+				want = m_in - m_out;
+				bad |= (k > want) || (k > (RING_LEN - (int32_t)(m_out & (RING_LEN - 1))));
+				bad |= (k == 0) && (want != 0);
+				n = (k != 0) ? (int32_t)Test_rand(k + 1) : 0;
+				for(i = 0; i < n; i++)
+				{
+					bad |= !Model_get(span[i]);
+				}
+				bad |= (commit_read(&rb, n) != 0);
+				bad |= (commit_read(&rb, (m_in - m_out) + 1) != -1);
+				break;
+
+			default:
+				// write part of the span in place; more than fits fails
+				k = write_span(&rb, &span);
+				want = RING_LEN - (m_in - m_out);
+				bad |= (k > want) || (k > (RING_LEN - (int32_t)(m_in & (RING_LEN - 1))));
+				bad |= (k == 0) && (want != 0);
+				n = (k != 0) ? (int32_t)Test_rand(k + 1) : 0;
+				for(i = 0; i < n; i++)
+				{
+					span[i] = (char)Test_rand(256);
+					Model_put(span[i]);
+				}
+				bad |= (commit_write(&rb, n) != 0);
+				bad |= (commit_write(&rb, (RING_LEN - (m_in - m_out)) + 1) != -1);
+				break;
+		}
+
+		bad |= (entries(&rb) != (int32_t)(m_in - m_out));
+		bad |= (rb.Ini != m_in) || (rb.Outi != m_out);
+	}
+
+	CHECK(bad == 0, "ring and model differ at op %u", op - 1);
+	CHECK(op == MODEL_OPS, "only %u of %u ops", op, MODEL_OPS);
+	CHECK(m_in < 0xFFFFFF00, "indices didn't wrap");
+}
+
+static void Test_args(void)
+{
+	char c = 0;
+	char *span;
+
+	CHECK(insert(0, c) == -1, "insert(0)");
+	CHECK(extract(0, &c) == -1, "extract(0)");
+	CHECK(entries(0) == -1, "entries(0)");
+	CHECK(insert_block(0, &c, 1) == -1, "insert_block(0)");
+	CHECK(insert_block(&rb, 0, 1) == -1, "insert_block data 0");
+	CHECK(insert_block(&rb, &c, -1) == -1, "insert_block len -1");
+	CHECK(extract_block(&rb, &c, -1) == -1, "extract_block len -1");
+	CHECK(peek_span(&rb, 0) == -1, "peek_span span 0");
+	CHECK(write_span(0, &span) == -1, "write_span(0)");
+	CHECK(commit_read(&rb, -1) == -1, "commit_read -1");
+	CHECK(commit_write(&rb, -1) == -1, "commit_write -1");
+	CHECK(rb.Length == RING_LEN, "RING_DEFINE length %u", rb.Length);
+}
+
+int main(void)
+{
+	Test_model();
+	Test_args();
+
+	return(TEST_DONE());
+}
@@ -0,0 +1,190 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file stats_test.c
+* @brief Host test of the streaming statistics
+*
+* Windows of random samples against the same statistics in double
+* precision, a 1000 count sine, full scale inputs for the 64 bit sums,
+* the block path, a window dropped while the report is going out and the
+* report lines.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stats.h"
+#include "test.h"
+
+#define WIN			800					//1s at 800Hz
+#define WINDOWS		50					//random windows against double math
+
+static STATS st;
+static int16_t in[3][WIN];
+RING_DEFINE(obuf, 64);
+
+static uint32_t seed = 1;
+
+static int32_t Test_rand(int32_t range)
+{
+	seed = (seed * 1664525) + 1013904223;
+	return((int32_t)((seed >> 8) % (2 * range + 1)) - range);
+}
+
+//r against the same window worked out in double precision
+static void Test_result(const int16_t *x, uint32_t n, const STATS_RESULT *r, int axis)
+{
+	double sum = 0, sq = 0, var, mean, pk;
+	int16_t lo = INT16_MAX, hi = INT16_MIN;
+	uint32_t i;
+
+	for(i = 0; i < n; i++)
+	{
+		sum += x[i];
+		sq += (double)x[i] * x[i];
+		lo = (x[i] < lo) ? x[i] : lo;
+		hi = (x[i] > hi) ? x[i] : hi;
+	}
+	// C division, rounds toward 0
+	mean = trunc(sum / n);
+	var = (sq / n) - ((sum / n) * (sum / n));
+	pk = fmax(hi - mean, mean - lo);
+
+	CHECK((r->mean == mean) && (r->min == lo) && (r->max == hi), "axis %d: mean %d min %d max %d, want %.0f %d %d",
+		  axis, r->mean, r->min, r->max, mean, lo, hi);
+	CHECK(fabs(r->rms - sqrt(sq / n)) <= 1, "axis %d: rms %u, want %.2f", axis, r->rms, sqrt(sq / n));
+	CHECK(fabs(r->ac_rms - sqrt(var)) <= 1, "axis %d: ac rms %u, want %.2f", axis, r->ac_rms, sqrt(var));
+	CHECK(r->peak == pk, "axis %d: peak %u, want %.0f", axis, r->peak, pk);
+	if(r->ac_rms != 0)
+	{
+		CHECK(r->crest == ((uint32_t)r->peak * 100) / r->ac_rms, "axis %d: crest %u", axis, r->crest);
+	}
+}
+
+static void Test_sine(void)
+{
+	int i;
+
+	// 1000 counts at 50Hz on x, 1g with noise on z, a constant on y
+	Stats_init(&st, WIN);
+	for(i = 0; i < WIN; i++)
+	{
+		in[0][i] = lrint(1000 * sin(2 * M_PI * 50 * i / 800.0));
+		in[1][i] = -123;
+		in[2][i] = 4096 + Test_rand(50);
+		CHECK(Stats_run(&st, in[0][i], in[1][i], in[2][i]) == (i == (WIN - 1)), "window end at %d", i);
+	}
+	CHECK(st.ready, "window not ready");
+
+	CHECK((st.res[0].mean == 0) && (st.res[0].ac_rms == 707) && (st.res[0].peak == 1000) && (st.res[0].crest == 141),
+		  "sine: mean %d ac rms %u peak %u crest %u", st.res[0].mean, st.res[0].ac_rms, st.res[0].peak, st.res[0].crest);
+	CHECK((st.res[1].mean == -123) && (st.res[1].ac_rms == 0) && (st.res[1].peak == 0) && (st.res[1].crest == 0),
+		  "constant: mean %d ac rms %u peak %u crest %u", st.res[1].mean, st.res[1].ac_rms, st.res[1].peak, st.res[1].crest);
+	for(i = 0; i < 3; i++)
+	{
+		Test_result(in[i], WIN, &st.res[i], i);
+	}
+}
+
+static void Test_random(void)
+{
+	int w, a, i, amp;
+
+	for(w = 0; w < WINDOWS; w++)
+	{
+		Stats_init(&st, WIN);
+		for(a = 0; a < 3; a++)
+		{
+			amp = abs(Test_rand(32767));
+			for(i = 0; i < WIN; i++)
+			{
+				in[a][i] = Test_rand(amp);
+			}
+		}
+		CHECK(Stats_block(&st, in[0], in[1], in[2], WIN), "block didn't end the window");
+		for(a = 0; a < 3; a++)
+		{
+			Test_result(in[a], WIN, &st.res[a], a);
+		}
+	}
+}
+
+//the longest window at full scale can't overflow the sums
+static void Test_full_scale(void)
+{
+	uint32_t i;
+
+	Stats_init(&st, UINT16_MAX);
+	for(i = 0; i < UINT16_MAX; i++)
+	{
+		Stats_run(&st, -32768, (i & 1) ? 32767 : -32768, 32767);
+	}
+	CHECK(st.ready, "window not ready");
+	CHECK((st.res[0].mean == -32768) && (st.res[0].rms == 32768) && (st.res[0].ac_rms == 0),
+		  "x: mean %d rms %u ac rms %u", st.res[0].mean, st.res[0].rms, st.res[0].ac_rms);
+	// one more -32768 than 32767
+	CHECK((st.res[1].mean == -1) && (st.res[1].ac_rms == 32767) && (st.res[1].peak == 32768),
+		  "y: mean %d ac rms %u peak %u", st.res[1].mean, st.res[1].ac_rms, st.res[1].peak);
+	CHECK((st.res[2].mean == 32767) && (st.res[2].rms == 32767), "z: mean %d rms %u", st.res[2].mean, st.res[2].rms);
+}
+
+static void Tx_none(void)
+{
+}
+
+static void Test_report(void)
+{
+	char out[160];
+	STATS_RESULT res[3];
+	int n = 0, i;
+
+	Stats_init(&st, 4);
+	Stats_run(&st, 100, -5, 0);
+	Stats_run(&st, -100, -5, 0);
+	Stats_run(&st, 100, -5, 0);
+	Stats_run(&st, -100, -5, 0);
+	memcpy(res, st.res, sizeof(res));
+
+	// a window that ends while the report is going out is dropped
+	Stats_task(&st, &obuf, Tx_none);
+	n += extract_block(&obuf, &out[n], sizeof(out) - 1 - n);
+	for(i = 0; i < 4; i++)
+	{
+		Stats_run(&st, 7, 7, 7);
+	}
+	CHECK(memcmp(res, st.res, sizeof(res)) == 0, "dropped window overwrote the results being sent");
+
+	for(i = 0; i < 5; i++)
+	{
+		Stats_task(&st, &obuf, Tx_none);
+		n += extract_block(&obuf, &out[n], sizeof(out) - 1 - n);
+	}
+	out[n] = 0;
+
+	CHECK(strcmp(out, "X 0 sd 100 pk 100 cf 1.00\r\nY -5 sd 0 pk 0 cf 0.00\r\nZ 0 sd 0 pk 0 cf 0.00\r\n") == 0,
+		  "report \"%s\"", out);
+	CHECK(!st.ready, "still ready after the report");
+}
+
+int main(void)
+{
+	Test_sine();
+	Test_random();
+	Test_full_scale();
+	Test_report();
+
+	return(TEST_DONE());
+}
@@ -0,0 +1,169 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file MKL25Z4.h
+* @brief Host stand in for the device header
+*
+* Lets the driver and library sources build for the host tests.  The
+* core intrinsics become their host equivalents and the peripherals the
+* drivers touch are plain structs, defined by the fake in
+* fake_mma8451q.c.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#ifndef MKL25Z4_H_
+#define MKL25Z4_H_
+
+#include <stdint.h>
+
+//the I2C job queue, ring and record queue barriers order memory between a
+//producer and a consumer thread, so they need a real fence on the host.
+//The benchmarks can build with STUB_COMPILER_FENCE instead, which is
+//closer to the cost of a DMB on the single core M0+.
+#ifdef STUB_COMPILER_FENCE
+#define __DMB()				__asm volatile("" ::: "memory")
+#else
+#define __DMB()				__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+static inline uint32_t __get_PRIMASK(void)
+{
+	return(0);
+}
+
+static inline void __disable_irq(void)
+{
+}
+
+static inline void __set_PRIMASK(uint32_t primask)
+{
+	(void)primask;
+}
+
+typedef enum
+{
+	I2C0_IRQn = 8,
+	PORTA_IRQn = 30
+} IRQn_Type;
+
+#define __NVIC_PRIO_BITS	2
+#define _BIT_SHIFT(IRQn)	((((uint32_t)(int32_t)(IRQn)) & 0x03UL) * 8UL)
+#define _IP_IDX(IRQn)		(((uint32_t)(int32_t)(IRQn)) >> 2UL)
+
+typedef struct
+{
+	volatile uint32_t ISER[1];
+	volatile uint32_t ICER[1];
+	volatile uint32_t ISPR[1];
+	volatile uint32_t ICPR[1];
+	volatile uint32_t IP[8];
+} NVIC_Type;
+
+typedef struct
+{
+	volatile uint32_t SCGC4;
+	volatile uint32_t SCGC5;
+} SIM_Type;
+
+typedef struct
+{
+	volatile uint32_t PCR[32];
+	volatile uint32_t ISFR;
+} PORT_Type;
+
+typedef struct
+{
+	volatile uint32_t PDOR;
+	volatile uint32_t PSOR;
+	volatile uint32_t PCOR;
+	volatile uint32_t PTOR;
+	volatile uint32_t PDIR;
+	volatile uint32_t PDDR;
+} GPIO_Type;
+
+//D is wider than the real register so the fake can tell a byte the
+//driver wrote (0x00..0xFF) from a byte it put there to be read
+typedef struct
+{
+	volatile uint8_t A1;
+	volatile uint8_t F;
+	volatile uint8_t C1;
+	volatile uint8_t S;
+	volatile uint16_t D;
+	volatile uint8_t C2;
+	volatile uint8_t FLT;
+	volatile uint8_t RA;
+	volatile uint8_t SMB;
+} I2C_Type;
+
+extern NVIC_Type fake_nvic;
+extern SIM_Type fake_sim;
+extern PORT_Type fake_porta;
+extern PORT_Type fake_porte;
+extern I2C_Type fake_i2c0;
+extern GPIO_Type fake_gpioa;
+extern GPIO_Type fake_gpioe;
+
+#define NVIC				(&fake_nvic)
+#define SIM					(&fake_sim)
+#define PORTA				(&fake_porta)
+#define PORTE				(&fake_porte)
+#define I2C0				(&fake_i2c0)
+#define GPIOA				(&fake_gpioa)
+#define GPIOE				(&fake_gpioe)
+
+#define SIM_SCGC4_I2C0(x)	(((uint32_t)(x) << 6) & 0x40U)
+#define SIM_SCGC5_PORTA(x)	(((uint32_t)(x) << 9) & 0x200U)
+#define SIM_SCGC5_PORTE(x)	(((uint32_t)(x) << 13) & 0x2000U)
+
+#define PORT_PCR_MUX_MASK	(0x700U)
+#define PORT_PCR_MUX(x)		(((uint32_t)(x) << 8) & PORT_PCR_MUX_MASK)
+#define PORT_PCR_IRQC_MASK	(0xF0000U)
+#define PORT_PCR_IRQC(x)	(((uint32_t)(x) << 16) & PORT_PCR_IRQC_MASK)
+#define PORT_PCR_ISF_MASK	(0x1000000U)
+
+#define I2C_F_MULT(x)		((uint8_t)(((x) << 6) & 0xC0U))
+#define I2C_F_ICR(x)		((uint8_t)((x) & 0x3FU))
+#define I2C_C1_IICEN_MASK	(0x80U)
+#define I2C_C1_IICEN(x)		((uint8_t)(((x) << 7) & I2C_C1_IICEN_MASK))
+#define I2C_C1_IICIE_MASK	(0x40U)
+#define I2C_C1_IICIE(x)		((uint8_t)(((x) << 6) & I2C_C1_IICIE_MASK))
+#define I2C_C1_MST_MASK		(0x20U)
+#define I2C_C1_MST(x)		((uint8_t)(((x) << 5) & I2C_C1_MST_MASK))
+#define I2C_C1_TX_MASK		(0x10U)
+#define I2C_C1_TXAK_MASK	(0x08U)
+#define I2C_C1_RSTA_MASK	(0x04U)
+#define I2C_S_TCF_MASK		(0x80U)
+#define I2C_S_BUSY_MASK		(0x20U)
+#define I2C_S_ARBL_MASK		(0x10U)
+#define I2C_S_IICIF_MASK	(0x02U)
+#define I2C_S_RXAK_MASK		(0x01U)
+#define I2C_C2_HDRS(x)		((uint8_t)(((x) << 5) & 0x20U))
+#define I2C_FLT_SHEN(x)		((uint8_t)(((x) << 7) & 0x80U))
+#define I2C_FLT_STOPF_MASK	(0x40U)
+#define I2C_FLT_STOPIE(x)	((uint8_t)(((x) << 5) & 0x20U))
+#define I2C_RA_RAD(x)		((uint8_t)(((x) << 1) & 0xFEU))
+
+static inline void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+	NVIC->ISER[0] = 1UL << ((uint32_t)IRQn & 0x1FUL);
+}
+
+static inline void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+	NVIC->ICER[0] = 1UL << ((uint32_t)IRQn & 0x1FUL);
+}
+
+#endif /* MKL25Z4_H_ */
@@ -0,0 +1,55 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file test.h
+* @brief Checks shared by the host tests
+*
+* Each test is a program that prints every failed check and returns
+* non zero if there was one.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <stdio.h>
+#include <time.h>
+
+static int test_failed __attribute__((unused)) = 0;
+
+#define CHECK(cond, ...)													\
+	do																		\
+	{																		\
+		if(!(cond))															\
+		{																	\
+			printf("FAIL %s:%d: ", __FILE__, __LINE__);						\
+			printf(__VA_ARGS__);											\
+			printf("\n");													\
+			test_failed++;													\
+		}																	\
+	} while(0)
+
+#define TEST_DONE()		(printf("%s: %s\n", __FILE__, (test_failed) ? "FAILED" : "ok"), (test_failed != 0))
+
+//wall clock seconds, for the benchmarks
+static inline double Test_now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return(t.tv_sec + (t.tv_nsec * 1e-9));
+}
+
+#endif /* TEST_H_ */
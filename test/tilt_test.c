@@ -0,0 +1,255 @@
+/*****************************************************************************
+* Copyright (C) 2019 by Jon Warriner
+*
+* Redistribution, modification or use of this software in source or binary
+* forms is permitted as long as the files maintain this copyright. Users are
+* permitted to modify this and use it to learn about the field of embedded
+* software. Jon Warriner and the University of Colorado are not liable for
+* any misuse of this material.
+*
+*****************************************************************************/
+/**
+* @file tilt_test.c
+* @brief Host test of the tilt limit detector
+*
+* Pitch/roll sequences across the limit, limit - hyst and debounce
+* edges, each sample with the event it must give, so every TILT_TIPPED
+* and TILT_LEVEL is checked at its sample index.  Then dynamic samples,
+* the block path, the event queue running full and the event lines.
+*
+* @author Jon Warriner
+* @date June 30 2019
+* @version 1.0
+*
+*/
+
+#include <string.h>
+#include "tilt.h"
+#include "test.h"
+
+#define N			TILT_NONE
+#define T			TILT_TIPPED
+#define L			TILT_LEVEL
+
+typedef struct
+{
+	int16_t pitch;
+	int16_t roll;
+	uint8_t dynamic;
+	TILT_EVENT_TYPE ev;					//what Tilt_run must return
+} STEP;
+
+//30 degrees pitch, 20 degrees roll, 5 degrees of hysteresis, 4 samples
+static const TILT_CFG cfg = { 3000, 2000, 500, 4 };
+
+static TILT t;
+RING_DEFINE(obuf, 64);
+
+//run the steps from a fresh detector and check the event at every sample
+static void Test_steps(const char *what, const TILT_CFG *c, const STEP *s, int n)
+{
+	TILT_EVENT e;
+	int i, events = 0;
+
+	Tilt_init(&t, c);
+	for(i = 0; i < n; i++)
+	{
+		TILT_EVENT_TYPE r = Tilt_run(&t, s[i].pitch, s[i].roll, s[i].dynamic);
+
+		CHECK(r == s[i].ev, "%s: sample %d (%d, %d%s) gave %d, want %d", what, i, s[i].pitch, s[i].roll,
+			  (s[i].dynamic) ? ", dynamic" : "", r, s[i].ev);
+		if(s[i].ev != TILT_NONE)
+		{
+			events++;
+		}
+	}
+	CHECK(t.tipped == ((events & 1) != 0), "%s: ends %s after %d events", what, (t.tipped) ? "tipped" : "level", events);
+
+	// every change was queued with the sample that made it
+	for(i = 0; (i < n) && (events > 0); i++)
+	{
+		if(s[i].ev == TILT_NONE)
+		{
+			continue;
+		}
+		if(Tilt_queue_pop(&t.ev, &e) != 0)
+		{
+			CHECK(t.ev_lost != 0, "%s: event at sample %d not queued", what, i);
+			break;
+		}
+		CHECK((e.type == s[i].ev) && (e.pitch == s[i].pitch) && (e.roll == s[i].roll),
+			  "%s: event %u (%d, %d), want %d (%d, %d) from sample %d", what, e.type, e.pitch, e.roll,
+			  s[i].ev, s[i].pitch, s[i].roll, i);
+	}
+}
+
+static void Test_limits(void)
+{
+	// the limit itself isn't past it, and either angle will do
+	static const STEP pitch[] =
+	{
+		{ 3000, 0, 0, N }, { 3000, 0, 0, N }, { 3000, 0, 0, N }, { 3000, 0, 0, N }, { 3000, 0, 0, N },
+		{ 3001, 0, 0, N }, { 3001, 0, 0, N }, { -3001, 0, 0, N }, { 3001, 0, 0, T },
+		{ 3001, 0, 0, N }, { 9000, 0, 0, N }
+	};
+	static const STEP roll[] =
+	{
+		{ 0, -2000, 0, N }, { 0, -2000, 0, N }, { 0, -2000, 0, N }, { 0, -2000, 0, N },
+		{ 0, -2001, 0, N }, { 0, 18000, 0, N }, { 0, -18000, 0, N }, { 0, 2001, 0, T }
+	};
+	// tipped -> level needs both strictly under limit - hyst
+	static const STEP back[] =
+	{
+		{ 0, 2001, 0, N }, { 0, 2001, 0, N }, { 0, 2001, 0, N }, { 0, 2001, 0, T },
+		{ 2500, 0, 0, N }, { 2500, 0, 0, N }, { 2500, 0, 0, N }, { 2500, 0, 0, N }, { 2500, 0, 0, N },
+		{ 0, 1500, 0, N }, { 0, 1500, 0, N }, { 0, 1500, 0, N }, { 0, 1500, 0, N }, { 0, 1500, 0, N },
+		{ 2499, 1500, 0, N }, { 2499, 1500, 0, N }, { 2499, 1500, 0, N }, { 2499, 1500, 0, N },
+		{ 2499, 1499, 0, N }, { -2499, -1499, 0, N }, { 0, 0, 0, N }, { 2499, 1499, 0, L },
+		{ 0, 0, 0, N }
+	};
+	// inside the hysteresis band nothing changes either way
+	static const STEP band[] =
+	{
+		{ 2800, 1800, 0, N }, { 2800, 1800, 0, N }, { 2800, 1800, 0, N }, { 2800, 1800, 0, N },
+		{ 2800, 1800, 0, N }, { 3001, 1800, 0, N }, { 3001, 1800, 0, N }, { 3001, 1800, 0, N },
+		{ 3001, 1800, 0, T }, { 2800, 1800, 0, N }, { 2800, 1800, 0, N }, { 2800, 1800, 0, N },
+		{ 2800, 1800, 0, N }, { 2800, 1800, 0, N }, { 100, -100, 0, N }, { 100, -100, 0, N },
+		{ 100, -100, 0, N }, { 100, -100, 0, L }
+	};
+
+	Test_steps("pitch limit", &cfg, pitch, sizeof(pitch) / sizeof(pitch[0]));
+	Test_steps("roll limit", &cfg, roll, sizeof(roll) / sizeof(roll[0]));
+	Test_steps("back to level", &cfg, back, sizeof(back) / sizeof(back[0]));
+	Test_steps("hysteresis band", &cfg, band, sizeof(band) / sizeof(band[0]));
+}
+
+static void Test_debounce(void)
+{
+	// one sample that agrees with the state starts the count again
+	static const STEP reset[] =
+	{
+		{ 3001, 0, 0, N }, { 3001, 0, 0, N }, { 3001, 0, 0, N }, { 0, 0, 0, N },
+		{ 3001, 0, 0, N }, { 3001, 0, 0, N }, { 3001, 0, 0, N }, { 3001, 0, 0, T },
+		{ 0, 0, 0, N }, { 0, 0, 0, N }, { 0, 0, 0, N }, { 2600, 0, 0, N },
+		{ 0, 0, 0, N }, { 0, 0, 0, N }, { 0, 0, 0, N }, { 0, 0, 0, L }
+	};
+	// dynamic samples neither count nor reset the count, whatever they read
+	static const STEP dynamic[] =
+	{
+		{ 3001, 0, 0, N }, { 3001, 0, 0, N }, { 9000, 0, 1, N }, { 9000, 0, 1, N },
+		{ 0, 0, 1, N }, { 0, 0, 1, N }, { 3001, 0, 0, N }, { 0, 0, 1, N },
+		{ 3001, 0, 0, T }, { 0, 0, 0, N }, { 0, 0, 0, N }, { 9000, 0, 1, N },
+		{ 0, 0, 0, N }, { 0, 0, 1, N }, { 0, 0, 0, L }
+	};
+	// 1 and 0 both change on the first sample
+	static const STEP one[] =
+	{
+		{ 3001, 0, 0, T }, { 3001, 0, 0, N }, { 0, 0, 1, N }, { 0, 0, 0, L }, { 0, 2001, 0, T }
+	};
+	TILT_CFG c = cfg;
+
+	Test_steps("debounce reset", &cfg, reset, sizeof(reset) / sizeof(reset[0]));
+	Test_steps("dynamic", &cfg, dynamic, sizeof(dynamic) / sizeof(dynamic[0]));
+	c.debounce = 1;
+	Test_steps("debounce 1", &c, one, sizeof(one) / sizeof(one[0]));
+	c.debounce = 0;
+	Test_steps("debounce 0", &c, one, sizeof(one) / sizeof(one[0]));
+}
+
+//Tilt_block() gives the same state and queue as Tilt_run() sample by sample
+static void Test_block(void)
+{
+	int16_t pitch[64], roll[64];
+	uint8_t dynamic[64];
+	TILT ref;
+	TILT_EVENT_TYPE last, r;
+	uint32_t seed = 1;
+	int i, n;
+
+	for(i = 0; i < 64; i++)
+	{
+		seed = (seed * 1664525) + 1013904223;
+		// a few samples each side of the limits, in runs
+		pitch[i] = ((i / 6) & 1) ? 3001 + (seed >> 28) : 2499 - (seed >> 28);
+		roll[i] = (int16_t)((seed >> 20) & 0x3FF);
+		dynamic[i] = ((seed >> 8) & 7) == 0;
+	}
+
+	for(n = 0; n <= 64; n += 7)
+	{
+		Tilt_init(&ref, &cfg);
+		last = TILT_NONE;
+		for(i = 0; i < n; i++)
+		{
+			r = Tilt_run(&ref, pitch[i], roll[i], dynamic[i]);
+			if(r != TILT_NONE)
+			{
+				last = r;
+			}
+		}
+
+		Tilt_init(&t, &cfg);
+		r = Tilt_block(&t, pitch, roll, dynamic, n);
+		CHECK((r == last) && (t.tipped == ref.tipped) && (t.count == ref.count) &&
+			  (Tilt_queue_entries(&t.ev) == Tilt_queue_entries(&ref.ev)) && (t.ev_lost == ref.ev_lost),
+			  "Tilt_block over %d samples: %d, tipped %d count %u, want %d, %d, %u", n, r, t.tipped, t.count,
+			  last, ref.tipped, ref.count);
+	}
+
+	// no flags is no dynamic samples
+	Tilt_init(&t, &cfg);
+	CHECK(Tilt_block(&t, pitch, roll, 0, 12) == TILT_TIPPED, "Tilt_block without flags missed the change");
+}
+
+static void Tx_none(void)
+{
+}
+
+//the queue running full and the lines Tilt_task sends
+static void Test_queue(void)
+{
+	TILT_CFG c = cfg;
+	char out[128];
+	int i, n = 0;
+
+	c.debounce = 1;
+	Tilt_init(&t, &c);
+
+	// two more changes than the queue holds: the state still follows,
+	// the newest events are the ones lost
+	for(i = 0; i < TILT_EVENTS + 2; i++)
+	{
+		CHECK(Tilt_run(&t, (i & 1) ? -100 : 3001 + i, -i, 0) == ((i & 1) ? TILT_LEVEL : TILT_TIPPED), "change %d", i);
+	}
+	CHECK(!t.tipped, "state didn't follow the samples");
+	CHECK((Tilt_queue_entries(&t.ev) == TILT_EVENTS) && (t.ev_lost == 2), "%d queued, %u lost",
+		  (int)Tilt_queue_entries(&t.ev), t.ev_lost);
+
+	// one line per call, and only into an empty output buffer
+	insert(&obuf, 'x');
+	Tilt_task(&t, &obuf, Tx_none);
+	CHECK((entries(&obuf) == 1) && (Tilt_queue_entries(&t.ev) == TILT_EVENTS), "Tilt_task wrote into a busy buffer");
+	extract(&obuf, out);
+	for(i = 0; i < TILT_EVENTS + 1; i++)
+	{
+		Tilt_task(&t, &obuf, Tx_none);
+		n += extract_block(&obuf, &out[n], sizeof(out) - 1 - n);
+	}
+	out[n] = 0;
+	CHECK(strcmp(out, "TILT 3001 0\r\nLEVEL -100 -1\r\nTILT 3003 -2\r\nLEVEL -100 -3\r\n") == 0, "events \"%s\"", out);
+	CHECK(Tilt_queue_entries(&t.ev) == 0, "queue not empty");
+
+	// room again once they are sent
+	CHECK((Tilt_run(&t, 0, 2001, 0) == TILT_TIPPED) && (Tilt_queue_entries(&t.ev) == 1) && (t.ev_lost == 2),
+		  "no event after the queue drained");
+}
+
+int main(void)
+{
+	Test_limits();
+	Test_debounce();
+	Test_block();
+	Test_queue();
+
+	return(TEST_DONE());
+}